@@ -0,0 +1,320 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+// checks the accelerated hashing and checksum paths against the portable ones and times both ("make bench")
+// every accelerated path has to give exactly the same results as the portable one on random data, lengths and alignments (and on the shipped map scripts for the map checksum)
+// the accelerated paths are only tested if this CPU has the instructions they use
+
+#include "src/crc32.h"
+#include "src/gameslot.h"
+#include "src/map.h"
+#include "src/sha1.h"
+#include "src/cpu.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static uint32_t          gFailures = 0;
+static volatile uint32_t gSink     = 0; // keeps the timed hashes from being optimized away
+
+static void Check(bool ok, const string& what)
+{
+  if (ok)
+    return;
+
+  printf("FAIL: %s\n", what.c_str());
+  ++gFailures;
+}
+
+// runs func over data repeatedly for about half a second and prints the throughput
+
+static void Time(const string& name, const vector<uint8_t>& data, const function<void()>& func)
+{
+  using Clock = chrono::steady_clock;
+
+  uint32_t                Runs  = 0;
+  const Clock::time_point Start = Clock::now();
+  Clock::duration         Elapsed;
+
+  do
+  {
+    func();
+    ++Runs;
+    Elapsed = Clock::now() - Start;
+  } while (Elapsed < chrono::milliseconds(500));
+
+  const double Seconds = chrono::duration<double>(Elapsed).count();
+  printf("  %-28s %10.1f MB/s\n", name.c_str(), static_cast<double>(data.size()) * Runs / Seconds / 1000000.0);
+}
+
+static string Hex(const uint8_t* data, uint32_t length)
+{
+  static const char Digits[] = "0123456789ABCDEF";
+  string            Result;
+
+  for (uint32_t i = 0; i < length; ++i)
+  {
+    Result += Digits[data[i] >> 4];
+    Result += Digits[data[i] & 15];
+  }
+
+  return Result;
+}
+
+static string SHA1Hex(bool accelerate, const uint8_t* data, uint32_t length, uint32_t split)
+{
+  CSHA1   SHA(accelerate);
+  uint8_t Hash[20];
+
+  // hashing in two parts exercises the buffered partial block in CSHA1 :: Update
+
+  SHA.Update(data, split);
+  SHA.Update(data + split, length - split);
+  SHA.Final();
+  SHA.GetHash(Hash);
+  return Hex(Hash, 20);
+}
+
+static void TestCRC32(const vector<uint8_t>& data, mt19937& rng)
+{
+  CCRC32 Table, Fast;
+  Table.Initialize(false);
+  Fast.Initialize();
+
+  const uint8_t* Check123 = reinterpret_cast<const uint8_t*>("123456789");
+  Check(Table.CalculateCRC(Check123, 9) == 0xCBF43926, "crc32 of \"123456789\"");
+
+#ifdef AURA_X86
+  const bool Accelerated = CPUHasCLMUL();
+#else
+  const bool Accelerated = false;
+#endif
+
+  printf("crc32 (pclmul %s)\n", Accelerated ? "available" : "not available, only the tables are tested");
+
+  if (Accelerated)
+  {
+    // every length around the 16 and 64 byte folding boundaries at every alignment, then random lengths and alignments
+
+    for (uint32_t Length = 0; Length <= 512; ++Length)
+    {
+      for (uint32_t Offset = 0; Offset < 16; ++Offset)
+        Check(Table.CalculateCRC(data.data() + Offset, Length) == Fast.CalculateCRC(data.data() + Offset, Length), "crc32 length " + to_string(Length) + " offset " + to_string(Offset));
+    }
+
+    for (uint32_t i = 0; i < 2000; ++i)
+    {
+      const uint32_t Offset   = rng() % 64;
+      const uint32_t Length   = rng() % (data.size() - Offset);
+      const uint32_t Previous = rng();
+      Check(Table.CalculateCRC(data.data() + Offset, Length, Previous) == Fast.CalculateCRC(data.data() + Offset, Length, Previous), "crc32 length " + to_string(Length) + " offset " + to_string(Offset) + " previous " + to_string(Previous));
+    }
+  }
+
+  Time("tables", data, [&]() { gSink = Table.CalculateCRC(data.data(), data.size()); });
+
+  if (Accelerated)
+    Time("pclmul", data, [&]() { gSink = Fast.CalculateCRC(data.data(), data.size()); });
+}
+
+static void TestSHA1(const vector<uint8_t>& data, mt19937& rng)
+{
+  const uint8_t* ABC = reinterpret_cast<const uint8_t*>("abc");
+  Check(SHA1Hex(false, ABC, 3, 1) == "A9993E364706816ABA3E25717850C26C9CD0D89D", "sha1 of \"abc\"");
+
+#ifdef AURA_X86
+  const bool Accelerated = CPUHasSHA();
+#else
+  const bool Accelerated = false;
+#endif
+
+  printf("sha1 (sha extensions %s)\n", Accelerated ? "available" : "not available, only the plain transform is tested");
+
+  if (Accelerated)
+  {
+    Check(SHA1Hex(true, ABC, 3, 1) == "A9993E364706816ABA3E25717850C26C9CD0D89D", "accelerated sha1 of \"abc\"");
+
+    for (uint32_t Length = 0; Length <= 300; ++Length)
+    {
+      for (uint32_t Offset = 0; Offset < 16; ++Offset)
+      {
+        const uint32_t Split = Length ? rng() % Length : 0;
+        Check(SHA1Hex(false, data.data() + Offset, Length, Split) == SHA1Hex(true, data.data() + Offset, Length, Split), "sha1 length " + to_string(Length) + " offset " + to_string(Offset) + " split " + to_string(Split));
+      }
+    }
+
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+      const uint32_t Offset = rng() % 64;
+      const uint32_t Length = rng() % (data.size() - Offset);
+      const uint32_t Split  = Length ? rng() % Length : 0;
+      Check(SHA1Hex(false, data.data() + Offset, Length, Split) == SHA1Hex(true, data.data() + Offset, Length, Split), "sha1 length " + to_string(Length) + " offset " + to_string(Offset) + " split " + to_string(Split));
+    }
+  }
+
+  Time("plain", data, [&]() { gSink = SHA1Hex(false, data.data(), data.size(), 0)[0]; });
+
+  if (Accelerated)
+    Time("sha extensions", data, [&]() { gSink = SHA1Hex(true, data.data(), data.size(), 0)[0]; });
+}
+
+// the map script checksum the way it was calculated before it was split into lanes, one word at a time
+
+static uint32_t XORRotateLeftReference(const uint8_t* data, uint32_t length)
+{
+  uint32_t i   = 0;
+  uint32_t Val = 0;
+
+  for (; i + 4 <= length; i += 4)
+  {
+    Val ^= static_cast<uint32_t>(data[i]) | static_cast<uint32_t>(data[i + 1]) << 8 | static_cast<uint32_t>(data[i + 2]) << 16 | static_cast<uint32_t>(data[i + 3]) << 24;
+    Val = (Val << 3) | (Val >> 29);
+  }
+
+  for (; i < length; ++i)
+  {
+    Val ^= data[i];
+    Val = (Val << 3) | (Val >> 29);
+  }
+
+  return Val;
+}
+
+// ChunkedChecksum the same way, one 1 KB chunk at a time with the reference
+
+static uint32_t ChunkedChecksumReference(const uint8_t* data, uint32_t length, uint32_t checksum)
+{
+  for (uint32_t i = 0; i + 0x400 <= length; i += 0x400)
+  {
+    checksum ^= XORRotateLeftReference(data + i, 0x400);
+    checksum = (checksum << 3) | (checksum >> 29);
+  }
+
+  return checksum;
+}
+
+static vector<uint8_t> ReadScript(const string& file)
+{
+  ifstream in(file, ios::binary);
+
+  if (in.fail())
+    return vector<uint8_t>();
+
+  return vector<uint8_t>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+static void TestXORRotateLeft(const vector<uint8_t>& data, mt19937& rng)
+{
+#ifdef AURA_X86
+  const bool Accelerated = CPUHasAVX2();
+#else
+  const bool Accelerated = false;
+#endif
+
+  printf("map checksum (avx2 %s)\n", Accelerated ? "available" : "not available, only the portable lanes are tested");
+
+  // every length up to a few blocks of 32 words at every alignment, then random lengths and alignments
+
+  for (uint32_t Length = 0; Length <= 600; ++Length)
+  {
+    for (uint32_t Offset = 0; Offset < 32; ++Offset)
+    {
+      const uint32_t Expected = XORRotateLeftReference(data.data() + Offset, Length);
+      Check(CMap::XORRotateLeft(data.data() + Offset, Length, false) == Expected, "map checksum length " + to_string(Length) + " offset " + to_string(Offset));
+      Check(CMap::XORRotateLeft(data.data() + Offset, Length) == Expected, "accelerated map checksum length " + to_string(Length) + " offset " + to_string(Offset));
+    }
+  }
+
+  for (uint32_t i = 0; i < 500; ++i)
+  {
+    const uint32_t Offset   = rng() % 64;
+    const uint32_t Length   = rng() % (data.size() - Offset);
+    const uint32_t Expected = XORRotateLeftReference(data.data() + Offset, Length);
+    Check(CMap::XORRotateLeft(data.data() + Offset, Length, false) == Expected, "map checksum length " + to_string(Length) + " offset " + to_string(Offset));
+    Check(CMap::XORRotateLeft(data.data() + Offset, Length) == Expected, "accelerated map checksum length " + to_string(Length) + " offset " + to_string(Offset));
+  }
+
+  // then the scripts CMap :: Load actually checksums, run from the directory containing mapcfgs/ (as "make bench" does)
+
+  static const char* Scripts[] = {"mapcfgs/common.j", "mapcfgs/blizzard.j", "mapcfgs/31/common.j", "mapcfgs/31/blizzard.j", "mapcfgs/rf/common.j", "mapcfgs/rf/blizzard.j", "mapcfgs/w3ce/common.j", "mapcfgs/w3ce/blizzard.j"};
+
+  for (const char* Script : Scripts)
+  {
+    const vector<uint8_t> Data = ReadScript(Script);
+
+    if (Data.empty())
+    {
+      Check(false, string("unable to read ") + Script);
+      continue;
+    }
+
+    const uint32_t Length = static_cast<uint32_t>(Data.size());
+    const uint32_t Seed   = rng();
+
+    printf(" %s (%u bytes)\n", Script, Length);
+
+    const uint32_t Expected = XORRotateLeftReference(Data.data(), Length);
+    Check(CMap::XORRotateLeft(Data.data(), Length, false) == Expected, string("map checksum of ") + Script);
+    Check(CMap::XORRotateLeft(Data.data(), Length) == Expected, string("accelerated map checksum of ") + Script);
+    Check(CMap::ChunkedChecksum(Data.data(), static_cast<int32_t>(Length), Seed) == ChunkedChecksumReference(Data.data(), Length, Seed), string("chunked map checksum of ") + Script);
+
+    Time("one word at a time", Data, [&]() { gSink = XORRotateLeftReference(Data.data(), Length); });
+    Time("lanes", Data, [&]() { gSink = CMap::XORRotateLeft(Data.data(), Length, false); });
+
+    if (Accelerated)
+      Time("avx2 lanes", Data, [&]() { gSink = CMap::XORRotateLeft(Data.data(), Length); });
+
+    Time("chunked, one word at a time", Data, [&]() { gSink = ChunkedChecksumReference(Data.data(), Length, Seed); });
+    Time("chunked", Data, [&]() { gSink = CMap::ChunkedChecksum(Data.data(), static_cast<int32_t>(Length), Seed); });
+  }
+}
+
+int main()
+{
+  // a fixed seed so a failure can be reproduced
+
+  mt19937         Rng(20101);
+  vector<uint8_t> Data(4 * 1024 * 1024);
+
+  for (auto& Byte : Data)
+    Byte = static_cast<uint8_t>(Rng());
+
+  TestCRC32(Data, Rng);
+  TestSHA1(Data, Rng);
+  TestXORRotateLeft(Data, Rng);
+
+  if (gFailures)
+  {
+    printf("%u checks failed\n", gFailures);
+    return 1;
+  }
+
+  printf("all checks passed\n");
+  return 0;
+}
@@ -20,8 +20,6 @@
 
 #include "aura.h"
 #include "crc32.h"
-#include "sha1.h"
-#include "csvparser.h"
 #include "config.h"
 #include "socket.h"
 #include "auradb.h"
@@ -34,11 +32,18 @@
 #include "irc.h"
 #include "util.h"
 #include "fileutil.h"
+#include "gameworker.h"
+#include "timerwheel.h"
+#include "metrics.h"
+#include "mapserver.h"
+#include "iptocountry.h"
+#include "log.h"
 
 #include <csignal>
 #include <cstdlib>
 #include <thread>
 #include <fstream>
+#include <algorithm>
 
 #define __STORMLIB_SELF__
 #include <StormLib.h>
@@ -65,17 +70,28 @@ static CAura* gAura    = nullptr;
 bool          gRestart = false;
 string gCFGFile;
 
-void Print2(const string& message)
+void Print2(const string& message, LogLevel level)
 {
+  if (!IsLogEnabled(level))
+    return;
+
+  // games running on a worker thread can't touch the irc connection so let the main thread print it
+
+  if (gAura && !gAura->IsMainThread())
+  {
+    gAura->QueueEvent([message, level]() { Print2(message, level); });
+    return;
+  }
+
   auto timenow = chrono::system_clock::to_time_t(chrono::system_clock::now());
   char *timestring  = ctime(&timenow);
   if (timestring[strlen(timestring) - 1] == '\n') timestring[strlen(timestring) - 1] = '\0';
   
   string new_message = "[" + string(timestring) + "] " + message;
 
-  Print(new_message);
+  Print(new_message, level);
 
-  if (gAura->m_IRC)
+  if (gAura && gAura->m_IRC)
     gAura->m_IRC->SendMessageIRC(message, string());
 }
 
@@ -102,6 +118,10 @@ int main(const int argc, const char* argv[])
   CConfig CFG;
   CFG.Read( gCFGFile );
 
+  // start the logging thread, everything printed from here on is written out in the background
+
+  CLogger* Logger = new CLogger(&CFG);
+
   Print("[AURA] starting up");
 
   signal(SIGINT, [](int32_t) -> void {
@@ -174,6 +194,10 @@ int main(const int argc, const char* argv[])
   WSACleanup();
 #endif
 
+  // flush the log before we exit or restart
+
+  delete Logger;
+
   // restart the program
 
   if (gRestart)
@@ -196,14 +220,26 @@ CAura::CAura(CConfig* CFG)
   : m_IRC(nullptr),
     m_UDPSocket(new CUDPSocket()),
     m_ReconnectSocket(new CTCPServer()),
+    m_Metrics(nullptr),
+    m_MapServer(nullptr),
     m_GPSProtocol(new CGPSProtocol()),
     m_CRC(new CCRC32()),
-    m_SHA(new CSHA1()),
     m_CurrentGame(nullptr),
+    m_MainThreadID(this_thread::get_id()),
     m_DB(new CAuraDB(CFG)),
+    m_IPToCountry(new CIPToCountry()),
     m_Map(nullptr),
+    m_MapCache(nullptr),
+    m_LoadedMap(nullptr),
+    m_MapLoading(false),
     m_Version(VERSION),
+    m_LastProfileTicks(GetTicks()),
+    m_LastSendBytesCopied(0),
+    m_SendBytesCopiedRate(0),
+    m_MapBytesSent(0),
+    m_GameThreads(0),
     m_HostCounter(1),
+    m_ScriptsWar3Version(0),
     m_Exiting(false),
     m_Enabled(true),
     m_Ready(true)
@@ -226,6 +262,20 @@ CAura::CAura(CConfig* CFG)
     return;
   }
 
+  // the metrics listener is optional, failing to open it isn't fatal
+
+  const uint16_t MetricsPort = CFG->GetInt("bot_metricsport", 0);
+
+  if (MetricsPort != 0)
+    m_Metrics = new CMetricsServer(this, CFG->GetString("bot_metricsaddress", "127.0.0.1"), MetricsPort);
+
+  // so is the map server, it runs on its own thread
+
+  const uint16_t MapServerPort = CFG->GetInt("bot_mapserverport", 0);
+
+  if (MapServerPort != 0)
+    m_MapServer = new CMapServer(CFG->GetString("bot_mapserveraddress", string()), MapServerPort, CFG->GetString("bot_mapserverurl", string()));
+
   m_CRC->Initialize();
   m_HostPort       = CFG->GetInt("bot_hostport", 6112);
   m_DefaultMap     = CFG->GetString("bot_defaultmap", "dota");
@@ -274,7 +324,7 @@ CAura::CAura(CConfig* CFG)
   }
 
   if (IRC_Server.empty() || IRC_NickName.empty() || IRC_Port == 0 || IRC_Port >= 65535)
-    Print("[AURA] warning - irc connection not found in config file");
+    Print("[AURA] warning - irc connection not found in config file", LOG_WARNING);
   else
     m_IRC = new CIRC(this, IRC_Server, IRC_NickName, IRC_UserName, IRC_Password, IRC_Channels, IRC_RootAdmins, IRC_Port, IRC_CommandTrigger[0]);
 
@@ -344,7 +394,7 @@ CAura::CAura(CConfig* CFG)
   }
 
   if (m_BNETs.empty())
-    Print("[AURA] warning - no battle.net connections found in config file");
+    Print("[AURA] warning - no battle.net connections found in config file", LOG_WARNING);
 
   if (m_BNETs.empty() && !m_IRC)
   {
@@ -364,26 +414,55 @@ CAura::CAura(CConfig* CFG)
   if (m_DefaultMap.size() < 4 || m_DefaultMap.substr(m_DefaultMap.size() - 4) != ".cfg")
     m_DefaultMap += ".cfg";
 
+  const string MapCacheFile = CFG->GetString("bot_mapcachefile", "mapcache.txt");
+
+  if (!MapCacheFile.empty())
+    m_MapCache = new CMapCache(MapCacheFile);
+
   CConfig MapCFG;
   MapCFG.Read(m_MapCFGPath + m_DefaultMap);
-  m_Map = new CMap(this, &MapCFG, m_MapCFGPath + m_DefaultMap);
+  m_Map = new CMap(this, GetMapLoadSettings(), &MapCFG, m_MapCFGPath + m_DefaultMap);
 
   // load the iptocountry data
 
-  LoadIPToCountryData();
+  m_IPToCountry->Load("ip-to-country.csv", "ip-to-country.bin");
+
+  // start the worker threads for games in progress
+
+  m_GameThreads = CFG->GetInt("bot_gamethreads", 0);
+
+  for (uint32_t i = 1; i <= m_GameThreads; ++i)
+    m_GameWorkers.push_back(new CGameWorker(this, i));
+
+  if (!m_GameWorkers.empty())
+    Print("[AURA] updating games in progress on " + to_string(m_GameWorkers.size()) + " worker thread(s)");
 }
 
 CAura::~CAura()
 {
+  // stop the worker threads first, they give their sockets back and we delete any games they still own below
+
+  for (auto& worker : m_GameWorkers)
+    delete worker;
+
+  // wait for the map loader too, the map it loaded is never going to be used
+
+  if (m_MapLoader.joinable())
+    m_MapLoader.join();
+
+  delete m_LoadedMap;
   delete m_UDPSocket;
   delete m_CRC;
-  delete m_SHA;
   delete m_ReconnectSocket;
+  delete m_Metrics;
+  delete m_MapServer;
   delete m_GPSProtocol;
 
   if (m_Map)
     delete m_Map;
 
+  delete m_MapCache;
+
   for (auto& socket : m_ReconnectSockets)
     delete socket;
 
@@ -396,6 +475,7 @@ CAura::~CAura()
     delete game;
 
   delete m_DB;
+  delete m_IPToCountry;
 
   if (m_IRC)
     delete m_IRC;
@@ -403,14 +483,58 @@ CAura::~CAura()
 
 bool CAura::Update()
 {
+  // process any events queued by the worker threads
+
+  vector<function<void()>> QueuedEvents;
+
+  {
+    lock_guard<mutex> Lock(m_QueuedEventsMutex);
+    QueuedEvents.swap(m_QueuedEvents);
+  }
+
+  for (auto& event : QueuedEvents)
+    event();
+
+  // report the results of the finished database writes
+
+  m_DB->Update();
+
   uint32_t NumFDs = 0;
 
+  fd_set fd, send_fd;
+  FD_ZERO(&fd);
+  FD_ZERO(&send_fd);
+
+  if (m_ReconnectSocket->HasError())
+  {
+    Print("[AURA] GProxy++ reconnect listener error (" + m_ReconnectSocket->GetErrorString() + ")");
+    return true;
+  }
+
+  // before we block we need to determine how long to block for
+  // the games, battle.net connections and irc schedule their deadlines on this thread's timer wheel so block until the earliest one
+  // 50 ms is the hard maximum
+
+  CTimerWheel*  Wheel        = CTimerWheel::GetDefault();
+  int64_t       usecBlock    = 50000;
+  const int64_t NextDeadline = Wheel->GetNextDeadline();
+
+  if (NextDeadline != -1)
+    usecBlock = max<int64_t>(0, min<int64_t>(usecBlock, (NextDeadline - GetTicks()) * 1000));
+
+#ifdef AURA_EPOLL
+  // every stream socket registered itself with the poller when it was created so there's nothing to collect here
+  // the poller only flags the sockets that became ready and DoRecv/DoSend/Accept check those flags
+
+  CSocketPoller* Poller = CSocketPoller::GetDefault();
+  NumFDs                = Poller->GetNumSockets();
+
+  if (NumFDs > 0)
+    Poller->Wait(usecBlock);
+#else
   // take every socket we own and throw it in one giant select statement so we can block on all sockets
 
   int32_t nfds = 0;
-  fd_set  fd, send_fd;
-  FD_ZERO(&fd);
-  FD_ZERO(&send_fd);
 
   // 1. the current game's server and player sockets
 
@@ -420,7 +544,10 @@ bool CAura::Update()
   // 2. all running games' player sockets
 
   for (auto& game : m_Games)
-    NumFDs += game->SetFD(&fd, &send_fd, &nfds);
+  {
+    if (!game->GetWorker())
+      NumFDs += game->SetFD(&fd, &send_fd, &nfds);
+  }
 
   // 3. all battle.net sockets
 
@@ -434,16 +561,8 @@ bool CAura::Update()
 
   // 5. reconnect socket
 
-  if (m_ReconnectSocket->HasError())
-  {
-    Print("[AURA] GProxy++ reconnect listener error (" + m_ReconnectSocket->GetErrorString() + ")");
-    return true;
-  }
-  else
-  {
-    m_ReconnectSocket->SetFD(&fd, &send_fd, &nfds);
-    ++NumFDs;
-  }
+  m_ReconnectSocket->SetFD(&fd, &send_fd, &nfds);
+  ++NumFDs;
 
   // 6. reconnect sockets
 
@@ -453,16 +572,10 @@ bool CAura::Update()
     ++NumFDs;
   }
 
-  // before we call select we need to determine how long to block for
-  // 50 ms is the hard maximum
+  // 7. metrics sockets
 
-  int64_t usecBlock = 50000;
-
-  for (auto& game : m_Games)
-  {
-    if (game->GetNextTimedActionTicks() * 1000 < usecBlock)
-      usecBlock = game->GetNextTimedActionTicks() * 1000;
-  }
+  if (m_Metrics)
+    NumFDs += m_Metrics->SetFD(&fd, &send_fd, &nfds);
 
   struct timeval tv;
   tv.tv_sec  = 0;
@@ -478,6 +591,7 @@ bool CAura::Update()
 #else
   select(nfds + 1, &fd, nullptr, nullptr, &tv);
   select(nfds + 1, nullptr, &send_fd, nullptr, &send_tv);
+#endif
 #endif
 
   if (NumFDs == 0)
@@ -488,12 +602,21 @@ bool CAura::Update()
     std::this_thread::sleep_for(std::chrono::milliseconds(200));
   }
 
-  bool Exit = false;
+  const int64_t UpdateStart = GetMicroTicks();
+  bool          Exit        = false;
 
   // update running games
 
   for (auto i = begin(m_Games); i != end(m_Games);)
   {
+    // games owned by a worker thread are updated there
+
+    if ((*i)->GetWorker())
+    {
+      ++i;
+      continue;
+    }
+
     if ((*i)->Update(&fd, &send_fd))
     {
       Print2("[AURA] deleting game [" + (*i)->GetGameName() + "]");
@@ -502,32 +625,63 @@ bool CAura::Update()
       i = m_Games.erase(i);
     }
     else
-    {
-      (*i)->UpdatePost(&send_fd);
       ++i;
-    }
   }
 
   // update current game
 
-  if (m_CurrentGame)
+  if (m_CurrentGame && m_CurrentGame->Update(&fd, &send_fd))
   {
-    if (m_CurrentGame->Update(&fd, &send_fd))
+    Print2("[AURA] deleting current game [" + m_CurrentGame->GetGameName() + "]");
+    delete m_CurrentGame;
+    m_CurrentGame = nullptr;
+
+    for (auto& bnet : m_BNETs)
     {
-      Print2("[AURA] deleting current game [" + m_CurrentGame->GetGameName() + "]");
-      delete m_CurrentGame;
-      m_CurrentGame = nullptr;
+      bnet->QueueGameUncreate();
+      bnet->QueueEnterChat();
+    }
+  }
 
-      for (auto& bnet : m_BNETs)
-      {
-        bnet->QueueGameUncreate();
-        bnet->QueueEnterChat();
-      }
+  // sample the profiling counters once per second
+
+  const int64_t Ticks = GetTicks();
+
+  if (Ticks - m_LastProfileTicks >= 1000)
+  {
+    const uint64_t BytesCopied = CSendQueue::GetBytesCopied();
+
+    m_SendBytesCopiedRate = (BytesCopied - m_LastSendBytesCopied) * 1000 / (Ticks - m_LastProfileTicks);
+    m_LastSendBytesCopied = BytesCopied;
+    m_LastProfileTicks    = Ticks;
+  }
+
+  // run the timers that are due (e.g. sending the action packets and the battle.net chat queue)
+  // this happens after the games have received this loop's data and before anything is sent
+
+  Wheel->Advance(GetTicks());
+
+  // flush the games' send buffers
+
+  for (auto& game : m_Games)
+  {
+    if (game->GetWorker())
+      continue;
+
+    game->UpdatePost(&send_fd);
+
+    // the game has left the lobby, hand it to the least busy worker thread
+
+    if (!m_GameWorkers.empty())
+    {
+      auto Worker = min_element(begin(m_GameWorkers), end(m_GameWorkers), [](CGameWorker* a, CGameWorker* b) { return a->GetNumGames() < b->GetNumGames(); });
+      (*Worker)->AdoptGame(game);
     }
-    else if (m_CurrentGame)
-      m_CurrentGame->UpdatePost(&send_fd);
   }
 
+  if (m_CurrentGame)
+    m_CurrentGame->UpdatePost(&send_fd);
+
   // update battle.net connections
 
   for (auto& bnet : m_BNETs)
@@ -558,8 +712,8 @@ bool CAura::Update()
     }
 
     (*i)->DoRecv(&fd);
-    string*                    RecvBuffer = (*i)->GetBytes();
-    const std::vector<uint8_t> Bytes      = CreateByteArray((uint8_t*)RecvBuffer->c_str(), RecvBuffer->size());
+    CRecvBuffer*    RecvBuffer = (*i)->GetRecvBuffer();
+    const CByteSpan Bytes(RecvBuffer->GetData(), RecvBuffer->GetSize());
 
     // a packet is at least 4 bytes
 
@@ -575,22 +729,27 @@ bool CAura::Update()
         {
           if (Bytes[1] == CGPSProtocol::GPS_RECONNECT && Length == 13)
           {
+            const uint8_t  PID          = Bytes[4];
             const uint32_t ReconnectKey = ByteArrayToUInt32(Bytes, false, 5);
             const uint32_t LastPacket   = ByteArrayToUInt32(Bytes, false, 9);
 
             // look for a matching player in a running game
 
-            CGamePlayer* Match = nullptr;
+            CGamePlayer* Match     = nullptr;
+            CGame*       MatchGame = nullptr;
 
             for (auto& game : m_Games)
             {
+              lock_guard<mutex> Lock(game->GetMutex());
+
               if (game->GetGameLoaded())
               {
-                CGamePlayer* Player = game->GetPlayerFromPID(Bytes[4]);
+                CGamePlayer* Player = game->GetPlayerFromPID(PID);
 
                 if (Player && Player->GetGProxy() && Player->GetGProxyReconnectKey() == ReconnectKey)
                 {
-                  Match = Player;
+                  Match     = Player;
+                  MatchGame = game;
                   break;
                 }
               }
@@ -599,9 +758,15 @@ bool CAura::Update()
             if (Match)
             {
               // reconnect successful!
+              // if the game is on a worker thread the worker checks the player again and finishes the reconnect there
+
+              RecvBuffer->Consume(Length);
+
+              if (MatchGame->GetWorker())
+                MatchGame->GetWorker()->GProxyReconnect(MatchGame, *i, PID, ReconnectKey, LastPacket);
+              else
+                Match->EventGProxyReconnect(*i, LastPacket);
 
-              *RecvBuffer = RecvBuffer->substr(Length);
-              Match->EventGProxyReconnect(*i, LastPacket);
               i = m_ReconnectSockets.erase(i);
               continue;
             }
@@ -646,6 +811,12 @@ bool CAura::Update()
     ++i;
   }
 
+  // update the metrics listener
+
+  if (m_Metrics)
+    m_Metrics->Update(&fd, &send_fd);
+
+  m_PerfUpdate.Record(GetMicroTicks() - UpdateStart);
   return m_Exiting || Exit;
 }
 
@@ -685,6 +856,70 @@ void CAura::EventGameDeleted(CGame* game)
   }
 }
 
+void CAura::EventWorkerGameOver(CGameWorker* worker, CGame* game)
+{
+  // a game on a worker thread is over, the worker no longer touches it so we can safely announce it here
+
+  Print2("[AURA] deleting game [" + game->GetGameName() + "]");
+  EventGameDeleted(game);
+  m_Games.erase(remove(begin(m_Games), end(m_Games), game), end(m_Games));
+
+  // and give it back to the worker to delete (the destructor saves the game to the database)
+
+  worker->DeleteGame(game);
+}
+
+void CAura::EventMapLoaded()
+{
+  // the loader is done with the new map so swap it in, games already hosted have their own copy of the old one
+
+  m_MapLoader.join();
+  delete m_Map;
+  m_Map        = m_LoadedMap;
+  m_LoadedMap  = nullptr;
+  m_MapLoading = false;
+
+  function<void(CMap*)> Callback;
+  Callback.swap(m_MapLoadedCallback);
+
+  if (Callback)
+    Callback(m_Map);
+}
+
+void CAura::QueueEvent(function<void()> event)
+{
+  lock_guard<mutex> Lock(m_QueuedEventsMutex);
+  m_QueuedEvents.push_back(std::move(event));
+}
+
+bool CAura::LoadMap(const CConfig& mapCFG, const string& cfgFile, function<void(CMap*)> callback)
+{
+  // reading and hashing a map can take a while so it's done on another thread, the current map stays loaded until the new one is ready
+  // only one map is loaded at a time (there's only room for one in m_LoadedMap)
+
+  if (m_MapLoading)
+    return false;
+
+  m_MapLoading        = true;
+  m_MapLoadedCallback = std::move(callback);
+  m_MapLoader         = thread([this, Settings = GetMapLoadSettings(), MapCFG = mapCFG, cfgFile]() mutable {
+    m_LoadedMap = new CMap(this, Settings, &MapCFG, cfgFile);
+    QueueEvent([this]() { EventMapLoaded(); });
+  });
+
+  return true;
+}
+
+CMapLoadSettings CAura::GetMapLoadSettings() const
+{
+  CMapLoadSettings Settings;
+  Settings.MapPath            = m_MapPath;
+  Settings.MapCFGPath         = m_MapCFGPath;
+  Settings.LANWar3Version     = m_LANWar3Version;
+  Settings.ScriptsWar3Version = m_ScriptsWar3Version;
+  return Settings;
+}
+
 void CAura::ReloadConfigs()
 {
   CConfig CFG;
@@ -712,7 +947,7 @@ void CAura::SetConfigs(CConfig* CFG)
   if (m_VirtualHostName.size() > 15)
   {
     m_VirtualHostName = "|cFF4080C0Aura";
-    Print("[AURA] warning - bot_virtualhostname is longer than 15 characters, using default virtual host name");
+    Print("[AURA] warning - bot_virtualhostname is longer than 15 characters, using default virtual host name", LOG_WARNING);
   }
 
   m_AutoLock           = CFG->GetInt("bot_autolock", 0) == 0 ? false : true;
@@ -725,13 +960,49 @@ void CAura::SetConfigs(CConfig* CFG)
   m_Latency            = CFG->GetInt("bot_latency", 100);
   m_SyncLimit          = CFG->GetInt("bot_synclimit", 50);
   m_VoteKickPercentage = CFG->GetInt("bot_votekickpercentage", 70);
+  m_PerfFile           = CFG->GetString("bot_perffile", "perf.txt");
 
   if (m_VoteKickPercentage > 100)
     m_VoteKickPercentage = 100;
 }
 
+bool CAura::DumpPerf()
+{
+  ofstream File(m_PerfFile, ios::app);
+
+  if (File.fail())
+  {
+    Print("[AURA] warning - unable to write performance histograms to [" + m_PerfFile + "]", LOG_WARNING);
+    return false;
+  }
+
+  time_t Now = time(nullptr);
+  File << "=== " << ctime(&Now);
+  File << "[AURA] update: " << m_PerfUpdate.GetSummary("us") << endl;
+
+  // the games owned by worker threads are being updated right now so we have to hold their mutex
+
+  vector<CGame*> Games = m_Games;
+
+  if (m_CurrentGame)
+    Games.push_back(m_CurrentGame);
+
+  for (auto& game : Games)
+  {
+    lock_guard<mutex> Lock(game->GetMutex());
+
+    for (const auto& line : game->GetPerfReport())
+      File << "[GAME: " << game->GetGameName() << "] " << line << endl;
+  }
+
+  Print("[AURA] wrote performance histograms to [" + m_PerfFile + "]");
+  return true;
+}
+
 void CAura::ExtractScripts(const uint8_t War3Version)
 {
+  m_ScriptsWar3Version = War3Version;
+
   void*        MPQ;
   const string MPQFileName = [&]() {
     if (War3Version >= 28)
@@ -773,7 +1044,7 @@ void CAura::ExtractScripts(const uint8_t War3Version)
           FileWrite(m_MapCFGPath + "common.j", reinterpret_cast<uint8_t*>(SubFileData), BytesRead);
         }
         else
-          Print(R"([AURA] warning - unable to extract Scripts\common.j from MPQ file)");
+          Print(R"([AURA] warning - unable to extract Scripts\common.j from MPQ file)", LOG_WARNING);
 
         delete[] SubFileData;
       }
@@ -800,7 +1071,7 @@ void CAura::ExtractScripts(const uint8_t War3Version)
           FileWrite(m_MapCFGPath + "blizzard.j", reinterpret_cast<uint8_t*>(SubFileData), BytesRead);
         }
         else
-          Print(R"([AURA] warning - unable to extract Scripts\blizzard.j from MPQ file)");
+          Print(R"([AURA] warning - unable to extract Scripts\blizzard.j from MPQ file)", LOG_WARNING);
 
         delete[] SubFileData;
       }
@@ -815,78 +1086,13 @@ void CAura::ExtractScripts(const uint8_t War3Version)
   else
   {
 #ifdef WIN32
-    Print("[AURA] warning - unable to load MPQ file [" + MPQFileName + "] - error code " + to_string((uint32_t)GetLastError()));
+    Print("[AURA] warning - unable to load MPQ file [" + MPQFileName + "] - error code " + to_string((uint32_t)GetLastError()), LOG_WARNING);
 #else
-    Print("[AURA] warning - unable to load MPQ file [" + MPQFileName + "] - error code " + to_string(static_cast<int32_t>(GetLastError())));
+    Print("[AURA] warning - unable to load MPQ file [" + MPQFileName + "] - error code " + to_string(static_cast<int32_t>(GetLastError())), LOG_WARNING);
 #endif
   }
 }
 
-void CAura::LoadIPToCountryData()
-{
-  ifstream in;
-  in.open("ip-to-country.csv");
-
-  if (in.fail())
-    Print("[AURA] warning - unable to read file [ip-to-country.csv], iptocountry data not loaded");
-  else
-  {
-    Print("[AURA] started loading [ip-to-country.csv]");
-
-    // the begin and commit statements are optimizations
-    // we're about to insert ~4 MB of data into the database so if we allow the database to treat each insert as a transaction it will take a LONG time
-
-    if (!m_DB->Begin())
-      Print("[AURA] warning - failed to begin database transaction, iptocountry data not loaded");
-    else
-    {
-      uint8_t   Percent = 0;
-      string    Line, Skip, IP1, IP2, Country;
-      CSVParser parser;
-
-      // get length of file for the progress meter
-
-      in.seekg(0, ios::end);
-      const uint32_t FileLength = in.tellg();
-      in.seekg(0, ios::beg);
-
-      while (!in.eof())
-      {
-        getline(in, Line);
-
-        if (Line.empty())
-          continue;
-
-        parser << Line;
-        parser >> Skip;
-        parser >> Skip;
-        parser >> IP1;
-        parser >> IP2;
-        parser >> Country;
-        m_DB->FromAdd(stoul(IP1), stoul(IP2), Country);
-
-        // it's probably going to take awhile to load the iptocountry data (~10 seconds on my 3.2 GHz P4 when using SQLite3)
-        // so let's print a progress meter just to keep the user from getting worried
-
-        uint8_t NewPercent = static_cast<uint8_t>((float)in.tellg() / FileLength * 100);
-
-        if (NewPercent != Percent && NewPercent % 10 == 0)
-        {
-          Percent = NewPercent;
-          Print("[AURA] iptocountry data: " + to_string(Percent) + "% loaded");
-        }
-      }
-
-      if (!m_DB->Commit())
-        Print("[AURA] warning - failed to commit database transaction, iptocountry data not loaded");
-      else
-        Print("[AURA] finished loading [ip-to-country.csv]");
-    }
-
-    in.close();
-  }
-}
-
 void CAura::CreateGame(CMap* map, uint8_t gameState, string gameName, string ownerName, string creatorName, CBNET* creatorServer, bool whisper)
 {
   if (!m_Enabled)
@@ -21,9 +21,15 @@
 #ifndef AURA_AURA_H_
 #define AURA_AURA_H_
 
+#include "histogram.h"
+
 #include <cstdint>
 #include <vector>
 #include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
 
 //
 // CAura
@@ -34,13 +40,18 @@ class CTCPSocket;
 class CTCPServer;
 class CGPSProtocol;
 class CCRC32;
-class CSHA1;
 class CBNET;
 class CGame;
 class CAuraDB;
 class CMap;
+class CMapCache;
+struct CMapLoadSettings;
 class CConfig;
 class CIRC;
+class CGameWorker;
+class CMetricsServer;
+class CMapServer;
+class CIPToCountry;
 
 class CAura
 {
@@ -48,15 +59,26 @@ public:
   CIRC*                    m_IRC;
   CUDPSocket*              m_UDPSocket;                  // a UDP socket for sending broadcasts and other junk (used with !sendlan)
   CTCPServer*              m_ReconnectSocket;            // listening socket for GProxy++ reliable reconnects
+  CMetricsServer*          m_Metrics;                    // the Prometheus metrics listener (nullptr if bot_metricsport is 0)
+  CMapServer*              m_MapServer;                  // the HTTP map download server (nullptr if bot_mapserverport is 0)
   std::vector<CTCPSocket*> m_ReconnectSockets;           // std::vector of sockets attempting to reconnect (connected but not identified yet)
   CGPSProtocol*            m_GPSProtocol;                // class for gproxy protocol
   CCRC32*                  m_CRC;                        // for calculating CRC's
-  CSHA1*                   m_SHA;                        // for calculating SHA1's
   std::vector<CBNET*>      m_BNETs;                      // all our battle.net connections (there can be more than one)
   CGame*                   m_CurrentGame;                // this game is still in the lobby state
   std::vector<CGame*>      m_Games;                      // these games are in progress
+  std::vector<CGameWorker*> m_GameWorkers;               // worker threads that update the games in progress (empty if bot_gamethreads is 0)
+  std::vector<std::function<void()>> m_QueuedEvents;     // events queued by the worker threads to be processed by the main thread
+  std::mutex               m_QueuedEventsMutex;          // protects m_QueuedEvents
+  std::thread::id          m_MainThreadID;               // the thread CAura :: Update runs on
   CAuraDB*                 m_DB;                         // database
+  CIPToCountry*            m_IPToCountry;                // the country of each ip for !from and !checkme
   CMap*                    m_Map;                        // the currently loaded map
+  CMapCache*               m_MapCache;                   // the calculated metadata of maps we've loaded before (nullptr if bot_mapcachefile is empty)
+  std::thread              m_MapLoader;                  // loads the next map in the background so !map and !load don't stall the main loop
+  CMap*                    m_LoadedMap;                  // the map the loader has finished, waiting for EventMapLoaded to replace m_Map with it
+  std::function<void(CMap*)> m_MapLoadedCallback;        // called by EventMapLoaded with the new map
+  bool                     m_MapLoading;                 // a map is being loaded (only one at a time)
   std::string              m_Version;                    // Aura++ version string
   std::string              m_MapCFGPath;                 // config value: map cfg path
   std::string              m_MapPath;                    // config value: map path
@@ -66,9 +88,16 @@ public:
   std::string              m_BindAddress;                // config value: the address to host games on
   std::string              m_DefaultMap;                 // config value: default map (map.cfg)
   std::string              m_ListMapCFG;                 // config value: default map (map.cfg)
+  std::string              m_PerfFile;                   // config value: the file !perfdump writes the performance histograms to
+  CHistogram               m_PerfUpdate;                 // microseconds spent in each Update (not counting the time spent blocking)
+  int64_t                  m_LastProfileTicks;           // GetTicks when the profiling counters were last sampled
+  uint64_t                 m_LastSendBytesCopied;        // CSendQueue :: GetBytesCopied at the last sample
+  uint64_t                 m_SendBytesCopiedRate;        // bytes copied into socket send queues per second (over the last sample)
+  uint64_t                 m_MapBytesSent;               // map bytes sent to downloading players
   uint32_t                 m_ReconnectWaitTime;          // config value: the maximum number of minutes to wait for a GProxy++ reliable reconnect
   uint32_t                 m_MaxGames;                   // config value: maximum number of games in progress
-  uint32_t                 m_HostCounter;                // the current host counter (a unique number to identify a game, incremented each time a game is created)
+  uint32_t                 m_GameThreads;                // config value: number of worker threads for games in progress (0 to update everything on the main thread)
+  std::atomic<uint32_t>    m_HostCounter;                // the current host counter (a unique number to identify a game, incremented each time a game is created or rehosted)
   uint32_t                 m_AllowDownloads;             // config value: allow map downloads or not
   uint32_t                 m_MaxDownloaders;             // config value: maximum number of map downloaders at the same time
   uint32_t                 m_MaxDownloadSpeed;           // config value: maximum total map download speed in KB/sec
@@ -81,6 +110,7 @@ public:
   uint16_t                 m_HostPort;                   // config value: the port to host games on
   uint16_t                 m_ReconnectPort;              // config value: the port to listen for GProxy++ reliable reconnects on
   uint8_t                  m_LANWar3Version;             // config value: LAN warcraft 3 version
+  uint8_t                  m_ScriptsWar3Version;         // the warcraft 3 version common.j and blizzard.j were extracted for (they affect map_crc)
   int32_t                  m_CommandTrigger;             // config value: the command trigger inside games
 //  bool                     m_LANBonjour;                 // config value: LAN warcraft 3 support bonjour version
 //  bool                     m_War3Reforged;               // config value: LAN warcraft 3 Reforged version 
@@ -102,19 +132,29 @@ public:
 
   void EventBNETGameRefreshFailed(CBNET* bnet);
   void EventGameDeleted(CGame* game);
+  void EventWorkerGameOver(CGameWorker* worker, CGame* game);
+  void EventMapLoaded();
 
   // other functions
 
+  void QueueEvent(std::function<void()> event);
+  bool LoadMap(const CConfig& mapCFG, const std::string& cfgFile, std::function<void(CMap*)> callback);
+  CMapLoadSettings GetMapLoadSettings() const;
   void ReloadConfigs();
   void SetConfigs(CConfig* CFG);
   void ExtractScripts(const uint8_t War3Version);
-  void LoadIPToCountryData();
+  bool DumpPerf();
   void CreateGame(CMap* map, uint8_t gameState, std::string gameName, std::string ownerName, std::string creatorName, CBNET* nCreatorServer, bool whisper);
 
   inline bool GetReady() const
   {
     return m_Ready;
   }
+
+  inline bool IsMainThread() const
+  {
+    return std::this_thread::get_id() == m_MainThreadID;
+  }
 };
 
 #endif // AURA_AURA_H_
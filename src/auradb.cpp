@@ -27,6 +27,8 @@
 #include <utility>
 #include <algorithm>
 
+#define DB_JOURNAL_MAX 100 // the most players in the journal before it's written regardless of db_sqlite3_flushinterval
+
 using namespace std;
 
 //
@@ -34,28 +36,92 @@ using namespace std;
 //
 
 CSQLITE3::CSQLITE3(const string& filename)
-  : m_Ready(true)
+  : m_Prepares(0),
+    m_CacheHits(0),
+    m_Ready(true)
 {
   if (sqlite3_open_v2(filename.c_str(), reinterpret_cast<sqlite3**>(&m_DB), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
     m_Ready = false;
+
+  // there's more than one connection to the database (see CAuraDB), wait for the other one to finish writing instead of failing
+
+  sqlite3_busy_timeout(static_cast<sqlite3*>(m_DB), 5000);
 }
 
 CSQLITE3::~CSQLITE3()
 {
+  for (auto& statement : m_Statements)
+    sqlite3_finalize(static_cast<sqlite3_stmt*>(statement.second.first));
+
   sqlite3_close(static_cast<sqlite3*>(m_DB));
 }
 
+void* CSQLITE3::Acquire(const string& query, pair<void*, bool>** entry)
+{
+  auto Cached = m_Statements.find(query);
+
+  if (Cached != end(m_Statements) && !Cached->second.second)
+  {
+    ++m_CacheHits;
+    Cached->second.second = true;
+    *entry                = &Cached->second;
+    return Cached->second.first;
+  }
+
+  void* Statement = nullptr;
+  sqlite3_prepare_v2(static_cast<sqlite3*>(m_DB), query.c_str(), -1, reinterpret_cast<sqlite3_stmt**>(&Statement), nullptr);
+  ++m_Prepares;
+
+  // only cache the statement if it was prepared successfully and there isn't one already (i.e. the cached one is in use)
+
+  *entry = nullptr;
+
+  if (Statement && Cached == end(m_Statements))
+    *entry = &m_Statements.emplace(query, make_pair(Statement, true)).first->second;
+
+  return Statement;
+}
+
+void CSQLITE3::Release(void* statement, pair<void*, bool>* entry)
+{
+  if (!entry)
+  {
+    sqlite3_finalize(static_cast<sqlite3_stmt*>(statement));
+    return;
+  }
+
+  sqlite3_reset(static_cast<sqlite3_stmt*>(statement));
+  sqlite3_clear_bindings(static_cast<sqlite3_stmt*>(statement));
+  entry->second = false;
+}
+
+//
+// CSQLITE3Statement
+//
+
+CSQLITE3Statement::CSQLITE3Statement(CSQLITE3* db, const string& query)
+  : m_DB(db),
+    m_Statement(nullptr),
+    m_Entry(nullptr)
+{
+  m_Statement = m_DB->Acquire(query, &m_Entry);
+}
+
+CSQLITE3Statement::~CSQLITE3Statement()
+{
+  if (m_Statement)
+    m_DB->Release(m_Statement, m_Entry);
+}
+
 //
 // CAuraDB
 //
 
 CAuraDB::CAuraDB(CConfig* CFG)
-  : FromAddStmt(nullptr),
-    FromCheckStmt(nullptr),
-    BanCheckStmt(nullptr),
-    AdminCheckStmt(nullptr),
-    RootAdminCheckStmt(nullptr),
-    m_HasError(false)
+  : m_WriteDB(nullptr),
+    m_HasError(false),
+    m_FlushInterval(max(CFG->GetInt("db_sqlite3_flushinterval", 5), 0)),
+    m_Exiting(false)
 {
   Print("[SQLITE3] version " + string(SQLITE_VERSION));
   m_File = CFG->GetString("db_sqlite3_file", "aura.dbs");
@@ -76,28 +142,30 @@ CAuraDB::CAuraDB(CConfig* CFG)
 
   // find the schema number so we can determine whether we need to upgrade or not
 
-  string        SchemaNumber;
-  sqlite3_stmt* Statement;
-  m_DB->Prepare(R"(SELECT value FROM config WHERE name="schema_number")", reinterpret_cast<void**>(&Statement));
+  // the statement is in its own scope so it's reset before the tables are changed below
+
+  string SchemaNumber;
 
-  if (Statement)
   {
-    int32_t RC = m_DB->Step(Statement);
+    CSQLITE3Statement Statement(m_DB, R"(SELECT value FROM config WHERE name="schema_number")");
 
-    if (RC == SQLITE_ROW)
+    if (Statement)
     {
-      if (sqlite3_column_count(Statement) == 1)
-        SchemaNumber = string((char*)sqlite3_column_text(Statement, 0));
-      else
-        Print("[SQLITE3] error getting schema number - row doesn't have 1 column");
-    }
-    else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error getting schema number - " + m_DB->GetError());
+      int32_t RC = m_DB->Step(Statement);
 
-    m_DB->Finalize(Statement);
+      if (RC == SQLITE_ROW)
+      {
+        if (sqlite3_column_count(Statement) == 1)
+          SchemaNumber = string((char*)sqlite3_column_text(Statement, 0));
+        else
+          Print("[SQLITE3] error getting schema number - row doesn't have 1 column", LOG_ERROR);
+      }
+      else if (RC == SQLITE_ERROR)
+        Print("[SQLITE3] error getting schema number - " + m_DB->GetError(), LOG_ERROR);
+    }
+    else
+      Print("[SQLITE3] prepare error getting schema number - " + m_DB->GetError(), LOG_ERROR);
   }
-  else
-    Print("[SQLITE3] prepare error getting schema number - " + m_DB->GetError());
 
   if (SchemaNumber.empty())
   {
@@ -111,18 +179,18 @@ CAuraDB::CAuraDB(CConfig* CFG)
     Print("[SQLITE3] assuming database is empty");
 
     if (m_DB->Exec(R"(CREATE TABLE admins ( id INTEGER PRIMARY KEY, name TEXT NOT NULL, server TEXT NOT NULL DEFAULT "" ))") != SQLITE_OK)
-      Print("[SQLITE3] error creating admins table - " + m_DB->GetError());
+      Print("[SQLITE3] error creating admins table - " + m_DB->GetError(), LOG_ERROR);
 
     if (m_DB->Exec("CREATE TABLE bans ( id INTEGER PRIMARY KEY, server TEXT NOT NULL, name TEXT NOT NULL, date TEXT NOT NULL, admin TEXT NOT NULL, reason TEXT, ip TEXT )") != SQLITE_OK)
-      Print("[SQLITE3] error creating bans table - " + m_DB->GetError());
+      Print("[SQLITE3] error creating bans table - " + m_DB->GetError(), LOG_ERROR);
 
     if (m_DB->Exec("CREATE TABLE players ( id INTEGER PRIMARY KEY, name TEXT NOT NULL, games INTEGER, dotas INTEGER, loadingtime INTEGER, duration INTEGER, left INTEGER, wins INTEGER, losses INTEGER, kills INTEGER, deaths INTEGER, creepkills INTEGER, creepdenies INTEGER, assists INTEGER, neutralkills INTEGER, towerkills INTEGER, raxkills INTEGER, courierkills INTEGER )") != SQLITE_OK)
-      Print("[SQLITE3] error creating players table - " + m_DB->GetError());
+      Print("[SQLITE3] error creating players table - " + m_DB->GetError(), LOG_ERROR);
 
     if (m_DB->Exec("CREATE TABLE config ( name TEXT NOT NULL PRIMARY KEY, value TEXT NOT NULL )") != SQLITE_OK)
-      Print("[SQLITE3] error creating config table - " + m_DB->GetError());
+      Print("[SQLITE3] error creating config table - " + m_DB->GetError(), LOG_ERROR);
 
-    m_DB->Prepare(R"(INSERT INTO config VALUES ( "schema_number", ? ))", reinterpret_cast<void**>(&Statement));
+    CSQLITE3Statement Statement(m_DB, R"(INSERT INTO config VALUES ( "schema_number", ? ))");
 
     if (Statement)
     {
@@ -131,29 +199,47 @@ CAuraDB::CAuraDB(CConfig* CFG)
       const int32_t RC = m_DB->Step(Statement);
 
       if (RC == SQLITE_ERROR)
-        Print("[SQLITE3] error inserting schema number [2] - " + m_DB->GetError());
-
-      m_DB->Finalize(Statement);
+        Print("[SQLITE3] error inserting schema number [2] - " + m_DB->GetError(), LOG_ERROR);
     }
     else
-      Print("[SQLITE3] prepare error inserting schema number [2] - " + m_DB->GetError());
+      Print("[SQLITE3] prepare error inserting schema number [2] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
     Print("[SQLITE3] found schema number [" + SchemaNumber + "]");
 
-  if (m_DB->Exec("CREATE TEMPORARY TABLE iptocountry ( ip1 INTEGER NOT NULL, ip2 INTEGER NOT NULL, country TEXT NOT NULL, PRIMARY KEY ( ip1, ip2 ) )") != SQLITE_OK)
-    Print("[SQLITE3] error creating temporary iptocountry table - " + m_DB->GetError());
-
   if (m_DB->Exec(R"(CREATE TEMPORARY TABLE rootadmins ( id INTEGER PRIMARY KEY, name TEXT NOT NULL, server TEXT NOT NULL DEFAULT "" ))") != SQLITE_OK)
-    Print("[SQLITE3] error creating temporary rootadmins table - " + m_DB->GetError());
+    Print("[SQLITE3] error creating temporary rootadmins table - " + m_DB->GetError(), LOG_ERROR);
 
   if (SchemaNumber == "1")
   {
     if (m_DB->Exec(R"(UPDATE config SET value = "2" WHERE name = "schema_number")") != SQLITE_OK)
-      Print("[SQLITE3] error updating config's schema number - " + m_DB->GetError());
+      Print("[SQLITE3] error updating config's schema number - " + m_DB->GetError(), LOG_ERROR);
 
     if (m_DB->Exec("ALTER TABLE bans ADD COLUMN ip TEXT") != SQLITE_OK)
-      Print("[SQLITE3] error altering the bans table to add ip column - " + m_DB->GetError());
+      Print("[SQLITE3] error altering the bans table to add ip column - " + m_DB->GetError(), LOG_ERROR);
+  }
+
+  // the stats are updated by name when the journal is written
+
+  if (m_DB->Exec("CREATE INDEX IF NOT EXISTS players_name ON players ( name )") != SQLITE_OK)
+    Print("[SQLITE3] error creating players name index - " + m_DB->GetError(), LOG_ERROR);
+
+  LoadBans();
+
+  // open a second connection for the writer thread, the write ahead log lets the first one keep reading while it commits
+
+  if (m_DB->Exec("PRAGMA journal_mode=WAL") != SQLITE_OK)
+    Print("[SQLITE3] error switching to WAL mode - " + m_DB->GetError(), LOG_ERROR);
+
+  m_WriteDB = new CSQLITE3(m_File);
+
+  if (m_WriteDB->GetReady())
+    m_Writer = thread(&CAuraDB::RunWriter, this);
+  else
+  {
+    Print("[SQLITE3] error opening database [" + m_File + "] for writing, writes will block - " + m_WriteDB->GetError(), LOG_ERROR);
+    delete m_WriteDB;
+    m_WriteDB = nullptr;
   }
 }
 
@@ -161,29 +247,272 @@ CAuraDB::~CAuraDB()
 {
   Print("[SQLITE3] closing database [" + m_File + "]");
 
-  if (FromAddStmt)
-    m_DB->Finalize(FromAddStmt);
-
-  if (BanCheckStmt)
-    m_DB->Finalize(BanCheckStmt);
+  // let the writer finish the journal (or write it below if there's no writer), nobody is going to call Update anymore so run the callbacks here
 
-  if (FromCheckStmt)
-    m_DB->Finalize(FromCheckStmt);
+  {
+    lock_guard<mutex> Lock(m_WritesMutex);
+    m_Exiting = true;
+  }
 
-  if (AdminCheckStmt)
-    m_DB->Finalize(AdminCheckStmt);
+  m_WritesCondition.notify_one();
 
-  if (RootAdminCheckStmt)
-    m_DB->Finalize(RootAdminCheckStmt);
+  if (m_Writer.joinable())
+    m_Writer.join();
 
+  Update();
+  delete m_WriteDB;
   delete m_DB;
+
+  for (auto& name : m_BansByName)
+  {
+    for (auto& ban : name.second)
+      delete ban;
+  }
+}
+
+CHistogram CAuraDB::GetQueryTimes()
+{
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
+  return m_DB->GetQueryTimes();
+}
+
+uint64_t CAuraDB::GetStatementPrepares() const
+{
+  return m_DB->GetPrepares() + (m_WriteDB ? m_WriteDB->GetPrepares() : 0);
+}
+
+uint64_t CAuraDB::GetStatementCacheHits() const
+{
+  return m_DB->GetCacheHits() + (m_WriteDB ? m_WriteDB->GetCacheHits() : 0);
+}
+
+void CAuraDB::Update()
+{
+  vector<function<void()>>              Callbacks;
+  unordered_map<string, CDBPlayerStats> Journal;
+  vector<function<void(bool)>>          JournalCallbacks;
+
+  {
+    lock_guard<mutex> Lock(m_WritesMutex);
+
+    // without a writer thread the journal is written here, on the main connection
+
+    if (!m_WriteDB && JournalPending() && (m_Exiting || JournalDue()))
+    {
+      Journal.swap(m_Journal);
+      JournalCallbacks.swap(m_JournalCallbacks);
+    }
+
+    Callbacks.swap(m_Callbacks);
+  }
+
+  if (!Journal.empty() || !JournalCallbacks.empty())
+  {
+    lock_guard<recursive_mutex> Lock(m_Mutex);
+    const bool                  Success = WriteJournal(m_DB, Journal);
+
+    for (auto& callback : JournalCallbacks)
+      callback(Success);
+  }
+
+  for (auto& callback : Callbacks)
+    callback();
+}
+
+void CAuraDB::QueueCallback(function<void(bool)> callback)
+{
+  {
+    lock_guard<mutex> Lock(m_WritesMutex);
+    JournalAdding();
+    m_JournalCallbacks.push_back(std::move(callback));
+  }
+
+  m_WritesCondition.notify_one();
+}
+
+bool CAuraDB::JournalPending() const
+{
+  return !m_Journal.empty() || !m_JournalCallbacks.empty();
+}
+
+bool CAuraDB::JournalDue() const
+{
+  return m_Journal.size() >= DB_JOURNAL_MAX || chrono::steady_clock::now() - m_JournalStart >= m_FlushInterval;
+}
+
+void CAuraDB::JournalAdding()
+{
+  if (!JournalPending())
+    m_JournalStart = chrono::steady_clock::now();
+}
+
+void CAuraDB::RunWriter()
+{
+  while (true)
+  {
+    unordered_map<string, CDBPlayerStats> Journal;
+    vector<function<void(bool)>>          JournalCallbacks;
+
+    {
+      unique_lock<mutex> Lock(m_WritesMutex);
+
+      while (!m_Exiting && !(JournalPending() && JournalDue()))
+      {
+        if (JournalPending())
+          m_WritesCondition.wait_until(Lock, m_JournalStart + m_FlushInterval);
+        else
+          m_WritesCondition.wait(Lock);
+      }
+
+      if (!JournalPending())
+        break;
+
+      Journal.swap(m_Journal);
+      JournalCallbacks.swap(m_JournalCallbacks);
+    }
+
+    const bool Success = WriteJournal(m_WriteDB, Journal);
+
+    if (!JournalCallbacks.empty())
+    {
+      lock_guard<mutex> Lock(m_WritesMutex);
+
+      for (auto& callback : JournalCallbacks)
+        m_Callbacks.push_back([callback, Success]() { callback(Success); });
+    }
+  }
+}
+
+bool CAuraDB::WriteJournal(CSQLITE3* db, const unordered_map<string, CDBPlayerStats>& journal)
+{
+  if (journal.empty())
+    return true;
+
+  if (db->Exec("BEGIN TRANSACTION") != SQLITE_OK)
+  {
+    Print("[SQLITE3] error beginning transaction, " + to_string(journal.size()) + " players not saved - " + db->GetError(), LOG_ERROR);
+    return false;
+  }
+
+  bool Success = true;
+
+  for (const auto& player : journal)
+  {
+    if (!WriteStats(db, player.first, player.second))
+      Success = false;
+  }
+
+  if (db->Exec("COMMIT TRANSACTION") != SQLITE_OK)
+  {
+    Print("[SQLITE3] error committing transaction, " + to_string(journal.size()) + " players not saved - " + db->GetError(), LOG_ERROR);
+    db->Exec("ROLLBACK TRANSACTION");
+    return false;
+  }
+
+  return Success;
+}
+
+bool CAuraDB::WriteStats(CSQLITE3* db, const string& name, const CDBPlayerStats& stats)
+{
+  // the columns are NULL until the player's first game (or first dota game) so they're treated as 0
+
+  if (stats.Games)
+  {
+    CSQLITE3Statement Statement(db, "UPDATE players SET games=IFNULL(games,0)+?, loadingtime=IFNULL(loadingtime,0)+?, duration=IFNULL(duration,0)+?, left=IFNULL(left,0)+? WHERE name=?");
+
+    if (!Statement)
+    {
+      Print("[SQLITE3] prepare error updating gameplayer [" + name + "] - " + db->GetError(), LOG_ERROR);
+      return false;
+    }
+
+    sqlite3_bind_int(Statement, 1, stats.Games);
+    sqlite3_bind_int64(Statement, 2, stats.LoadingTime);
+    sqlite3_bind_int64(Statement, 3, stats.Duration);
+    sqlite3_bind_int64(Statement, 4, stats.Left);
+    sqlite3_bind_text(Statement, 5, name.c_str(), -1, SQLITE_TRANSIENT);
+
+    int32_t RC = db->Step(Statement);
+
+    // insert a new entry if there wasn't one to update
+
+    if (RC == SQLITE_DONE && db->GetChanges() == 0)
+    {
+      CSQLITE3Statement InsertStatement(db, "INSERT INTO players ( name, games, loadingtime, duration, left ) VALUES ( ?, ?, ?, ?, ? )");
+
+      if (!InsertStatement)
+      {
+        Print("[SQLITE3] prepare error inserting gameplayer [" + name + "] - " + db->GetError(), LOG_ERROR);
+        return false;
+      }
+
+      sqlite3_bind_text(InsertStatement, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+      sqlite3_bind_int(InsertStatement, 2, stats.Games);
+      sqlite3_bind_int64(InsertStatement, 3, stats.LoadingTime);
+      sqlite3_bind_int64(InsertStatement, 4, stats.Duration);
+      sqlite3_bind_int64(InsertStatement, 5, stats.Left);
+
+      RC = db->Step(InsertStatement);
+    }
+
+    if (RC != SQLITE_DONE)
+    {
+      Print("[SQLITE3] error adding gameplayer [" + name + "] - " + db->GetError(), LOG_ERROR);
+      return false;
+    }
+  }
+
+  if (stats.Dotas)
+  {
+    CSQLITE3Statement Statement(db, "UPDATE players SET dotas=IFNULL(dotas,0)+?, wins=IFNULL(wins,0)+?, losses=IFNULL(losses,0)+?, kills=IFNULL(kills,0)+?, deaths=IFNULL(deaths,0)+?, creepkills=IFNULL(creepkills,0)+?, creepdenies=IFNULL(creepdenies,0)+?, assists=IFNULL(assists,0)+?, neutralkills=IFNULL(neutralkills,0)+?, towerkills=IFNULL(towerkills,0)+?, raxkills=IFNULL(raxkills,0)+?, courierkills=IFNULL(courierkills,0)+? WHERE name=?");
+
+    if (!Statement)
+    {
+      Print("[SQLITE3] prepare error updating dotaplayer [" + name + "] - " + db->GetError(), LOG_ERROR);
+      return false;
+    }
+
+    sqlite3_bind_int(Statement, 1, stats.Dotas);
+    sqlite3_bind_int(Statement, 2, stats.Wins);
+    sqlite3_bind_int(Statement, 3, stats.Losses);
+    sqlite3_bind_int(Statement, 4, stats.Kills);
+    sqlite3_bind_int(Statement, 5, stats.Deaths);
+    sqlite3_bind_int(Statement, 6, stats.CreepKills);
+    sqlite3_bind_int(Statement, 7, stats.CreepDenies);
+    sqlite3_bind_int(Statement, 8, stats.Assists);
+    sqlite3_bind_int(Statement, 9, stats.NeutralKills);
+    sqlite3_bind_int(Statement, 10, stats.TowerKills);
+    sqlite3_bind_int(Statement, 11, stats.RaxKills);
+    sqlite3_bind_int(Statement, 12, stats.CourierKills);
+    sqlite3_bind_text(Statement, 13, name.c_str(), -1, SQLITE_TRANSIENT);
+
+    const int32_t RC = db->Step(Statement);
+
+    if (RC != SQLITE_DONE)
+    {
+      Print("[SQLITE3] error adding dotaplayer [" + name + "] - " + db->GetError(), LOG_ERROR);
+      return false;
+    }
+
+    // there must be a row already because GamePlayerAdd adds one, if not present, before the call to DotAPlayerAdd
+
+    if (db->GetChanges() == 0)
+    {
+      Print("[SQLITE3] error adding dotaplayer [" + name + "] - no existing row", LOG_ERROR);
+      return false;
+    }
+  }
+
+  return true;
 }
 
 uint32_t CAuraDB::AdminCount(const string& server)
 {
-  uint32_t      Count = 0;
-  sqlite3_stmt* Statement;
-  m_DB->Prepare("SELECT COUNT(*) FROM admins WHERE server=?", reinterpret_cast<void**>(&Statement));
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
+  uint32_t Count = 0;
+  CSQLITE3Statement Statement(m_DB, "SELECT COUNT(*) FROM admins WHERE server=?");
 
   if (Statement)
   {
@@ -194,53 +523,51 @@ uint32_t CAuraDB::AdminCount(const string& server)
     if (RC == SQLITE_ROW)
       Count = sqlite3_column_int(Statement, 0);
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error counting admins [" + server + "] - " + m_DB->GetError());
-
-    m_DB->Finalize(Statement);
+      Print("[SQLITE3] error counting admins [" + server + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error counting admins [" + server + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error counting admins [" + server + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return Count;
 }
 
 bool CAuraDB::AdminCheck(const string& server, string user)
 {
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
   bool IsAdmin = false;
   transform(begin(user), end(user), begin(user), ::tolower);
 
-  if (!AdminCheckStmt)
-    m_DB->Prepare("SELECT * FROM admins WHERE server=? AND name=?", &AdminCheckStmt);
+  CSQLITE3Statement Statement(m_DB, "SELECT * FROM admins WHERE server=? AND name=?");
 
-  if (AdminCheckStmt)
+  if (Statement)
   {
-    sqlite3_bind_text(static_cast<sqlite3_stmt*>(AdminCheckStmt), 1, server.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(static_cast<sqlite3_stmt*>(AdminCheckStmt), 2, user.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(Statement, 1, server.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(Statement, 2, user.c_str(), -1, SQLITE_TRANSIENT);
 
-    const int32_t RC = m_DB->Step(AdminCheckStmt);
+    const int32_t RC = m_DB->Step(Statement);
 
     // we're just checking to see if the query returned a row, we don't need to check the row data itself
 
     if (RC == SQLITE_ROW)
       IsAdmin = true;
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error checking admin [" + server + " : " + user + "] - " + m_DB->GetError());
-
-    m_DB->Reset(AdminCheckStmt);
+      Print("[SQLITE3] error checking admin [" + server + " : " + user + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error checking admin [" + server + " : " + user + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error checking admin [" + server + " : " + user + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return IsAdmin;
 }
 
 bool CAuraDB::AdminCheck(string user)
 {
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
   bool IsAdmin = false;
   transform(begin(user), end(user), begin(user), ::tolower);
 
-  sqlite3_stmt* Statement;
-  m_DB->Prepare("SELECT * FROM admins WHERE name=?", reinterpret_cast<void**>(&Statement));
+  CSQLITE3Statement Statement(m_DB, "SELECT * FROM admins WHERE name=?");
 
   if (Statement)
   {
@@ -253,53 +580,51 @@ bool CAuraDB::AdminCheck(string user)
     if (RC == SQLITE_ROW)
       IsAdmin = true;
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error checking admin [" + user + "] - " + m_DB->GetError());
-
-    m_DB->Reset(Statement);
+      Print("[SQLITE3] error checking admin [" + user + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error checking admin [" + user + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error checking admin [" + user + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return IsAdmin;
 }
 
 bool CAuraDB::RootAdminCheck(const string& server, string user)
 {
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
   bool IsRoot = false;
   transform(begin(user), end(user), begin(user), ::tolower);
 
-  if (!RootAdminCheckStmt)
-    m_DB->Prepare("SELECT * FROM rootadmins WHERE server=? AND name=?", &RootAdminCheckStmt);
+  CSQLITE3Statement Statement(m_DB, "SELECT * FROM rootadmins WHERE server=? AND name=?");
 
-  if (RootAdminCheckStmt)
+  if (Statement)
   {
-    sqlite3_bind_text(static_cast<sqlite3_stmt*>(RootAdminCheckStmt), 1, server.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(static_cast<sqlite3_stmt*>(RootAdminCheckStmt), 2, user.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(Statement, 1, server.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(Statement, 2, user.c_str(), -1, SQLITE_TRANSIENT);
 
-    const int32_t RC = m_DB->Step(static_cast<sqlite3_stmt*>(RootAdminCheckStmt));
+    const int32_t RC = m_DB->Step(Statement);
 
     // we're just checking to see if the query returned a row, we don't need to check the row data itself
 
     if (RC == SQLITE_ROW)
       IsRoot = true;
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error checking admin [" + user + "] - " + m_DB->GetError());
-
-    m_DB->Reset(static_cast<sqlite3_stmt*>(RootAdminCheckStmt));
+      Print("[SQLITE3] error checking admin [" + user + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error checking admin [" + user + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error checking admin [" + user + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return IsRoot;
 }
 
 bool CAuraDB::RootAdminCheck(string user)
 {
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
   bool IsRoot = false;
   transform(begin(user), end(user), begin(user), ::tolower);
 
-  sqlite3_stmt* Statement;
-  m_DB->Prepare("SELECT * FROM rootadmins WHERE name=?", reinterpret_cast<void**>(&Statement));
+  CSQLITE3Statement Statement(m_DB, "SELECT * FROM rootadmins WHERE name=?");
 
   if (Statement)
   {
@@ -312,23 +637,22 @@ bool CAuraDB::RootAdminCheck(string user)
     if (RC == SQLITE_ROW)
       IsRoot = true;
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error checking admin [" + user + "] - " + m_DB->GetError());
-
-    m_DB->Finalize(Statement);
+      Print("[SQLITE3] error checking admin [" + user + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error checking admin [" + user + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error checking admin [" + user + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return IsRoot;
 }
 
 bool CAuraDB::AdminAdd(const string& server, string user)
 {
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
   bool Success = false;
   transform(begin(user), end(user), begin(user), ::tolower);
 
-  sqlite3_stmt* Statement;
-  m_DB->Prepare("INSERT INTO admins ( server, name ) VALUES ( ?, ? )", reinterpret_cast<void**>(&Statement));
+  CSQLITE3Statement Statement(m_DB, "INSERT INTO admins ( server, name ) VALUES ( ?, ? )");
 
   if (Statement)
   {
@@ -340,23 +664,22 @@ bool CAuraDB::AdminAdd(const string& server, string user)
     if (RC == SQLITE_DONE)
       Success = true;
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error adding admin [" + server + " : " + user + "] - " + m_DB->GetError());
-
-    m_DB->Finalize(Statement);
+      Print("[SQLITE3] error adding admin [" + server + " : " + user + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error adding admin [" + server + " : " + user + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error adding admin [" + server + " : " + user + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return Success;
 }
 
 bool CAuraDB::RootAdminAdd(const string& server, string user)
 {
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
   bool Success = false;
   transform(begin(user), end(user), begin(user), ::tolower);
 
-  sqlite3_stmt* Statement;
-  m_DB->Prepare("INSERT INTO rootadmins ( server, name ) VALUES ( ?, ? )", reinterpret_cast<void**>(&Statement));
+  CSQLITE3Statement Statement(m_DB, "INSERT INTO rootadmins ( server, name ) VALUES ( ?, ? )");
 
   if (Statement)
   {
@@ -368,22 +691,21 @@ bool CAuraDB::RootAdminAdd(const string& server, string user)
     if (RC == SQLITE_DONE)
       Success = true;
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error adding root admin [" + server + " : " + user + "] - " + m_DB->GetError());
-
-    m_DB->Finalize(Statement);
+      Print("[SQLITE3] error adding root admin [" + server + " : " + user + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error adding root admin [" + server + " : " + user + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error adding root admin [" + server + " : " + user + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return Success;
 }
 
 bool CAuraDB::AdminRemove(const string& server, string user)
 {
-  bool          Success = false;
-  sqlite3_stmt* Statement;
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
+  bool Success = false;
   transform(begin(user), end(user), begin(user), ::tolower);
-  m_DB->Prepare("DELETE FROM admins WHERE server=? AND name=?", reinterpret_cast<void**>(&Statement));
+  CSQLITE3Statement Statement(m_DB, "DELETE FROM admins WHERE server=? AND name=?");
 
   if (Statement)
   {
@@ -395,21 +717,20 @@ bool CAuraDB::AdminRemove(const string& server, string user)
     if (RC == SQLITE_DONE)
       Success = true;
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error removing admin [" + server + " : " + user + "] - " + m_DB->GetError());
-
-    m_DB->Finalize(Statement);
+      Print("[SQLITE3] error removing admin [" + server + " : " + user + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error removing admin [" + server + " : " + user + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error removing admin [" + server + " : " + user + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return Success;
 }
 
 uint32_t CAuraDB::BanCount(const string& server)
 {
-  uint32_t      Count = 0;
-  sqlite3_stmt* Statement;
-  m_DB->Prepare("SELECT COUNT(*) FROM bans WHERE server=?", reinterpret_cast<void**>(&Statement));
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
+  uint32_t Count = 0;
+  CSQLITE3Statement Statement(m_DB, "SELECT COUNT(*) FROM bans WHERE server=?");
 
   if (Statement)
   {
@@ -420,84 +741,135 @@ uint32_t CAuraDB::BanCount(const string& server)
     if (RC == SQLITE_ROW)
       Count = sqlite3_column_int(Statement, 0);
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error counting bans [" + server + "] - " + m_DB->GetError());
-
-    m_DB->Finalize(Statement);
+      Print("[SQLITE3] error counting bans [" + server + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error counting bans [" + server + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error counting bans [" + server + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return Count;
 }
 
-CDBBan* CAuraDB::BanCheck(const string& server, string user, string ip)
+void CAuraDB::LoadBans()
 {
-  CDBBan* Ban = nullptr;
-  transform(begin(user), end(user), begin(user), ::tolower);
+  CSQLITE3Statement Statement(m_DB, "SELECT server, name, date, admin, reason, ip FROM bans ORDER BY id");
 
-  if (!BanCheckStmt)
-    m_DB->Prepare("SELECT name, date, admin, reason, ip FROM bans WHERE server=? AND (name=? OR ip=?)", &BanCheckStmt);
-
-  if (BanCheckStmt)
+  if (Statement)
   {
-    Print("[SQLITE3] creating ban check statement");
-    sqlite3_bind_text(static_cast<sqlite3_stmt*>(BanCheckStmt), 1, server.c_str(), -1, SQLITE_TRANSIENT);
+    uint32_t Count = 0;
+    int32_t  RC;
 
-    if (user.empty())
-      sqlite3_bind_null(static_cast<sqlite3_stmt*>(BanCheckStmt), 2);
-    else
-      sqlite3_bind_text(static_cast<sqlite3_stmt*>(BanCheckStmt), 2, user.c_str(), -1, SQLITE_TRANSIENT);
+    while ((RC = m_DB->Step(Statement)) == SQLITE_ROW)
+    {
+      const auto Column = [&Statement](int32_t i) { return sqlite3_column_type(Statement, i) == SQLITE_NULL ? string() : string(reinterpret_cast<const char*>(sqlite3_column_text(Statement, i))); };
 
-    if (ip.empty())
-      sqlite3_bind_null(static_cast<sqlite3_stmt*>(BanCheckStmt), 3);
+      // the names are stored in lowercase by BanAdd but older versions might not have, BanRemove matches them with lower(name) too
+
+      string Name = Column(1);
+      transform(begin(Name), end(Name), begin(Name), ::tolower);
+      IndexBan(new CDBBan(Column(0), Name, Column(2), Column(3), Column(4), Column(5)));
+      ++Count;
+    }
+
+    if (RC == SQLITE_ERROR)
+      Print("[SQLITE3] error loading bans - " + m_DB->GetError(), LOG_ERROR);
     else
-      sqlite3_bind_text(static_cast<sqlite3_stmt*>(BanCheckStmt), 3, ip.c_str(), -1, SQLITE_TRANSIENT);
+      Print("[SQLITE3] loaded " + to_string(Count) + " bans");
+  }
+  else
+    Print("[SQLITE3] prepare error loading bans - " + m_DB->GetError(), LOG_ERROR);
+}
 
-    const int32_t RC = m_DB->Step(BanCheckStmt);
-    Print("[SQLITE3] ban check statement finished:\n" + string((char*)sqlite3_expanded_sql(static_cast<sqlite3_stmt*>(BanCheckStmt))));
+void CAuraDB::IndexBan(CDBBan* ban)
+{
+  m_BansByName[ban->GetName()].push_back(ban);
 
-    if (RC == SQLITE_ROW)
+  if (!ban->GetIp().empty())
+    m_BansByIp[ban->GetIp()].push_back(ban);
+}
+
+void CAuraDB::UnindexBans(const string* server, const string& user)
+{
+  auto Name = m_BansByName.find(user);
+
+  if (Name == end(m_BansByName))
+    return;
+
+  vector<CDBBan*>& Bans = Name->second;
+
+  for (auto i = begin(Bans); i != end(Bans);)
+  {
+    CDBBan* Ban = *i;
+
+    if (server && Ban->GetServer() != *server)
     {
-      if (sqlite3_column_count(static_cast<sqlite3_stmt*>(BanCheckStmt)) == 5)
+      ++i;
+      continue;
+    }
+
+    if (!Ban->GetIp().empty())
+    {
+      auto Ip = m_BansByIp.find(Ban->GetIp());
+
+      if (Ip != end(m_BansByIp))
       {
-        string Name   = string((char*)sqlite3_column_text(static_cast<sqlite3_stmt*>(BanCheckStmt), 0));
-        Print("[SQLITE3] Name: " + Name);
-        string Date   = string((char*)sqlite3_column_text(static_cast<sqlite3_stmt*>(BanCheckStmt), 1));
-        Print("[SQLITE3] Date: " + Date);
-        string Admin  = string((char*)sqlite3_column_text(static_cast<sqlite3_stmt*>(BanCheckStmt), 2));
-        Print("[SQLITE3] Admin: " + Admin);
-        string Reason = string((char*)sqlite3_column_text(static_cast<sqlite3_stmt*>(BanCheckStmt), 3));
-        Print("[SQLITE3] Reason: " + Reason);
-
-        string Ip = string();
-        if (sqlite3_column_type(static_cast<sqlite3_stmt*>(BanCheckStmt), 4) != SQLITE_NULL)
-          string Ip = string((char*)sqlite3_column_text(static_cast<sqlite3_stmt*>(BanCheckStmt), 4));
-        
-        Print("[SQLITE3] IP: " + Ip);
-
-        Ban = new CDBBan(server, Name, Date, Admin, Reason, Ip);
+        Ip->second.erase(remove(begin(Ip->second), end(Ip->second), Ban), end(Ip->second));
+
+        if (Ip->second.empty())
+          m_BansByIp.erase(Ip);
       }
-      else
-        Print("[SQLITE3] error checking ban [" + server + " : " + user + "] - row doesn't have 5 columns");
     }
-    else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error checking ban [" + server + " : " + user + "] - " + m_DB->GetError());
 
-    m_DB->Reset(BanCheckStmt);
+    delete Ban;
+    i = Bans.erase(i);
   }
-  else
-    Print("[SQLITE3] prepare error checking ban [" + server + " : " + user + "] - " + m_DB->GetError());
 
-  return Ban;
+  if (Bans.empty())
+    m_BansByName.erase(Name);
+}
+
+static CDBBan* FindBan(const unordered_map<string, vector<CDBBan*>>& index, const string& key, const string& server)
+{
+  if (key.empty())
+    return nullptr;
+
+  auto Bans = index.find(key);
+
+  if (Bans == end(index))
+    return nullptr;
+
+  for (const auto& ban : Bans->second)
+  {
+    if (ban->GetServer() == server)
+      return ban;
+  }
+
+  return nullptr;
+}
+
+CDBBan* CAuraDB::BanCheck(const string& server, string user, const string& ip)
+{
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
+  transform(begin(user), end(user), begin(user), ::tolower);
+
+  // a ban on the name takes precedence over a ban on the ip, the caller owns the returned copy
+
+  CDBBan* Ban = FindBan(m_BansByName, user, server);
+
+  if (!Ban)
+    Ban = FindBan(m_BansByIp, ip, server);
+
+  return Ban ? new CDBBan(*Ban) : nullptr;
 }
 
 bool CAuraDB::BanAdd(const string& server, string user, const string& admin, const string& reason, string ip)
 {
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
   Print("[SQLITE3] starting the ban now");
-  bool          Success = false;
-  sqlite3_stmt* Statement;
+  bool Success = false;
   transform(begin(user), end(user), begin(user), ::tolower);
-  m_DB->Prepare("INSERT INTO bans ( server, name, date, admin, reason, ip ) VALUES ( ?, ?, date('now'), ?, ?, ? )", reinterpret_cast<void**>(&Statement));
+  CSQLITE3Statement Statement(m_DB, "INSERT INTO bans ( server, name, date, admin, reason, ip ) VALUES ( ?, ?, date('now'), ?, ?, ? )");
 
   if (Statement)
   {
@@ -515,24 +887,37 @@ bool CAuraDB::BanAdd(const string& server, string user, const string& admin, con
     Print("[SQLITE3] finished creating statements");
 
     if (RC == SQLITE_DONE)
+    {
+      // read the date back so the index has exactly what was stored
+
+      string Date = "unknown";
+      CSQLITE3Statement DateStatement(m_DB, "SELECT date FROM bans WHERE id=last_insert_rowid()");
+
+      if (DateStatement)
+      {
+        if (m_DB->Step(DateStatement) == SQLITE_ROW)
+          Date = string(reinterpret_cast<const char*>(sqlite3_column_text(DateStatement, 0)));
+      }
+
+      IndexBan(new CDBBan(server, user, Date, admin, reason, ip));
       Success = true;
+    }
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error adding ban [" + server + " : " + user + " : " + admin + " : " + reason + " : " + ip + "] - " + m_DB->GetError());
-
-    m_DB->Finalize(Statement);
+      Print("[SQLITE3] error adding ban [" + server + " : " + user + " : " + admin + " : " + reason + " : " + ip + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error adding ban [" + server + " : " + user + " : " + admin + " : " + reason + " : " + ip + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error adding ban [" + server + " : " + user + " : " + admin + " : " + reason + " : " + ip + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return Success;
 }
 
 bool CAuraDB::BanRemove(const string& server, string user)
 {
-  bool          Success = false;
-  sqlite3_stmt* Statement;
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
+  bool Success = false;
   transform(begin(user), end(user), begin(user), ::tolower);
-  m_DB->Prepare("DELETE FROM bans WHERE server=? AND name=?", reinterpret_cast<void**>(&Statement));
+  CSQLITE3Statement Statement(m_DB, "DELETE FROM bans WHERE server=? AND lower(name)=?");
 
   if (Statement)
   {
@@ -542,24 +927,26 @@ bool CAuraDB::BanRemove(const string& server, string user)
     const int32_t RC = m_DB->Step(Statement);
 
     if (RC == SQLITE_DONE)
+    {
+      UnindexBans(&server, user);
       Success = true;
+    }
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error removing ban [" + server + " : " + user + "] - " + m_DB->GetError());
-
-    m_DB->Finalize(Statement);
+      Print("[SQLITE3] error removing ban [" + server + " : " + user + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error removing ban [" + server + " : " + user + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error removing ban [" + server + " : " + user + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return Success;
 }
 
 bool CAuraDB::BanRemove(string user)
 {
-  bool          Success = false;
-  sqlite3_stmt* Statement;
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
+  bool Success = false;
   transform(begin(user), end(user), begin(user), ::tolower);
-  m_DB->Prepare("DELETE FROM bans WHERE name=?", reinterpret_cast<void**>(&Statement));
+  CSQLITE3Statement Statement(m_DB, "DELETE FROM bans WHERE lower(name)=?");
 
   if (Statement)
   {
@@ -568,103 +955,45 @@ bool CAuraDB::BanRemove(string user)
     const int32_t RC = m_DB->Step(Statement);
 
     if (RC == SQLITE_DONE)
+    {
+      UnindexBans(nullptr, user);
       Success = true;
+    }
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error removing ban [" + user + "] - " + m_DB->GetError());
-
-    m_DB->Finalize(Statement);
+      Print("[SQLITE3] error removing ban [" + user + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error removing ban [" + user + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error removing ban [" + user + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return Success;
 }
 
-void CAuraDB::GamePlayerAdd(string name, uint64_t loadingtime, uint64_t duration, uint64_t left)
+void CAuraDB::GamePlayerAdd(const string& name, uint64_t loadingtime, uint64_t duration, uint64_t left)
 {
-  sqlite3_stmt* Statement;
-  transform(begin(name), end(name), begin(name), ::tolower);
-
-  // check if entry exists
-
-  int32_t  RC;
-  uint32_t Games = 0;
-
-  m_DB->Prepare("SELECT games, loadingtime, duration, left FROM players WHERE name=?", reinterpret_cast<void**>(&Statement));
-
-  if (Statement)
-  {
-    sqlite3_bind_text(Statement, 1, name.c_str(), -1, SQLITE_TRANSIENT);
-
-    RC = m_DB->Step(Statement);
-
-    if (RC == SQLITE_ROW)
-    {
-      Games += 1 + sqlite3_column_int(Statement, 0);
-      loadingtime += sqlite3_column_int64(Statement, 1);
-      duration += sqlite3_column_int64(Statement, 2);
-      left += sqlite3_column_int64(Statement, 3);
-    }
-
-    m_DB->Finalize(Statement);
-  }
-  else
-  {
-    Print("[SQLITE3] prepare error adding gameplayer [" + name + "] - " + m_DB->GetError());
-    return;
-  }
-
-  if (Games == 0)
-  {
-    // insert new entry
-
-    m_DB->Prepare("INSERT INTO players ( name, games, loadingtime, duration, left ) VALUES ( ?, ?, ?, ?, ? )", reinterpret_cast<void**>(&Statement));
-
-    if (Statement == nullptr)
-    {
-      Print("[SQLITE3] prepare error inserting gameplayer [" + name + "] - " + m_DB->GetError());
-      return;
-    }
+  string Name = name;
+  transform(begin(Name), end(Name), begin(Name), ::tolower);
 
-    sqlite3_bind_text(Statement, 1, name.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(Statement, 2, 1);
-    sqlite3_bind_int64(Statement, 3, loadingtime);
-    sqlite3_bind_int64(Statement, 4, duration);
-    sqlite3_bind_int64(Statement, 5, left);
-  }
-  else
   {
-    // update existing entry
-
-    m_DB->Prepare("UPDATE players SET games=?, loadingtime=?, duration=?, left=? WHERE name=?", reinterpret_cast<void**>(&Statement));
-
-    if (Statement == nullptr)
-    {
-      Print("[SQLITE3] prepare error updating gameplayer [" + name + "] - " + m_DB->GetError());
-      return;
-    }
-
-    sqlite3_bind_int(Statement, 1, Games);
-    sqlite3_bind_int64(Statement, 2, loadingtime);
-    sqlite3_bind_int64(Statement, 3, duration);
-    sqlite3_bind_int64(Statement, 4, left);
-    sqlite3_bind_text(Statement, 5, name.c_str(), -1, SQLITE_TRANSIENT);
+    lock_guard<mutex> Lock(m_WritesMutex);
+    JournalAdding();
+
+    CDBPlayerStats& Stats = m_Journal[Name];
+    ++Stats.Games;
+    Stats.LoadingTime += loadingtime;
+    Stats.Duration += duration;
+    Stats.Left += left;
   }
 
-  RC = m_DB->Step(Statement);
-
-  if (RC != SQLITE_DONE)
-    Print("[SQLITE3] error adding gameplayer [" + name + "] - " + m_DB->GetError());
-
-  m_DB->Finalize(Statement);
+  m_WritesCondition.notify_one();
 }
 
 CDBGamePlayerSummary* CAuraDB::GamePlayerSummaryCheck(string name)
 {
-  sqlite3_stmt*         Statement;
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
   CDBGamePlayerSummary* GamePlayerSummary = nullptr;
   transform(begin(name), end(name), begin(name), ::tolower);
-  m_DB->Prepare("SELECT games, loadingtime, duration, left FROM players WHERE name=?", reinterpret_cast<void**>(&Statement));
+  CSQLITE3Statement Statement(m_DB, "SELECT games, loadingtime, duration, left FROM players WHERE name=?");
 
   if (Statement)
   {
@@ -684,112 +1013,55 @@ CDBGamePlayerSummary* CAuraDB::GamePlayerSummaryCheck(string name)
         GamePlayerSummary = new CDBGamePlayerSummary(TotalGames, static_cast<double>(LoadingTime) / TotalGames / 1000, static_cast<double>(Duration) / Left * 100);
       }
       else
-        Print("[SQLITE3] error checking gameplayersummary [" + name + "] - row doesn't have 4 columns");
+        Print("[SQLITE3] error checking gameplayersummary [" + name + "] - row doesn't have 4 columns", LOG_ERROR);
     }
     else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error checking gameplayersummary [" + name + "] - " + m_DB->GetError());
-
-    m_DB->Finalize(Statement);
+      Print("[SQLITE3] error checking gameplayersummary [" + name + "] - " + m_DB->GetError(), LOG_ERROR);
   }
   else
-    Print("[SQLITE3] prepare error checking gameplayersummary [" + name + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error checking gameplayersummary [" + name + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return GamePlayerSummary;
 }
 
-void CAuraDB::DotAPlayerAdd(string name, uint32_t winner, uint32_t kills, uint32_t deaths, uint32_t creepkills, uint32_t creepdenies, uint32_t assists, uint32_t neutralkills, uint32_t towerkills, uint32_t raxkills, uint32_t courierkills)
+void CAuraDB::DotAPlayerAdd(const string& name, uint32_t winner, uint32_t kills, uint32_t deaths, uint32_t creepkills, uint32_t creepdenies, uint32_t assists, uint32_t neutralkills, uint32_t towerkills, uint32_t raxkills, uint32_t courierkills)
 {
-  bool          Success = false;
-  sqlite3_stmt* Statement;
-  transform(begin(name), end(name), begin(name), ::tolower);
-  m_DB->Prepare("SELECT dotas, wins, losses, kills, deaths, creepkills, creepdenies, assists, neutralkills, towerkills, raxkills, courierkills FROM players WHERE name=?", reinterpret_cast<void**>(&Statement));
-
-  int32_t  RC;
-  uint32_t Dotas  = 1;
-  uint32_t Wins   = 0;
-  uint32_t Losses = 0;
-
-  if (winner == 1)
-    ++Wins;
-  else if (winner == 2)
-    ++Losses;
-
-  if (Statement)
-  {
-    sqlite3_bind_text(Statement, 1, name.c_str(), -1, SQLITE_TRANSIENT);
-
-    RC = m_DB->Step(Statement);
-
-    if (RC == SQLITE_ROW)
-    {
-      Dotas += sqlite3_column_int(Statement, 0);
-      Wins += sqlite3_column_int(Statement, 1);
-      Losses += sqlite3_column_int(Statement, 2);
-      kills += sqlite3_column_int(Statement, 3);
-      deaths += sqlite3_column_int(Statement, 4);
-      creepkills += sqlite3_column_int(Statement, 5);
-      creepdenies += sqlite3_column_int(Statement, 6);
-      assists += sqlite3_column_int(Statement, 7);
-      neutralkills += sqlite3_column_int(Statement, 8);
-      towerkills += sqlite3_column_int(Statement, 9);
-      raxkills += sqlite3_column_int(Statement, 10);
-      courierkills += sqlite3_column_int(Statement, 11);
-
-      Success = true;
-    }
-
-    m_DB->Finalize(Statement);
-  }
-  else
-  {
-    Print("[SQLITE3] prepare error adding dotaplayer [" + name + "] - " + m_DB->GetError());
-    return;
-  }
-
-  // there must be a row already because we add one, if not present, in GamePlayerAdd( ) before the call to DotAPlayerAdd( )
-
-  if (Success == false)
-  {
-    Print("[SQLITE3] error adding dotaplayer [" + name + "] - no existing row");
-    return;
-  }
-
-  m_DB->Prepare("UPDATE players SET dotas=?, wins=?, losses=?, kills=?, deaths=?, creepkills=?, creepdenies=?, assists=?, neutralkills=?, towerkills=?, raxkills=?, courierkills=? WHERE name=?", reinterpret_cast<void**>(&Statement));
+  string Name = name;
+  transform(begin(Name), end(Name), begin(Name), ::tolower);
 
-  if (Statement == nullptr)
   {
-    Print("[SQLITE3] prepare error updating dotalayer [" + name + "] - " + m_DB->GetError());
-    return;
+    lock_guard<mutex> Lock(m_WritesMutex);
+    JournalAdding();
+
+    CDBPlayerStats& Stats = m_Journal[Name];
+    ++Stats.Dotas;
+
+    if (winner == 1)
+      ++Stats.Wins;
+    else if (winner == 2)
+      ++Stats.Losses;
+
+    Stats.Kills += kills;
+    Stats.Deaths += deaths;
+    Stats.CreepKills += creepkills;
+    Stats.CreepDenies += creepdenies;
+    Stats.Assists += assists;
+    Stats.NeutralKills += neutralkills;
+    Stats.TowerKills += towerkills;
+    Stats.RaxKills += raxkills;
+    Stats.CourierKills += courierkills;
   }
 
-  sqlite3_bind_int(Statement, 1, Dotas);
-  sqlite3_bind_int(Statement, 2, Wins);
-  sqlite3_bind_int(Statement, 3, Losses);
-  sqlite3_bind_int(Statement, 4, kills);
-  sqlite3_bind_int(Statement, 5, deaths);
-  sqlite3_bind_int(Statement, 6, creepkills);
-  sqlite3_bind_int(Statement, 7, creepdenies);
-  sqlite3_bind_int(Statement, 8, assists);
-  sqlite3_bind_int(Statement, 9, neutralkills);
-  sqlite3_bind_int(Statement, 10, towerkills);
-  sqlite3_bind_int(Statement, 11, raxkills);
-  sqlite3_bind_int(Statement, 12, courierkills);
-  sqlite3_bind_text(Statement, 13, name.c_str(), -1, SQLITE_TRANSIENT);
-
-  RC = m_DB->Step(Statement);
-
-  if (RC != SQLITE_DONE)
-    Print("[SQLITE3] error adding dotaplayer [" + name + "] - " + m_DB->GetError());
-
-  m_DB->Finalize(Statement);
+  m_WritesCondition.notify_one();
 }
 
 CDBDotAPlayerSummary* CAuraDB::DotAPlayerSummaryCheck(string name)
 {
-  sqlite3_stmt*         Statement;
+  lock_guard<recursive_mutex> Lock(m_Mutex);
+
   CDBDotAPlayerSummary* DotAPlayerSummary = nullptr;
   transform(begin(name), end(name), begin(name), ::tolower);
-  m_DB->Prepare("SELECT dotas, wins, losses, kills, deaths, creepkills, creepdenies, assists, neutralkills, towerkills, raxkills, courierkills FROM players WHERE name=?", reinterpret_cast<void**>(&Statement));
+  CSQLITE3Statement Statement(m_DB, "SELECT dotas, wins, losses, kills, deaths, creepkills, creepdenies, assists, neutralkills, towerkills, raxkills, courierkills FROM players WHERE name=?");
 
   if (Statement)
   {
@@ -821,85 +1093,15 @@ CDBDotAPlayerSummary* CAuraDB::DotAPlayerSummaryCheck(string name)
         }
       }
       else
-        Print("[SQLITE3] error checking dotaplayersummary [" + name + "] - row doesn't have 12 columns");
+        Print("[SQLITE3] error checking dotaplayersummary [" + name + "] - row doesn't have 12 columns", LOG_ERROR);
     }
-
-    m_DB->Finalize(Statement);
   }
   else
-    Print("[SQLITE3] prepare error checking dotaplayersummary [" + name + "] - " + m_DB->GetError());
+    Print("[SQLITE3] prepare error checking dotaplayersummary [" + name + "] - " + m_DB->GetError(), LOG_ERROR);
 
   return DotAPlayerSummary;
 }
 
-string CAuraDB::FromCheck(uint32_t ip)
-{
-  // a big thank you to tjado for help with the iptocountry feature
-
-  string From = "??";
-
-  if (!FromCheckStmt)
-    m_DB->Prepare("SELECT country FROM iptocountry WHERE ip1<=? AND ip2>=?", &FromCheckStmt);
-
-  if (FromCheckStmt)
-  {
-    // we bind the ip as an int32_t64 because SQLite treats it as signed
-
-    sqlite3_bind_int64(static_cast<sqlite3_stmt*>(FromCheckStmt), 1, ip);
-    sqlite3_bind_int64(static_cast<sqlite3_stmt*>(FromCheckStmt), 2, ip);
-
-    const int32_t RC = m_DB->Step(FromCheckStmt);
-
-    if (RC == SQLITE_ROW)
-    {
-      if (sqlite3_column_count(static_cast<sqlite3_stmt*>(FromCheckStmt)) == 1)
-        From = string((char*)sqlite3_column_text(static_cast<sqlite3_stmt*>(FromCheckStmt), 0));
-      else
-        Print("[SQLITE3] error checking iptocountry [" + to_string(ip) + "] - row doesn't have 1 column");
-    }
-    else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error checking iptocountry [" + to_string(ip) + "] - " + m_DB->GetError());
-
-    m_DB->Reset(FromCheckStmt);
-  }
-  else
-    Print("[SQLITE3] prepare error checking iptocountry [" + to_string(ip) + "] - " + m_DB->GetError());
-
-  return From;
-}
-
-bool CAuraDB::FromAdd(uint32_t ip1, uint32_t ip2, const string& country)
-{
-  // a big thank you to tjado for help with the iptocountry feature
-
-  bool Success = false;
-
-  if (!FromAddStmt)
-    m_DB->Prepare("INSERT INTO iptocountry VALUES ( ?, ?, ? )", &FromAddStmt);
-
-  if (FromAddStmt)
-  {
-    // we bind the ip as an int32_t64 because SQLite treats it as signed
-
-    sqlite3_bind_int64(static_cast<sqlite3_stmt*>(FromAddStmt), 1, ip1);
-    sqlite3_bind_int64(static_cast<sqlite3_stmt*>(FromAddStmt), 2, ip2);
-    sqlite3_bind_text(static_cast<sqlite3_stmt*>(FromAddStmt), 3, country.c_str(), -1, SQLITE_TRANSIENT);
-
-    int32_t RC = m_DB->Step(FromAddStmt);
-
-    if (RC == SQLITE_DONE)
-      Success = true;
-    else if (RC == SQLITE_ERROR)
-      Print("[SQLITE3] error adding iptocountry [" + to_string(ip1) + " : " + to_string(ip2) + " : " + country + "] - " + m_DB->GetError());
-
-    m_DB->Reset(FromAddStmt);
-  }
-  else
-    Print("[SQLITE3] prepare error adding iptocountry [" + to_string(ip1) + " : " + to_string(ip2) + " : " + country + "] - " + m_DB->GetError());
-
-  return Success;
-}
-
 //
 // CDBBan
 //
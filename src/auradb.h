@@ -69,13 +69,6 @@ CREATE TABLE config (
     value TEXT NOT NULL
 )
 
-CREATE TEMPORARY TABLE iptocountry (
-    ip1 INTEGER NOT NULL,
-    ip2 INTEGER NOT NULL,
-    country TEXT NOT NULL,
-    PRIMARY KEY ( ip1, ip2 )
-)
-
 CREATE TEMPORARY TABLE rootadmins (
     id INTEGER PRIMARY KEY,
     name TEXT NOT NULL,
@@ -91,29 +84,84 @@ CREATE TEMPORARY TABLE rootadmins (
 //
 
 #include "includes.h"
+#include "histogram.h"
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 struct sqlite3;
 struct sqlite3_stmt;
 
+// every statement is prepared the first time its sql is used and kept for the lifetime of the connection (see CSQLITE3Statement)
+
 class CSQLITE3
 {
 private:
-  void* m_DB;
-  bool  m_Ready;
+  friend class CSQLITE3Statement;
+
+  void*                                                   m_DB;
+  CHistogram                                              m_QueryTimes; // microseconds spent in each step/exec
+  std::unordered_map<std::string, std::pair<void*, bool>> m_Statements; // the prepared statements by their sql, and whether they're in use
+  std::atomic<uint64_t>                                   m_Prepares;   // statements prepared
+  std::atomic<uint64_t>                                   m_CacheHits;  // statements found already prepared
+  bool                                                    m_Ready;
+
+  void* Acquire(const std::string& query, std::pair<void*, bool>** entry);
+  void  Release(void* statement, std::pair<void*, bool>* entry);
 
 public:
   explicit CSQLITE3(const std::string& filename);
   ~CSQLITE3();
   CSQLITE3(CSQLITE3&) = delete;
 
-  inline bool        GetReady() const { return m_Ready; }
-  inline std::string GetError() const { return sqlite3_errmsg(static_cast<sqlite3*>(m_DB)); }
+  inline bool              GetReady() const { return m_Ready; }
+  inline std::string       GetError() const { return sqlite3_errmsg(static_cast<sqlite3*>(m_DB)); }
+  inline int32_t           GetChanges() const { return sqlite3_changes(static_cast<sqlite3*>(m_DB)); }
+  inline const CHistogram& GetQueryTimes() const { return m_QueryTimes; }
+  inline uint64_t          GetPrepares() const { return m_Prepares; }
+  inline uint64_t          GetCacheHits() const { return m_CacheHits; }
+
+  inline int32_t Step(void* Statement)
+  {
+    CHistogramTimer Timer(&m_QueryTimes);
+    return sqlite3_step(static_cast<sqlite3_stmt*>(Statement));
+  }
+
+  inline int32_t Exec(const std::string& query)
+  {
+    CHistogramTimer Timer(&m_QueryTimes);
+    return sqlite3_exec(static_cast<sqlite3*>(m_DB), query.c_str(), nullptr, nullptr, nullptr);
+  }
+};
+
+//
+// CSQLITE3Statement
+//
+
+// a prepared statement borrowed from the connection's cache, it's reset and its bindings cleared when the handle goes out of scope
+// it converts to sqlite3_stmt* so it can be passed straight to the sqlite3_bind/column functions, it's nullptr if preparing failed
+// if the cached statement is still in use (e.g. by a caller up the stack) a separate one is prepared and finalized afterwards
+
+class CSQLITE3Statement
+{
+private:
+  CSQLITE3*               m_DB;
+  void*                   m_Statement;
+  std::pair<void*, bool>* m_Entry; // the statement's entry in the cache, nullptr if it's finalized afterwards
+
+public:
+  CSQLITE3Statement(CSQLITE3* db, const std::string& query);
+  ~CSQLITE3Statement();
+  CSQLITE3Statement(const CSQLITE3Statement&) = delete;
+  CSQLITE3Statement& operator=(const CSQLITE3Statement&) = delete;
 
-  inline int32_t Step(void* Statement) { return sqlite3_step(static_cast<sqlite3_stmt*>(Statement)); }
-  inline int32_t Prepare(const std::string& query, void** Statement) { return sqlite3_prepare_v2(static_cast<sqlite3*>(m_DB), query.c_str(), -1, reinterpret_cast<sqlite3_stmt**>(Statement), nullptr); }
-  inline int32_t Finalize(void* Statement) { return sqlite3_finalize(static_cast<sqlite3_stmt*>(Statement)); }
-  inline int32_t Reset(void* Statement) { return sqlite3_reset(static_cast<sqlite3_stmt*>(Statement)); }
-  inline int32_t Exec(const std::string& query) { return sqlite3_exec(static_cast<sqlite3*>(m_DB), query.c_str(), nullptr, nullptr, nullptr); }
+  inline operator sqlite3_stmt*() const { return static_cast<sqlite3_stmt*>(m_Statement); }
 };
 
 //
@@ -125,24 +173,75 @@ class CDBGamePlayerSummary;
 class CConfig;
 class CDBBan;
 
+// the changes to one player's row waiting to be written, they're added up so a player in several finished games is still a single update
+
+struct CDBPlayerStats
+{
+  uint32_t Games;
+  uint64_t LoadingTime;
+  uint64_t Duration;
+  uint64_t Left;
+  uint32_t Dotas;
+  uint32_t Wins;
+  uint32_t Losses;
+  uint32_t Kills;
+  uint32_t Deaths;
+  uint32_t CreepKills;
+  uint32_t CreepDenies;
+  uint32_t Assists;
+  uint32_t NeutralKills;
+  uint32_t TowerKills;
+  uint32_t RaxKills;
+  uint32_t CourierKills;
+};
+
 class CAuraDB
 {
 private:
   CSQLITE3*   m_DB;
+  CSQLITE3*   m_WriteDB; // the writer thread's own connection (nullptr if it couldn't be opened, the writes then happen on m_DB)
   std::string m_File;
   std::string m_Error;
 
-  // we keep some prepared statements in memory rather than recreating them each function call
-  // this is an optimization because preparing statements takes time
-  // however it only pays off if you're going to be using the statement extremely often
+  bool m_HasError;
 
-  void* FromAddStmt;        // for faster startup time
-  void* FromCheckStmt;      // frequently used
-  void* BanCheckStmt;       // frequently used
-  void* AdminCheckStmt;     // frequently used
-  void* RootAdminCheckStmt; // frequently used
+  // games in progress may run on worker threads (see bot_gamethreads) and sqlite is built without its own locking
+  // so every query holds this mutex, it's recursive because some queries call others
 
-  bool m_HasError;
+  std::recursive_mutex m_Mutex;
+
+  // every ban is kept in memory so checking the players joining a game doesn't need a query, BanAdd and BanRemove keep it in sync with the table
+  // the keys are the lowercase name and the ip, a name can be banned on more than one server so each key has a list in the order the bans were added
+  // both indexes point to the same bans, they're owned by m_BansByName since every ban has a name
+
+  std::unordered_map<std::string, std::vector<CDBBan*>> m_BansByName;
+  std::unordered_map<std::string, std::vector<CDBBan*>> m_BansByIp;
+
+  void LoadBans();
+  void IndexBan(CDBBan* ban);
+  void UnindexBans(const std::string* server, const std::string& user); // removes the bans of user on server, or on every server if server is nullptr
+
+  // the game stats are added to a journal in memory and written behind, all at once in a single transaction
+  // the journal is written when its oldest change is db_sqlite3_flushinterval seconds old or when it has DB_JOURNAL_MAX players, whichever comes first
+  // it's written on a separate thread so a slow commit (i.e. fsync) doesn't stall anything
+  // the database is in WAL mode so the queries on m_DB can still read while the journal is being committed
+
+  std::thread                                     m_Writer;
+  std::mutex                                      m_WritesMutex;      // protects the journal, m_Callbacks and m_Exiting
+  std::condition_variable                         m_WritesCondition;  // signalled when something is journaled or we're exiting
+  std::unordered_map<std::string, CDBPlayerStats> m_Journal;          // the changes waiting to be written by lowercase player name
+  std::vector<std::function<void(bool)>>          m_JournalCallbacks; // run once the changes queued before them are written
+  std::chrono::steady_clock::time_point           m_JournalStart;     // when the oldest change in the journal was queued
+  std::chrono::seconds                            m_FlushInterval;    // config value: the longest a change waits in the journal
+  std::vector<std::function<void()>>              m_Callbacks;        // completion callbacks waiting for Update
+  bool                                            m_Exiting;
+
+  void RunWriter();
+  bool JournalPending() const; // the caller holds m_WritesMutex
+  bool JournalDue() const;     // the caller holds m_WritesMutex
+  void JournalAdding();        // called before adding to the journal, the caller holds m_WritesMutex
+  bool WriteJournal(CSQLITE3* db, const std::unordered_map<std::string, CDBPlayerStats>& journal);
+  bool WriteStats(CSQLITE3* db, const std::string& name, const CDBPlayerStats& stats);
 
 public:
   explicit CAuraDB(CConfig* CFG);
@@ -152,11 +251,19 @@ public:
   inline bool        HasError() const { return m_HasError; }
   inline std::string GetError() const { return m_Error; }
 
-  inline bool Begin() const { return m_DB->Exec("BEGIN TRANSACTION") == SQLITE_OK; }
-  inline bool Commit() const { return m_DB->Exec("COMMIT TRANSACTION") == SQLITE_OK; }
+  CHistogram GetQueryTimes(); // a copy, the statements may be running on another thread
+  uint64_t   GetStatementPrepares() const;
+  uint64_t   GetStatementCacheHits() const;
+
+  // runs the callbacks of the writes which have finished, called by the main loop
+  // if there's no writer thread it also writes the journal once it's due
+
+  void Update();
+
+  // callback is run by Update (i.e. on the main thread) once every change journaled before it has been committed, success is false if they weren't
+
+  void QueueCallback(std::function<void(bool)> callback);
 
-  std::string FromCheck(uint32_t ip);
-  bool FromAdd(uint32_t ip1, uint32_t ip2, const std::string& country);
   uint32_t AdminCount(const std::string& server);
   bool AdminCheck(const std::string& server, std::string user);
   bool AdminCheck(std::string user);
@@ -166,13 +273,13 @@ public:
   bool RootAdminAdd(const std::string& server, std::string user);
   bool AdminRemove(const std::string& server, std::string user);
   uint32_t BanCount(const std::string& server);
-  CDBBan* BanCheck(const std::string& server, std::string user, std::string ip);
+  CDBBan* BanCheck(const std::string& server, std::string user, const std::string& ip); // in memory
   bool BanAdd(const std::string& server, std::string user, const std::string& admin, const std::string& reason, std::string ip);
   bool BanRemove(const std::string& server, std::string user);
   bool BanRemove(std::string user);
-  void GamePlayerAdd(std::string name, uint64_t loadingtime, uint64_t duration, uint64_t left);
+  void GamePlayerAdd(const std::string& name, uint64_t loadingtime, uint64_t duration, uint64_t left); // journaled
   CDBGamePlayerSummary* GamePlayerSummaryCheck(std::string name);
-  void DotAPlayerAdd(std::string name, uint32_t winner, uint32_t kills, uint32_t deaths, uint32_t creepkills, uint32_t creepdenies, uint32_t assists, uint32_t neutralkills, uint32_t towerkills, uint32_t raxkills, uint32_t courierkills);
+  void DotAPlayerAdd(const std::string& name, uint32_t winner, uint32_t kills, uint32_t deaths, uint32_t creepkills, uint32_t creepdenies, uint32_t assists, uint32_t neutralkills, uint32_t towerkills, uint32_t raxkills, uint32_t courierkills); // journaled
   CDBDotAPlayerSummary* DotAPlayerSummaryCheck(std::string name);
 };
 
@@ -47,6 +47,7 @@ CBNET::CBNET(CAura* nAura, string nServer, uint32_t nServerport, const string& n
     m_Socket(new CTCPClient()),
     m_Protocol(new CBNETProtocol()),
     m_BNCSUtil(new CBNCSUtilInterface(nUserName, nUserPassword)),
+    m_OutPacketTimer([this]() { EventOutPacketTimer(); }),
     m_EXEVersion(move(nEXEVersion)),
     m_EXEVersionHash(move(nEXEVersionHash)),
     m_Server(move(nServer)),
@@ -105,10 +106,10 @@ CBNET::CBNET(CAura* nAura, string nServer, uint32_t nServerport, const string& n
   transform(begin(m_CDKeyTFT), end(m_CDKeyTFT), begin(m_CDKeyTFT), ::toupper);
 
   if (m_CDKeyROC.size() != 26)
-    Print2("[BNET: " + m_ServerAlias + "] warning - your ROC CD key is not 26 characters long and is probably invalid");
+    Print2("[BNET: " + m_ServerAlias + "] warning - your ROC CD key is not 26 characters long and is probably invalid", LOG_WARNING);
 
   if (m_CDKeyTFT.size() != 26)
-    Print2("[BNET: " + m_ServerAlias + "] warning - your TFT CD key is not 26 characters long and is probably invalid");
+    Print2("[BNET: " + m_ServerAlias + "] warning - your TFT CD key is not 26 characters long and is probably invalid", LOG_WARNING);
 }
 
 CBNET::~CBNET()
@@ -158,234 +159,218 @@ bool CBNET::Update(void* fd, void* send_fd)
 
     m_Socket->DoRecv(static_cast<fd_set*>(fd));
 
-    // extract as many packets as possible from the socket's receive buffer and put them in the m_Packets queue
+    // extract as many packets as possible from the socket's receive buffer and process them
+    // the packets are parsed in place, Data points into the receive buffer until it's consumed
 
-    string*              RecvBuffer      = m_Socket->GetBytes();
-    std::vector<uint8_t> Bytes           = CreateByteArray((uint8_t*)RecvBuffer->c_str(), RecvBuffer->size());
-    uint32_t             LengthProcessed = 0;
+    CRecvBuffer* RecvBuffer = m_Socket->GetRecvBuffer();
+    CByteSpan    Data;
 
     CIncomingGameHost*  GameHost;
     CIncomingChatEvent* ChatEvent;
 
-    // a packet is at least 4 bytes so loop as long as the buffer contains 4 bytes
+    // byte 0 is always 255
 
-    while (Bytes.size() >= 4)
+    while (RecvBuffer->GetPacket(&Data) && Data[0] == BNET_HEADER_CONSTANT)
     {
-      // byte 0 is always 255
-
-      if (Bytes[0] == BNET_HEADER_CONSTANT)
+      switch (Data[1])
       {
-        // bytes 2 and 3 contain the length of the packet
-
-        const uint16_t             Length = static_cast<uint16_t>(Bytes[3] << 8 | Bytes[2]);
-        const std::vector<uint8_t> Data   = std::vector<uint8_t>(begin(Bytes), begin(Bytes) + Length);
+        case CBNETProtocol::SID_NULL:
+          // warning: we do not respond to NULL packets with a NULL packet of our own
+          // this is because PVPGN servers are programmed to respond to NULL packets so it will create a vicious cycle of useless traffic
+          // official battle.net servers do not respond to NULL packets
 
-        if (Bytes.size() >= Length)
-        {
-          switch (Bytes[1])
-          {
-            case CBNETProtocol::SID_NULL:
-              // warning: we do not respond to NULL packets with a NULL packet of our own
-              // this is because PVPGN servers are programmed to respond to NULL packets so it will create a vicious cycle of useless traffic
-              // official battle.net servers do not respond to NULL packets
+          m_Protocol->RECEIVE_SID_NULL(Data);
+          break;
 
-              m_Protocol->RECEIVE_SID_NULL(Data);
-              break;
+        case CBNETProtocol::SID_GETADVLISTEX:
+          GameHost = m_Protocol->RECEIVE_SID_GETADVLISTEX(Data);
 
-            case CBNETProtocol::SID_GETADVLISTEX:
-              GameHost = m_Protocol->RECEIVE_SID_GETADVLISTEX(Data);
+          if (GameHost)
+            Print2("[BNET: " + m_ServerAlias + "] joining game [" + GameHost->GetGameName() + "]");
 
-              if (GameHost)
-                Print2("[BNET: " + m_ServerAlias + "] joining game [" + GameHost->GetGameName() + "]");
+          delete GameHost;
+          break;
 
-              delete GameHost;
-              break;
+        case CBNETProtocol::SID_ENTERCHAT:
+          if (m_Protocol->RECEIVE_SID_ENTERCHAT(Data))
+          {
+            Print2("[BNET: " + m_ServerAlias + "] joining channel [" + m_FirstChannel + "]");
+            m_InChat = true;
+            m_Socket->PutBytes(m_Protocol->SEND_SID_JOINCHANNEL(m_FirstChannel));
+          }
 
-            case CBNETProtocol::SID_ENTERCHAT:
-              if (m_Protocol->RECEIVE_SID_ENTERCHAT(Data))
-              {
-                Print2("[BNET: " + m_ServerAlias + "] joining channel [" + m_FirstChannel + "]");
-                m_InChat = true;
-                m_Socket->PutBytes(m_Protocol->SEND_SID_JOINCHANNEL(m_FirstChannel));
-              }
+          break;
 
-              break;
+        case CBNETProtocol::SID_CHATEVENT:
+          ChatEvent = m_Protocol->RECEIVE_SID_CHATEVENT(Data);
 
-            case CBNETProtocol::SID_CHATEVENT:
-              ChatEvent = m_Protocol->RECEIVE_SID_CHATEVENT(Data);
+          if (ChatEvent)
+            ProcessChatEvent(ChatEvent);
 
-              if (ChatEvent)
-                ProcessChatEvent(ChatEvent);
+          delete ChatEvent;
+          break;
 
-              delete ChatEvent;
-              break;
+        case CBNETProtocol::SID_CHECKAD:
+          m_Protocol->RECEIVE_SID_CHECKAD(Data);
+          break;
 
-            case CBNETProtocol::SID_CHECKAD:
-              m_Protocol->RECEIVE_SID_CHECKAD(Data);
-              break;
+        case CBNETProtocol::SID_STARTADVEX3:
+          if (m_Protocol->RECEIVE_SID_STARTADVEX3(Data))
+          {
+            m_InChat = false;
+          }
+          else
+          {
+            Print2("[BNET: " + m_ServerAlias + "] startadvex3 failed");
+            m_Aura->EventBNETGameRefreshFailed(this);
+          }
 
-            case CBNETProtocol::SID_STARTADVEX3:
-              if (m_Protocol->RECEIVE_SID_STARTADVEX3(Data))
-              {
-                m_InChat = false;
-              }
-              else
-              {
-                Print2("[BNET: " + m_ServerAlias + "] startadvex3 failed");
-                m_Aura->EventBNETGameRefreshFailed(this);
-              }
+          break;
 
-              break;
+        case CBNETProtocol::SID_PING:
+          m_Socket->PutBytes(m_Protocol->SEND_SID_PING(m_Protocol->RECEIVE_SID_PING(Data)));
+          break;
 
-            case CBNETProtocol::SID_PING:
-              m_Socket->PutBytes(m_Protocol->SEND_SID_PING(m_Protocol->RECEIVE_SID_PING(Data)));
-              break;
+        case CBNETProtocol::SID_AUTH_INFO:
 
-            case CBNETProtocol::SID_AUTH_INFO:
+          if (m_Protocol->RECEIVE_SID_AUTH_INFO(Data))
+          {
+            if (m_BNCSUtil->HELP_SID_AUTH_CHECK(m_Aura->m_Warcraft3Path, m_CDKeyROC, m_CDKeyTFT, m_Protocol->GetValueStringFormulaString(), m_Protocol->GetIX86VerFileNameString(), m_Protocol->GetClientToken(), m_Protocol->GetServerToken(), m_War3Version))
+            {
+              // override the exe information generated by bncsutil if specified in the config file
+              // apparently this is useful for pvpgn users
 
-              if (m_Protocol->RECEIVE_SID_AUTH_INFO(Data))
+              if (m_EXEVersion.size() == 4)
               {
-                if (m_BNCSUtil->HELP_SID_AUTH_CHECK(m_Aura->m_Warcraft3Path, m_CDKeyROC, m_CDKeyTFT, m_Protocol->GetValueStringFormulaString(), m_Protocol->GetIX86VerFileNameString(), m_Protocol->GetClientToken(), m_Protocol->GetServerToken(), m_War3Version))
-                {
-                  // override the exe information generated by bncsutil if specified in the config file
-                  // apparently this is useful for pvpgn users
-
-                  if (m_EXEVersion.size() == 4)
-                  {
-                    Print2("[BNET: " + m_ServerAlias + "] using custom exe version bnet_custom_exeversion = " + to_string(m_EXEVersion[0]) + " " + to_string(m_EXEVersion[1]) + " " + to_string(m_EXEVersion[2]) + " " + to_string(m_EXEVersion[3]));
-                    m_BNCSUtil->SetEXEVersion(m_EXEVersion);
-                  }
-
-                  if (m_EXEVersionHash.size() == 4)
-                  {
-                    Print2("[BNET: " + m_ServerAlias + "] using custom exe version hash bnet_custom_exeversionhash = " + to_string(m_EXEVersionHash[0]) + " " + to_string(m_EXEVersionHash[1]) + " " + to_string(m_EXEVersionHash[2]) + " " + to_string(m_EXEVersionHash[3]));
-                    m_BNCSUtil->SetEXEVersionHash(m_EXEVersionHash);
-                  }
-
-                  Print2("[BNET: " + m_ServerAlias + "] attempting to auth as Warcraft III: The Frozen Throne");
-
-                  m_Socket->PutBytes(m_Protocol->SEND_SID_AUTH_CHECK(m_Protocol->GetClientToken(), m_BNCSUtil->GetEXEVersion(), m_BNCSUtil->GetEXEVersionHash(), m_BNCSUtil->GetKeyInfoROC(), m_BNCSUtil->GetKeyInfoTFT(), m_BNCSUtil->GetEXEInfo(), "Aura"));
-                }
-                else
-                {
-                  Print2("[BNET: " + m_ServerAlias + "] logon failed - bncsutil key hash failed (check your Warcraft 3 path and cd keys), disconnecting");
-                  m_Socket->Disconnect();
-                }
+                Print2("[BNET: " + m_ServerAlias + "] using custom exe version bnet_custom_exeversion = " + to_string(m_EXEVersion[0]) + " " + to_string(m_EXEVersion[1]) + " " + to_string(m_EXEVersion[2]) + " " + to_string(m_EXEVersion[3]));
+                m_BNCSUtil->SetEXEVersion(m_EXEVersion);
               }
 
-              break;
+              if (m_EXEVersionHash.size() == 4)
+              {
+                Print2("[BNET: " + m_ServerAlias + "] using custom exe version hash bnet_custom_exeversionhash = " + to_string(m_EXEVersionHash[0]) + " " + to_string(m_EXEVersionHash[1]) + " " + to_string(m_EXEVersionHash[2]) + " " + to_string(m_EXEVersionHash[3]));
+                m_BNCSUtil->SetEXEVersionHash(m_EXEVersionHash);
+              }
 
-            case CBNETProtocol::SID_AUTH_CHECK:
+              Print2("[BNET: " + m_ServerAlias + "] attempting to auth as Warcraft III: The Frozen Throne");
 
-                // cd keys accepted
+              m_Socket->PutBytes(m_Protocol->SEND_SID_AUTH_CHECK(m_Protocol->GetClientToken(), m_BNCSUtil->GetEXEVersion(), m_BNCSUtil->GetEXEVersionHash(), m_BNCSUtil->GetKeyInfoROC(), m_BNCSUtil->GetKeyInfoTFT(), m_BNCSUtil->GetEXEInfo(), "Aura"));
+            }
+            else
+            {
+              Print2("[BNET: " + m_ServerAlias + "] logon failed - bncsutil key hash failed (check your Warcraft 3 path and cd keys), disconnecting");
+              m_Socket->Disconnect();
+            }
+          }
 
-                Print2("[BNET: " + m_ServerAlias + "] cd keys accepted");
-                m_BNCSUtil->HELP_SID_AUTH_ACCOUNTLOGON();
-                m_Socket->PutBytes(m_Protocol->SEND_SID_AUTH_ACCOUNTLOGON(m_BNCSUtil->GetClientKey(), m_UserName));
+          break;
 
-              break;
+        case CBNETProtocol::SID_AUTH_CHECK:
 
-            case CBNETProtocol::SID_AUTH_ACCOUNTLOGON:
-              if (m_Protocol->RECEIVE_SID_AUTH_ACCOUNTLOGON(Data))
-              {
-                Print2("[BNET: " + m_ServerAlias + "] username [" + m_UserName + "] accepted");
+            // cd keys accepted
 
-                if (m_PasswordHashType == "pvpgn")
-                {
-                  // pvpgn logon
+            Print2("[BNET: " + m_ServerAlias + "] cd keys accepted");
+            m_BNCSUtil->HELP_SID_AUTH_ACCOUNTLOGON();
+            m_Socket->PutBytes(m_Protocol->SEND_SID_AUTH_ACCOUNTLOGON(m_BNCSUtil->GetClientKey(), m_UserName));
 
-                  Print2("[BNET: " + m_ServerAlias + "] using pvpgn logon type (for pvpgn servers only)");
-                  m_BNCSUtil->HELP_PvPGNPasswordHash(m_UserPassword);
-                  m_Socket->PutBytes(m_Protocol->SEND_SID_AUTH_ACCOUNTLOGONPROOF(m_BNCSUtil->GetPvPGNPasswordHash()));
-                }
-                else
-                {
-                  // battle.net logon
+          break;
 
-                  Print2("[BNET: " + m_ServerAlias + "] using battle.net logon type (for official battle.net servers only)");
-                  m_BNCSUtil->HELP_SID_AUTH_ACCOUNTLOGONPROOF(m_Protocol->GetSalt(), m_Protocol->GetServerPublicKey());
-                  m_Socket->PutBytes(m_Protocol->SEND_SID_AUTH_ACCOUNTLOGONPROOF(m_BNCSUtil->GetM1()));
-                }
-              }
-              else
-              {
-                Print2("[BNET: " + m_ServerAlias + "] logon failed - invalid username, disconnecting");
-                m_Socket->Disconnect();
-              }
+        case CBNETProtocol::SID_AUTH_ACCOUNTLOGON:
+          if (m_Protocol->RECEIVE_SID_AUTH_ACCOUNTLOGON(Data))
+          {
+            Print2("[BNET: " + m_ServerAlias + "] username [" + m_UserName + "] accepted");
 
-              break;
+            if (m_PasswordHashType == "pvpgn")
+            {
+              // pvpgn logon
 
-            case CBNETProtocol::SID_AUTH_ACCOUNTLOGONPROOF:
-              if (m_Protocol->RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF(Data))
-              {
-                // logon successful
-
-                Print2("[BNET: " + m_ServerAlias + "] logon successful");
-                m_LoggedIn = true;
-                m_Socket->PutBytes(m_Protocol->SEND_SID_NETGAMEPORT(m_Aura->m_HostPort));
-                m_Socket->PutBytes(m_Protocol->SEND_SID_ENTERCHAT());
-                m_Socket->PutBytes(m_Protocol->SEND_SID_FRIENDLIST());
-                m_Socket->PutBytes(m_Protocol->SEND_SID_CLANMEMBERLIST());
-              }
-              else
-              {
-                Print2("[BNET: " + m_ServerAlias + "] logon failed - invalid password, disconnecting");
+              Print2("[BNET: " + m_ServerAlias + "] using pvpgn logon type (for pvpgn servers only)");
+              m_BNCSUtil->HELP_PvPGNPasswordHash(m_UserPassword);
+              m_Socket->PutBytes(m_Protocol->SEND_SID_AUTH_ACCOUNTLOGONPROOF(m_BNCSUtil->GetPvPGNPasswordHash()));
+            }
+            else
+            {
+              // battle.net logon
 
-                // try to figure out if the user might be using the wrong logon type since too many people are confused by this
+              Print2("[BNET: " + m_ServerAlias + "] using battle.net logon type (for official battle.net servers only)");
+              m_BNCSUtil->HELP_SID_AUTH_ACCOUNTLOGONPROOF(m_Protocol->GetSalt(), m_Protocol->GetServerPublicKey());
+              m_Socket->PutBytes(m_Protocol->SEND_SID_AUTH_ACCOUNTLOGONPROOF(m_BNCSUtil->GetM1()));
+            }
+          }
+          else
+          {
+            Print2("[BNET: " + m_ServerAlias + "] logon failed - invalid username, disconnecting");
+            m_Socket->Disconnect();
+          }
 
-                string Server = m_Server;
-                transform(begin(Server), end(Server), begin(Server), ::tolower);
+          break;
 
-                if (m_PvPGN && (Server == "useast.battle.net" || Server == "uswest.battle.net" || Server == "asia.battle.net" || Server == "europe.battle.net"))
-                  Print2("[BNET: " + m_ServerAlias + R"(] it looks like you're trying to connect to a battle.net server using a pvpgn logon type, check your config file's "battle.net custom data" section)");
-                else if (!m_PvPGN && (Server != "useast.battle.net" && Server != "uswest.battle.net" && Server != "asia.battle.net" && Server != "europe.battle.net"))
-                  Print2("[BNET: " + m_ServerAlias + R"(] it looks like you're trying to connect to a pvpgn server using a battle.net logon type, check your config file's "battle.net custom data" section)");
+        case CBNETProtocol::SID_AUTH_ACCOUNTLOGONPROOF:
+          if (m_Protocol->RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF(Data))
+          {
+            // logon successful
+
+            Print2("[BNET: " + m_ServerAlias + "] logon successful");
+            m_LoggedIn = true;
+            m_Socket->PutBytes(m_Protocol->SEND_SID_NETGAMEPORT(m_Aura->m_HostPort));
+            m_Socket->PutBytes(m_Protocol->SEND_SID_ENTERCHAT());
+            m_Socket->PutBytes(m_Protocol->SEND_SID_FRIENDLIST());
+            m_Socket->PutBytes(m_Protocol->SEND_SID_CLANMEMBERLIST());
+          }
+          else
+          {
+            Print2("[BNET: " + m_ServerAlias + "] logon failed - invalid password, disconnecting");
 
-                m_Socket->Disconnect();
-              }
+            // try to figure out if the user might be using the wrong logon type since too many people are confused by this
 
-              break;
+            string Server = m_Server;
+            transform(begin(Server), end(Server), begin(Server), ::tolower);
 
-            case CBNETProtocol::SID_FRIENDLIST:
-              m_Friends = m_Protocol->RECEIVE_SID_FRIENDLIST(Data);
-              break;
+            if (m_PvPGN && (Server == "useast.battle.net" || Server == "uswest.battle.net" || Server == "asia.battle.net" || Server == "europe.battle.net"))
+              Print2("[BNET: " + m_ServerAlias + R"(] it looks like you're trying to connect to a battle.net server using a pvpgn logon type, check your config file's "battle.net custom data" section)");
+            else if (!m_PvPGN && (Server != "useast.battle.net" && Server != "uswest.battle.net" && Server != "asia.battle.net" && Server != "europe.battle.net"))
+              Print2("[BNET: " + m_ServerAlias + R"(] it looks like you're trying to connect to a pvpgn server using a battle.net logon type, check your config file's "battle.net custom data" section)");
 
-            case CBNETProtocol::SID_CLANMEMBERLIST:
-              m_Clan = m_Protocol->RECEIVE_SID_CLANMEMBERLIST(Data);
-              break;
+            m_Socket->Disconnect();
           }
 
-          LengthProcessed += Length;
-          Bytes = std::vector<uint8_t>(begin(Bytes) + Length, end(Bytes));
-        }
-        else
+          break;
+
+        case CBNETProtocol::SID_FRIENDLIST:
+          m_Friends = m_Protocol->RECEIVE_SID_FRIENDLIST(Data);
+          break;
+
+        case CBNETProtocol::SID_CLANMEMBERLIST:
+          m_Clan = m_Protocol->RECEIVE_SID_CLANMEMBERLIST(Data);
           break;
       }
-    }
 
-    *RecvBuffer = RecvBuffer->substr(LengthProcessed);
+      RecvBuffer->Consume(Data.size());
+    }
 
-    // check if at least one packet is waiting to be sent and if we've waited long enough to prevent flooding
-    // this formula has changed many times but currently we wait 1 second if the last packet was "small", 3.5 seconds if it was "medium", and 4 seconds if it was "big"
+    // anything else means we've lost track of the packet boundaries, there's no way to recover
 
-    int64_t WaitTicks;
+    if (!RecvBuffer->IsEmpty() && (RecvBuffer->HasBadPacket() || RecvBuffer->GetData()[0] != BNET_HEADER_CONSTANT))
+    {
+      Print2("[BNET: " + m_ServerAlias + "] received an invalid packet, disconnecting");
+      m_Socket->Disconnect();
+    }
 
-    if (m_LastOutPacketSize < 10)
-      WaitTicks = 1300;
-    else if (m_LastOutPacketSize < 100)
-      WaitTicks = 3300;
-    else
-      WaitTicks = 4300;
+    // check if at least one packet is waiting to be sent and schedule it for when we've waited long enough to prevent flooding
+    // this formula has changed many times but currently we wait 1 second if the last packet was "small", 3.5 seconds if it was "medium", and 4 seconds if it was "big"
 
-    if (!m_OutPackets.empty() && Ticks - m_LastOutPacketTicks >= WaitTicks)
+    if (!m_OutPackets.empty() && !m_OutPacketTimer.IsScheduled())
     {
-      if (m_OutPackets.size() > 7)
-        Print2("[BNET: " + m_ServerAlias + "] packet queue warning - there are " + to_string(m_OutPackets.size()) + " packets waiting to be sent");
+      int64_t WaitTicks;
 
-      m_Socket->PutBytes(m_OutPackets.front());
-      m_LastOutPacketSize = m_OutPackets.front().size();
-      m_OutPackets.pop();
-      m_LastOutPacketTicks = Ticks;
+      if (m_LastOutPacketSize < 10)
+        WaitTicks = 1300;
+      else if (m_LastOutPacketSize < 100)
+        WaitTicks = 3300;
+      else
+        WaitTicks = 4300;
+
+      m_OutPacketTimer.Schedule(CTimerWheel::GetDefault(), m_LastOutPacketTicks + WaitTicks);
     }
 
     // send a null packet every 60 seconds to detect disconnects
@@ -464,6 +449,7 @@ bool CBNET::Update(void* fd, void* send_fd)
       while (!m_OutPackets.empty())
         m_OutPackets.pop();
 
+      m_OutPacketTimer.Cancel();
       return m_Exiting;
     }
     else if (Time - m_LastConnectionAttemptTime >= 15)
@@ -482,6 +468,22 @@ bool CBNET::Update(void* fd, void* send_fd)
   return m_Exiting;
 }
 
+void CBNET::EventOutPacketTimer()
+{
+  // the next packet in the queue may be sent now, the socket is flushed later in this loop by Update
+
+  if (m_OutPackets.empty() || !m_Socket->GetConnected())
+    return;
+
+  if (m_OutPackets.size() > 7)
+    Print2("[BNET: " + m_ServerAlias + "] packet queue warning - there are " + to_string(m_OutPackets.size()) + " packets waiting to be sent", LOG_WARNING);
+
+  m_Socket->PutBytes(m_OutPackets.front());
+  m_LastOutPacketSize = m_OutPackets.front().size();
+  m_OutPackets.pop();
+  m_LastOutPacketTicks = GetTicks();
+}
+
 void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
 {
   CBNETProtocol::IncomingChatEvent Event   = chatEvent->GetChatEvent();
@@ -588,15 +590,15 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
                   if (File.find("DotA") != string::npos)
                     MapCFG.Set("map_type", "dota");
 
-                  m_Aura->m_Map->Load(&MapCFG, File);
-
-                  if (m_Aura->m_Map)
-                  {
-                    const char* ErrorMessage = m_Aura->m_Map->CheckValid();
+                  const bool Loading = m_Aura->LoadMap(MapCFG, File, [this, User, Whisper, IRC = m_IRC](CMap* map) {
+                    const char* ErrorMessage = map->CheckValid();
 
                     if (ErrorMessage)
-                      QueueChatCommand(std::string("Error while loading map: [") + ErrorMessage + "]", User, Whisper, m_IRC);
-                  }
+                      QueueChatCommand(std::string("Error while loading map: [") + ErrorMessage + "]", User, Whisper, IRC);
+                  });
+
+                  if (!Loading)
+                    QueueChatCommand("Unable to load map file [" + File + "]. Another map is still loading", User, Whisper, m_IRC);
                 }
                 else
                 {
@@ -692,7 +694,9 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
                   QueueChatCommand("Loading config file [" + m_Aura->m_MapCFGPath + File + "]", User, Whisper, m_IRC);
                   CConfig MapCFG;
                   MapCFG.Read(m_Aura->m_MapCFGPath + File);
-                  m_Aura->m_Map->Load(&MapCFG, m_Aura->m_MapCFGPath + File);
+
+                  if (!m_Aura->LoadMap(MapCFG, m_Aura->m_MapCFGPath + File, nullptr))
+                    QueueChatCommand("Unable to load config file [" + File + "]. Another map is still loading", User, Whisper, m_IRC);
                 }
                 else
                 {
@@ -1193,15 +1197,18 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
 
               if (GameNumber < m_Aura->m_Games.size())
               {
+                CGame*            Game = m_Aura->m_Games[GameNumber];
+                lock_guard<mutex> Lock(Game->GetMutex());
+
                 // if the game owner is still in the game only allow the root admin to end the game
 
-                if (m_Aura->m_Games[GameNumber]->GetPlayerFromName(m_Aura->m_Games[GameNumber]->GetOwnerName(), false) && !IsRootAdmin(User))
-                  QueueChatCommand("You can't end that game because the game owner [" + m_Aura->m_Games[GameNumber]->GetOwnerName() + "] is still playing", User, Whisper, m_IRC);
+                if (Game->GetPlayerFromName(Game->GetOwnerName(), false) && !IsRootAdmin(User))
+                  QueueChatCommand("You can't end that game because the game owner [" + Game->GetOwnerName() + "] is still playing", User, Whisper, m_IRC);
                 else
                 {
-                  QueueChatCommand("Ending game [" + m_Aura->m_Games[GameNumber]->GetDescription() + "]", User, Whisper, m_IRC);
-                  Print2("[GAME: " + m_Aura->m_Games[GameNumber]->GetGameName() + "] is over (admin ended game)");
-                  m_Aura->m_Games[GameNumber]->StopPlayers("was disconnected (admin ended game)");
+                  QueueChatCommand("Ending game [" + Game->GetDescription() + "]", User, Whisper, m_IRC);
+                  Print2("[GAME: " + Game->GetGameName() + "] is over (admin ended game)");
+                  Game->StopPlayers("was disconnected (admin ended game)");
                 }
               }
               else
@@ -1411,18 +1418,19 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
                  if (Mapname.find("DotA") != string::npos)
                     MapCFG.Set("map_type", "dota");
 
-                 m_Aura->m_Map->Load(&MapCFG, Mapname);
-
-                 if (m_Aura->m_Map) {
-                   const char* ErrorMessage = m_Aura->m_Map->CheckValid();
+                 const bool Loading = m_Aura->LoadMap(MapCFG, Mapname, [this, User, Whisper, IRC = m_IRC, Mapname](CMap* map) {
+                   const char* ErrorMessage = map->CheckValid();
                    if (ErrorMessage) {
-                      QueueChatCommand(std::string("Error while loading map: [") + ErrorMessage + "]", User, Whisper, m_IRC);
+                      QueueChatCommand(std::string("Error while loading map: [") + ErrorMessage + "]", User, Whisper, IRC);
                       if (!remove((m_Aura->m_MapPath + Mapname).c_str()))
-                         QueueChatCommand("Deleted [" + Mapname + "]", User, Whisper, m_IRC);
+                         QueueChatCommand("Deleted [" + Mapname + "]", User, Whisper, IRC);
                       else
-                         QueueChatCommand("Removal failed", User, Whisper, m_IRC);
+                         QueueChatCommand("Removal failed", User, Whisper, IRC);
                    }
-                 }
+                 });
+
+                 if (!Loading)
+                   QueueChatCommand("Unable to load map file [" + Mapname + "]. Another map is still loading", User, Whisper, m_IRC);
             }
             else {
                  QueueChatCommand(Mapname + " download failed", User, Whisper, m_IRC);
@@ -1488,6 +1496,59 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
             break;
           }
 
+          //
+          // !PERF
+          // !PERFDUMP
+          //
+
+          case HashCode("perf"):
+          {
+            if (!IsRootAdmin(User))
+            {
+              QueueChatCommand("You don't have access to that command", User, Whisper, m_IRC);
+              break;
+            }
+
+            if (Payload.empty())
+            {
+              QueueChatCommand("update: " + m_Aura->m_PerfUpdate.GetSummary("us"), User, Whisper, m_IRC);
+              break;
+            }
+
+            try
+            {
+              const uint32_t GameNumber = stoul(Payload) - 1;
+
+              if (GameNumber < m_Aura->m_Games.size())
+              {
+                lock_guard<mutex> Lock(m_Aura->m_Games[GameNumber]->GetMutex());
+
+                for (const auto& line : m_Aura->m_Games[GameNumber]->GetPerfReport())
+                  QueueChatCommand(line, User, Whisper, m_IRC);
+              }
+              else
+                QueueChatCommand("Game number " + Payload + " doesn't exist", User, Whisper, m_IRC);
+            }
+            catch (...)
+            {
+              // do nothing
+            }
+
+            break;
+          }
+
+          case HashCode("perfdump"):
+          {
+            if (!IsRootAdmin(User))
+              QueueChatCommand("You don't have access to that command", User, Whisper, m_IRC);
+            else if (m_Aura->DumpPerf())
+              QueueChatCommand("Wrote the performance histograms to [" + m_Aura->m_PerfFile + "]", User, Whisper, m_IRC);
+            else
+              QueueChatCommand("Unable to write the performance histograms to [" + m_Aura->m_PerfFile + "]", User, Whisper, m_IRC);
+
+            break;
+          }
+
           //
           // !PRIVBY (host private game by other player)
           //
@@ -1566,7 +1627,10 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
 
             for (auto& game : m_Aura->m_Games){
               if (IsRootAdmin(User) || Payload[0] != '/')
+              {
+                lock_guard<mutex> Lock(game->GetMutex());
                 game->SendAllChat(Payload);
+              }
             }
             break;
           }
@@ -1606,7 +1670,10 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
                     Message = Message.substr(Start);
 
                   if (GameNumber - 1 < m_Aura->m_Games.size())
+                  {
+                    lock_guard<mutex> Lock(m_Aura->m_Games[GameNumber - 1]->GetMutex());
                     m_Aura->m_Games[GameNumber - 1]->SendAllChat("ADMIN: " + Message);
+                  }
                   else
                     QueueChatCommand("Game number " + to_string(GameNumber) + " doesn't exist", User, Whisper, m_IRC);
                 }
@@ -1633,7 +1700,10 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
                 m_Aura->m_CurrentGame->SendAllChat(Payload);
 
               for (auto& game : m_Aura->m_Games)
+              {
+                lock_guard<mutex> Lock(game->GetMutex());
                 game->SendAllChat("ADMIN: " + Payload);
+              }
             }
             else
             {
@@ -1641,7 +1711,10 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
                 m_Aura->m_CurrentGame->SendAllChat(Payload);
 
               for (auto& game : m_Aura->m_Games)
+              {
+                lock_guard<mutex> Lock(game->GetMutex());
                 game->SendAllChat("ADMIN (" + User + "): " + Payload);
+              }
             }
 
             break;
@@ -1937,7 +2010,10 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
               const uint32_t GameNumber = stoul(Payload) - 1;
 
               if (GameNumber < m_Aura->m_Games.size())
+              {
+                lock_guard<mutex> Lock(m_Aura->m_Games[GameNumber]->GetMutex());
                 QueueChatCommand("Game number " + Payload + " is [" + m_Aura->m_Games[GameNumber]->GetDescription() + "]", User, Whisper, m_IRC);
+              }
               else
                 QueueChatCommand("Game number " + Payload + " doesn't exist", User, Whisper, m_IRC);
             }
@@ -1978,7 +2054,10 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
             const int32_t GameNumber = stoi(Payload) - 1;
 
             if (-1 < GameNumber && GameNumber < static_cast<int32_t>(m_Aura->m_Games.size()))
+            {
+              lock_guard<mutex> Lock(m_Aura->m_Games[GameNumber]->GetMutex());
               QueueChatCommand("Players in game [" + m_Aura->m_Games[GameNumber]->GetGameName() + "] are: " + m_Aura->m_Games[GameNumber]->GetPlayers(), User, Whisper, m_IRC);
+            }
             else if (GameNumber == -1 && m_Aura->m_CurrentGame)
               QueueChatCommand("Players in lobby [" + m_Aura->m_CurrentGame->GetGameName() + "] are: " + m_Aura->m_CurrentGame->GetPlayers(), User, Whisper, m_IRC);
             else
@@ -2001,7 +2080,10 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
             const int32_t GameNumber = stoi(Payload) - 1;
 
             if (-1 < GameNumber && GameNumber < static_cast<int32_t>(m_Aura->m_Games.size()))
+            {
+              lock_guard<mutex> Lock(m_Aura->m_Games[GameNumber]->GetMutex());
               QueueChatCommand("Observers in game [" + m_Aura->m_Games[GameNumber]->GetGameName() + "] are: " + m_Aura->m_Games[GameNumber]->GetObservers(), User, Whisper, m_IRC);
+            }
             else if (GameNumber == -1 && m_Aura->m_CurrentGame)
               QueueChatCommand("Observers in lobby [" + m_Aura->m_CurrentGame->GetGameName() + "] are: " + m_Aura->m_CurrentGame->GetObservers(), User, Whisper, m_IRC);
             else
@@ -2058,6 +2140,9 @@ void CBNET::ProcessChatEvent(const CIncomingChatEvent* chatEvent)
             if (m_Aura->m_IRC)
               message += m_Aura->m_IRC->m_Server + (!m_Aura->m_IRC->m_WaitingToConnect ? " [online]" : " [offline]");
 
+            if (IsRootAdmin(User))
+              message += ", send copies: " + to_string(m_Aura->m_SendBytesCopiedRate) + " B/s";
+
             QueueChatCommand(message, User, Whisper, m_IRC);
             break;
           }
@@ -2156,7 +2241,7 @@ void CBNET::QueueChatCommand(const string& chatCommand)
   {
     if (m_OutPackets.size() <= 10)
     {
-      Print2("[QUEUED: " + m_ServerAlias + "] " + chatCommand);
+      Print2("[QUEUED: " + m_ServerAlias + "] " + chatCommand, LOG_DEBUG);
 
       if (m_PvPGN)
         m_OutPackets.push(m_Protocol->SEND_SID_CHATCOMMAND(chatCommand.substr(0, 200)));
@@ -22,6 +22,7 @@
 #define AURA_BNET_H_
 
 #include "includes.h"
+#include "timerwheel.h"
 
 #include <queue>
 
@@ -50,6 +51,7 @@ private:
   CBNETProtocol*                   m_Protocol;                  // battle.net protocol
   CBNCSUtilInterface*              m_BNCSUtil;                  // the interface to the bncsutil library (used for logging into battle.net)
   std::queue<std::vector<uint8_t>> m_OutPackets;                // queue of outgoing packets to be sent (to prevent getting kicked for flooding)
+  CTimer                           m_OutPacketTimer;            // fires when the next packet in m_OutPackets may be sent
   std::vector<std::string>         m_Friends;                   // std::vector of friends
   std::vector<std::string>         m_Clan;                      // std::vector of clan members
   std::vector<uint8_t>             m_EXEVersion;                // custom exe version for PvPGN users
@@ -117,6 +119,7 @@ public:
   uint32_t SetFD(void* fd, void* send_fd, int32_t* nfds);
   bool Update(void* fd, void* send_fd);
   void ProcessChatEvent(const CIncomingChatEvent* chatEvent);
+  void EventOutPacketTimer();
 
   // functions to send packets to battle.net
 
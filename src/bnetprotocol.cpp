@@ -37,7 +37,7 @@ CBNETProtocol::~CBNETProtocol() = default;
 // RECEIVE FUNCTIONS //
 ///////////////////////
 
-bool CBNETProtocol::RECEIVE_SID_NULL(const std::vector<uint8_t>& data)
+bool CBNETProtocol::RECEIVE_SID_NULL(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_NULL" );
   // DEBUG_Print( data );
@@ -48,7 +48,7 @@ bool CBNETProtocol::RECEIVE_SID_NULL(const std::vector<uint8_t>& data)
   return ValidateLength(data);
 }
 
-CIncomingGameHost* CBNETProtocol::RECEIVE_SID_GETADVLISTEX(const std::vector<uint8_t>& data)
+CIncomingGameHost* CBNETProtocol::RECEIVE_SID_GETADVLISTEX(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_GETADVLISTEX" );
   // DEBUG_Print( data );
@@ -94,7 +94,7 @@ CIncomingGameHost* CBNETProtocol::RECEIVE_SID_GETADVLISTEX(const std::vector<uin
   return nullptr;
 }
 
-bool CBNETProtocol::RECEIVE_SID_ENTERCHAT(const std::vector<uint8_t>& data)
+bool CBNETProtocol::RECEIVE_SID_ENTERCHAT(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_ENTERCHAT" );
   // DEBUG_Print( data );
@@ -112,7 +112,7 @@ bool CBNETProtocol::RECEIVE_SID_ENTERCHAT(const std::vector<uint8_t>& data)
   return false;
 }
 
-CIncomingChatEvent* CBNETProtocol::RECEIVE_SID_CHATEVENT(const std::vector<uint8_t>& data)
+CIncomingChatEvent* CBNETProtocol::RECEIVE_SID_CHATEVENT(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_CHATEVENT" );
   // DEBUG_Print( data );
@@ -141,7 +141,7 @@ CIncomingChatEvent* CBNETProtocol::RECEIVE_SID_CHATEVENT(const std::vector<uint8
   return nullptr;
 }
 
-bool CBNETProtocol::RECEIVE_SID_CHECKAD(const std::vector<uint8_t>& data)
+bool CBNETProtocol::RECEIVE_SID_CHECKAD(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_CHECKAD" );
   // DEBUG_Print( data );
@@ -152,7 +152,7 @@ bool CBNETProtocol::RECEIVE_SID_CHECKAD(const std::vector<uint8_t>& data)
   return ValidateLength(data);
 }
 
-bool CBNETProtocol::RECEIVE_SID_STARTADVEX3(const std::vector<uint8_t>& data)
+bool CBNETProtocol::RECEIVE_SID_STARTADVEX3(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_STARTADVEX3" );
   // DEBUG_Print( data );
@@ -172,7 +172,7 @@ bool CBNETProtocol::RECEIVE_SID_STARTADVEX3(const std::vector<uint8_t>& data)
   return false;
 }
 
-std::vector<uint8_t> CBNETProtocol::RECEIVE_SID_PING(const std::vector<uint8_t>& data)
+std::vector<uint8_t> CBNETProtocol::RECEIVE_SID_PING(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_PING" );
   // DEBUG_Print( data );
@@ -187,7 +187,7 @@ std::vector<uint8_t> CBNETProtocol::RECEIVE_SID_PING(const std::vector<uint8_t>&
   return std::vector<uint8_t>();
 }
 
-bool CBNETProtocol::RECEIVE_SID_AUTH_INFO(const std::vector<uint8_t>& data)
+bool CBNETProtocol::RECEIVE_SID_AUTH_INFO(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_AUTH_INFO" );
   // DEBUG_Print( data );
@@ -214,7 +214,7 @@ bool CBNETProtocol::RECEIVE_SID_AUTH_INFO(const std::vector<uint8_t>& data)
   return false;
 }
 
-bool CBNETProtocol::RECEIVE_SID_AUTH_CHECK(const std::vector<uint8_t>& data)
+bool CBNETProtocol::RECEIVE_SID_AUTH_CHECK(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_AUTH_CHECK" );
   // DEBUG_Print( data );
@@ -236,7 +236,7 @@ bool CBNETProtocol::RECEIVE_SID_AUTH_CHECK(const std::vector<uint8_t>& data)
   return false;
 }
 
-bool CBNETProtocol::RECEIVE_SID_AUTH_ACCOUNTLOGON(const std::vector<uint8_t>& data)
+bool CBNETProtocol::RECEIVE_SID_AUTH_ACCOUNTLOGON(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_AUTH_ACCOUNTLOGON" );
   // DEBUG_Print( data );
@@ -263,7 +263,7 @@ bool CBNETProtocol::RECEIVE_SID_AUTH_ACCOUNTLOGON(const std::vector<uint8_t>& da
   return false;
 }
 
-bool CBNETProtocol::RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF(const std::vector<uint8_t>& data)
+bool CBNETProtocol::RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_AUTH_ACCOUNTLOGONPROOF" );
   // DEBUG_Print( data );
@@ -283,7 +283,7 @@ bool CBNETProtocol::RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF(const std::vector<uint8_t
   return false;
 }
 
-vector<string> CBNETProtocol::RECEIVE_SID_FRIENDLIST(const std::vector<uint8_t>& data)
+vector<string> CBNETProtocol::RECEIVE_SID_FRIENDLIST(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_FRIENDSLIST" );
   // DEBUG_Print( data );
@@ -328,7 +328,7 @@ vector<string> CBNETProtocol::RECEIVE_SID_FRIENDLIST(const std::vector<uint8_t>&
   return Friends;
 }
 
-vector<string> CBNETProtocol::RECEIVE_SID_CLANMEMBERLIST(const std::vector<uint8_t>& data)
+vector<string> CBNETProtocol::RECEIVE_SID_CLANMEMBERLIST(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED SID_CLANMEMBERLIST" );
   // DEBUG_Print( data );
@@ -671,7 +671,7 @@ std::vector<uint8_t> CBNETProtocol::SEND_SID_CLANMEMBERLIST()
 // OTHER FUNCTIONS //
 /////////////////////
 
-bool CBNETProtocol::ValidateLength(const std::vector<uint8_t>& content)
+bool CBNETProtocol::ValidateLength(const CByteSpan& content)
 {
   // verify that bytes 3 and 4 (indices 2 and 3) of the content array describe the length
 
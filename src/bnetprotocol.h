@@ -30,6 +30,7 @@
 #include <string>
 #include <vector>
 
+class CByteSpan;
 class CIncomingGameHost;
 class CIncomingChatEvent;
 
@@ -125,19 +126,19 @@ public:
 
   // receive functions
 
-  bool RECEIVE_SID_NULL(const std::vector<uint8_t>& data);
-  CIncomingGameHost* RECEIVE_SID_GETADVLISTEX(const std::vector<uint8_t>& data);
-  bool RECEIVE_SID_ENTERCHAT(const std::vector<uint8_t>& data);
-  CIncomingChatEvent* RECEIVE_SID_CHATEVENT(const std::vector<uint8_t>& data);
-  bool RECEIVE_SID_CHECKAD(const std::vector<uint8_t>& data);
-  bool RECEIVE_SID_STARTADVEX3(const std::vector<uint8_t>& data);
-  std::vector<uint8_t> RECEIVE_SID_PING(const std::vector<uint8_t>& data);
-  bool RECEIVE_SID_AUTH_INFO(const std::vector<uint8_t>& data);
-  bool RECEIVE_SID_AUTH_CHECK(const std::vector<uint8_t>& data);
-  bool RECEIVE_SID_AUTH_ACCOUNTLOGON(const std::vector<uint8_t>& data);
-  bool RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF(const std::vector<uint8_t>& data);
-  std::vector<std::string> RECEIVE_SID_FRIENDLIST(const std::vector<uint8_t>& data);
-  std::vector<std::string> RECEIVE_SID_CLANMEMBERLIST(const std::vector<uint8_t>& data);
+  bool RECEIVE_SID_NULL(const CByteSpan& data);
+  CIncomingGameHost* RECEIVE_SID_GETADVLISTEX(const CByteSpan& data);
+  bool RECEIVE_SID_ENTERCHAT(const CByteSpan& data);
+  CIncomingChatEvent* RECEIVE_SID_CHATEVENT(const CByteSpan& data);
+  bool RECEIVE_SID_CHECKAD(const CByteSpan& data);
+  bool RECEIVE_SID_STARTADVEX3(const CByteSpan& data);
+  std::vector<uint8_t> RECEIVE_SID_PING(const CByteSpan& data);
+  bool RECEIVE_SID_AUTH_INFO(const CByteSpan& data);
+  bool RECEIVE_SID_AUTH_CHECK(const CByteSpan& data);
+  bool RECEIVE_SID_AUTH_ACCOUNTLOGON(const CByteSpan& data);
+  bool RECEIVE_SID_AUTH_ACCOUNTLOGONPROOF(const CByteSpan& data);
+  std::vector<std::string> RECEIVE_SID_FRIENDLIST(const CByteSpan& data);
+  std::vector<std::string> RECEIVE_SID_CLANMEMBERLIST(const CByteSpan& data);
 
   // send functions
 
@@ -164,7 +165,7 @@ public:
   // other functions
 
 private:
-  bool ValidateLength(const std::vector<uint8_t>& content);
+  bool ValidateLength(const CByteSpan& content);
 };
 
 //
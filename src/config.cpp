@@ -44,7 +44,7 @@ void CConfig::Read(const string& file)
   in.open(file.c_str());
 
   if (in.fail())
-    Print("[CONFIG] warning - unable to read file [" + file + "]");
+    Print("[CONFIG] warning - unable to read file [" + file + "]", LOG_WARNING);
   else
   {
     Print("[CONFIG] loading file [" + file + "]");
@@ -0,0 +1,110 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+#ifndef AURA_CPU_H_
+#define AURA_CPU_H_
+
+#include <cstdint>
+
+// runtime detection of the x86 instructions the hashing code can use (see CCRC32, CSHA1 and CMap :: XORRotateLeft)
+// the accelerated functions are compiled for their instruction sets with AURA_TARGET so the rest of the build doesn't need any -m flags
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define AURA_X86
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AURA_TARGET(features)
+#else
+#include <cpuid.h>
+#define AURA_TARGET(features) __attribute__((target(features)))
+#endif
+
+inline void GetCPUID(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#ifdef _MSC_VER
+  int Regs[4];
+  __cpuid(Regs, 0);
+
+  if (leaf > static_cast<uint32_t>(Regs[0]))
+    Regs[0] = Regs[1] = Regs[2] = Regs[3] = 0;
+  else
+    __cpuidex(Regs, static_cast<int>(leaf), static_cast<int>(subleaf));
+
+  for (uint32_t i = 0; i < 4; ++i)
+    regs[i] = static_cast<uint32_t>(Regs[i]);
+#else
+  regs[0] = regs[1] = regs[2] = regs[3] = 0;
+
+  if (leaf <= __get_cpuid_max(0, nullptr))
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// PCLMULQDQ and SSE4.1 for folding CRC32
+
+inline bool CPUHasCLMUL()
+{
+  uint32_t Regs[4];
+  GetCPUID(1, 0, Regs);
+  return (Regs[2] & (1 << 1)) && (Regs[2] & (1 << 19));
+}
+
+// the SHA extensions plus SSSE3 and SSE4.1 for SHA-1
+
+inline bool CPUHasSHA()
+{
+  uint32_t Regs[4];
+  GetCPUID(1, 0, Regs);
+
+  if (!(Regs[2] & (1 << 9)) || !(Regs[2] & (1 << 19)))
+    return false;
+
+  GetCPUID(7, 0, Regs);
+  return (Regs[1] & (1 << 29)) != 0;
+}
+
+// AVX2 for the map script checksum, the OS also has to save the YMM registers on context switches (checked with XGETBV)
+
+inline bool CPUHasAVX2()
+{
+  uint32_t Regs[4];
+  GetCPUID(1, 0, Regs);
+
+  if (!(Regs[2] & (1 << 27)) || !(Regs[2] & (1 << 28)))
+    return false;
+
+#ifdef _MSC_VER
+  const uint64_t XCR0 = _xgetbv(0);
+#else
+  uint32_t XCR0Low, XCR0High;
+  __asm__ __volatile__("xgetbv" : "=a"(XCR0Low), "=d"(XCR0High) : "c"(0));
+  const uint64_t XCR0 = (static_cast<uint64_t>(XCR0High) << 32) | XCR0Low;
+#endif
+
+  if ((XCR0 & 6) != 6)
+    return false;
+
+  GetCPUID(7, 0, Regs);
+  return (Regs[1] & (1 << 5)) != 0;
+}
+#endif
+
+#endif // AURA_CPU_H_
@@ -3,6 +3,13 @@
 // Copyright (c) 2011-2015 Stephan Brumme. All rights reserved.
 
 #include "crc32.h"
+#include "cpu.h"
+
+#ifdef AURA_X86
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#endif
 
 // define endianess and some integer data types
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -21,6 +28,72 @@
 
 constexpr std::size_t Polynomial = 0x04C11DB7;
 
+#ifdef AURA_X86
+// folds 16 byte blocks together with carryless multiplications and reduces the result to 32 bits at the end, see
+// "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Gopal, Ozturk et al., Intel 2009)
+// the constants are the powers of x modulo the bit reflected polynomial given at the end of the paper
+// crc is the running value (already inverted) and length has to be a multiple of 16 and at least 64
+
+AURA_TARGET("pclmul,sse4.1") static uint32_t FoldCRC(const uint8_t* data, std::size_t length, uint32_t crc)
+{
+  const __m128i K1K2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+  const __m128i K3K4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+  const __m128i K5   = _mm_set_epi64x(0, 0x0163CD6124);
+  const __m128i Poly = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+  const __m128i Mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  __m128i x1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), _mm_cvtsi32_si128(static_cast<int>(crc)));
+  __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + 1);
+  __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + 2);
+  __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + 3);
+
+  data += 64;
+  length -= 64;
+
+  // fold 64 bytes at a time into four accumulators
+
+  while (length >= 64)
+  {
+    const __m128i* Block = reinterpret_cast<const __m128i*>(data);
+
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, K1K2, 0x00), _mm_clmulepi64_si128(x1, K1K2, 0x11)), _mm_loadu_si128(Block));
+    x2 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x2, K1K2, 0x00), _mm_clmulepi64_si128(x2, K1K2, 0x11)), _mm_loadu_si128(Block + 1));
+    x3 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x3, K1K2, 0x00), _mm_clmulepi64_si128(x3, K1K2, 0x11)), _mm_loadu_si128(Block + 2));
+    x4 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x4, K1K2, 0x00), _mm_clmulepi64_si128(x4, K1K2, 0x11)), _mm_loadu_si128(Block + 3));
+
+    data += 64;
+    length -= 64;
+  }
+
+  // fold the accumulators into one and then fold in the remaining 16 byte blocks
+
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, K3K4, 0x00), _mm_clmulepi64_si128(x1, K3K4, 0x11)), x2);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, K3K4, 0x00), _mm_clmulepi64_si128(x1, K3K4, 0x11)), x3);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, K3K4, 0x00), _mm_clmulepi64_si128(x1, K3K4, 0x11)), x4);
+
+  while (length >= 16)
+  {
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, K3K4, 0x00), _mm_clmulepi64_si128(x1, K3K4, 0x11)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+
+    data += 16;
+    length -= 16;
+  }
+
+  // 128 bits to 64 bits
+
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), _mm_clmulepi64_si128(x1, K3K4, 0x10));
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, Mask), K5, 0x00), _mm_srli_si128(x1, 4));
+
+  // Barrett reduction to 32 bits
+
+  __m128i x5 = _mm_clmulepi64_si128(_mm_and_si128(x1, Mask), Poly, 0x10);
+  x5         = _mm_clmulepi64_si128(_mm_and_si128(x5, Mask), Poly, 0x00);
+  x1         = _mm_xor_si128(x1, x5);
+
+  return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+}
+#endif
+
 constexpr static inline uint32_t swap(const uint32_t i)
 {
 #if !defined(__APPLE__) && (defined(__GNUC__) || defined(__clang__))
@@ -33,8 +106,15 @@ constexpr static inline uint32_t swap(const uint32_t i)
 #endif
 }
 
-void CCRC32::Initialize()
+void CCRC32::Initialize(bool accelerate)
 {
+#ifdef AURA_X86
+  m_CLMUL = accelerate && CPUHasCLMUL();
+#else
+  (void)accelerate;
+  m_CLMUL = false;
+#endif
+
   for (uint32_t i = 0; i <= 0xFF; ++i)
   {
     LUT[0][i] = Reflect(i, 8) << 24;
@@ -67,7 +147,20 @@ uint32_t CCRC32::Reflect(uint32_t reflect, const uint8_t val) const
 
 uint32_t CCRC32::CalculateCRC(const uint8_t* data, std::size_t length, uint32_t previous_crc) const
 {
-  uint32_t        crc     = ~previous_crc; // same as previousCrc32 ^ 0xFFFFFFFF
+  uint32_t crc = ~previous_crc; // same as previousCrc32 ^ 0xFFFFFFFF
+
+#ifdef AURA_X86
+  // most of a large buffer is folded with PCLMULQDQ if the CPU has it, the tables take care of the rest
+
+  if (m_CLMUL && length >= 64)
+  {
+    const std::size_t Folded = length & ~static_cast<std::size_t>(15);
+    crc                      = FoldCRC(data, Folded, crc);
+    data += Folded;
+    length -= Folded;
+  }
+#endif
+
   const uint32_t* current = reinterpret_cast<const uint32_t*>(data);
 
   // enabling optimization (at least -O2) automatically unrolls the inner for-loop
@@ -10,10 +10,11 @@ class CCRC32
 {
 private:
   uint32_t LUT[MaxSlices][256];
+  bool     m_CLMUL; // fold with PCLMULQDQ (see CPUHasCLMUL)
   uint32_t Reflect(uint32_t ulReflect, const uint8_t cChar) const;
 
 public:
-  void     Initialize();
+  void     Initialize(bool accelerate = true); // accelerate = false always uses the tables (for testing)
   uint32_t CalculateCRC(const uint8_t* data, std::size_t length, uint32_t previous_crc = 0) const;
 };
 
@@ -30,6 +30,9 @@ CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
 #else
 #include <dirent.h>
 #include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
 using namespace std;
@@ -115,7 +118,7 @@ string FileRead(const string& file, uint32_t start, uint32_t length)
 
   if (IS.fail())
   {
-    Print("[UTIL] warning - unable to read file part [" + file + "]");
+    Print("[UTIL] warning - unable to read file part [" + file + "]", LOG_WARNING);
     return string();
   }
 
@@ -149,7 +152,7 @@ string FileRead(const string& file)
 
   if (IS.fail())
   {
-    Print("[UTIL] warning - unable to read file [" + file + "]");
+    Print("[UTIL] warning - unable to read file [" + file + "]", LOG_WARNING);
     return string();
   }
 
@@ -180,7 +183,7 @@ bool FileWrite(const string& file, uint8_t* data, uint32_t length)
 
   if (OS.fail())
   {
-    Print("[UTIL] warning - unable to write file [" + file + "]");
+    Print("[UTIL] warning - unable to write file [" + file + "]", LOG_WARNING);
     return false;
   }
 
@@ -190,3 +193,151 @@ bool FileWrite(const string& file, uint8_t* data, uint32_t length)
   OS.close();
   return true;
 }
+
+bool FileStat(const string& file, uint64_t* size, int64_t* modified)
+{
+  struct stat Stat;
+
+  if (stat(file.c_str(), &Stat) != 0)
+    return false;
+
+  *size     = static_cast<uint64_t>(Stat.st_size);
+  *modified = static_cast<int64_t>(Stat.st_mtime);
+  return true;
+}
+
+//
+// CMappedFile
+//
+
+CMappedFile::CMappedFile()
+  : m_Data(nullptr),
+    m_Size(0)
+#ifdef WIN32
+    ,
+    m_File(INVALID_HANDLE_VALUE),
+    m_Mapping(nullptr)
+#else
+    ,
+    m_FD(-1)
+#endif
+{
+}
+
+CMappedFile::CMappedFile(const string& file)
+  : CMappedFile()
+{
+  Open(file);
+}
+
+CMappedFile::~CMappedFile()
+{
+  Close();
+}
+
+bool CMappedFile::Open(const string& file)
+{
+  Close();
+
+#ifdef WIN32
+  m_File = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if (m_File == INVALID_HANDLE_VALUE)
+  {
+    Print("[UTIL] warning - unable to map file [" + file + "]", LOG_WARNING);
+    return false;
+  }
+
+  LARGE_INTEGER FileSize;
+
+  if (!GetFileSizeEx(m_File, &FileSize) || FileSize.QuadPart > 0xFFFFFFFF)
+  {
+    Print("[UTIL] warning - unable to map file [" + file + "]", LOG_WARNING);
+    Close();
+    return false;
+  }
+
+  // an empty file can't be mapped but it's not an error either
+
+  if (FileSize.QuadPart == 0)
+    return true;
+
+  m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  m_Data    = m_Mapping ? static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+  if (!m_Data)
+  {
+    Print("[UTIL] warning - unable to map file [" + file + "]", LOG_WARNING);
+    Close();
+    return false;
+  }
+
+  m_Size = static_cast<uint32_t>(FileSize.QuadPart);
+#else
+  m_FD = open(file.c_str(), O_RDONLY);
+
+  if (m_FD == -1)
+  {
+    Print("[UTIL] warning - unable to map file [" + file + "]", LOG_WARNING);
+    return false;
+  }
+
+  struct stat FileStat;
+
+  if (fstat(m_FD, &FileStat) == -1 || FileStat.st_size > 0xFFFFFFFF)
+  {
+    Print("[UTIL] warning - unable to map file [" + file + "]", LOG_WARNING);
+    Close();
+    return false;
+  }
+
+  // an empty file can't be mapped but it's not an error either
+
+  if (FileStat.st_size == 0)
+    return true;
+
+  // the descriptor stays open so the file can also be sent with sendfile (see CMapServer)
+
+  void* Data = mmap(nullptr, FileStat.st_size, PROT_READ, MAP_SHARED, m_FD, 0);
+
+  if (Data == MAP_FAILED)
+  {
+    Print("[UTIL] warning - unable to map file [" + file + "]", LOG_WARNING);
+    Close();
+    return false;
+  }
+
+  m_Data = static_cast<const uint8_t*>(Data);
+  m_Size = static_cast<uint32_t>(FileStat.st_size);
+#endif
+
+  return true;
+}
+
+void CMappedFile::Close()
+{
+#ifdef WIN32
+  if (m_Data)
+    UnmapViewOfFile(m_Data);
+
+  if (m_Mapping)
+    CloseHandle(m_Mapping);
+
+  if (m_File != INVALID_HANDLE_VALUE)
+    CloseHandle(m_File);
+
+  m_Mapping = nullptr;
+  m_File    = INVALID_HANDLE_VALUE;
+#else
+  if (m_Data)
+    munmap(const_cast<uint8_t*>(m_Data), m_Size);
+
+  if (m_FD != -1)
+    close(m_FD);
+
+  m_FD = -1;
+#endif
+
+  m_Data = nullptr;
+  m_Size = 0;
+}
@@ -34,5 +34,43 @@ std::vector<std::string> FilesMatch(const std::string& path, const std::string&
 std::string FileRead(const std::string& file, uint32_t start, uint32_t length);
 std::string FileRead(const std::string& file);
 bool FileWrite(const std::string& file, uint8_t* data, uint32_t length);
+bool FileStat(const std::string& file, uint64_t* size, int64_t* modified);
+
+//
+// CMappedFile
+//
+
+// a whole file mapped read-only into memory, the pages are loaded on demand and shared with every other process mapping the same file
+// the file must not be truncated while it's mapped (reading past the new end crashes), replace files by writing a new one and renaming it over the old one
+
+class CMappedFile final
+{
+private:
+  const uint8_t* m_Data;
+  uint32_t       m_Size;
+#ifdef WIN32
+  void* m_File;    // HANDLE
+  void* m_Mapping; // HANDLE
+#else
+  int m_FD; // kept open for sendfile
+#endif
+
+public:
+  CMappedFile();
+  explicit CMappedFile(const std::string& file);
+  ~CMappedFile();
+  CMappedFile(CMappedFile&) = delete;
+  CMappedFile& operator=(CMappedFile&) = delete;
+
+  inline const uint8_t* data() const { return m_Data; }
+  inline uint32_t       size() const { return m_Size; }
+  inline bool           empty() const { return m_Size == 0; }
+#ifndef WIN32
+  inline int            GetFD() const { return m_FD; }
+#endif
+
+  bool Open(const std::string& file);
+  void Close();
+};
 
 #endif // AURA_FILEUTIL_H_
@@ -31,6 +31,8 @@
 #include "stats.h"
 #include "irc.h"
 #include "hash.h"
+#include "mapserver.h"
+#include "iptocountry.h"
 
 #include <ctime>
 #include <cmath>
@@ -49,6 +51,9 @@ CGame::CGame(CAura* nAura, CMap* nMap, uint16_t nHostPort, uint8_t nGameState, s
     m_Stats(nullptr),
     m_Protocol(new CGameProtocol(nAura)),
     m_Slots(nMap->GetSlots()),
+    m_Worker(nullptr),
+    m_TimerWheel(CTimerWheel::GetDefault()),
+    m_ActionTimer([this]() { EventActionTimer(); }),
     m_Map(new CMap(*nMap)),
     m_GameName(nGameName),
     m_LastGameName(nGameName),
@@ -79,17 +84,24 @@ CGame::CGame(CAura* nAura, CMap* nMap, uint16_t nHostPort, uint8_t nGameState, s
     m_LastPlayerLeaveTicks(0),
     m_LastLagScreenResetTime(0),
     m_RandomSeed(GetTicks()),
+    m_BytesIn(0),
+    m_BytesOut(0),
+    m_PacketsIn(0),
+    m_PacketsOut(0),
     m_HostCounter(nAura->m_HostCounter++),
     m_EntryKey(rand()),
     m_Latency(nAura->m_Latency),
     m_SyncLimit(nAura->m_SyncLimit),
+    m_VoteKickPercentage(nAura->m_VoteKickPercentage),
     m_SyncCounter(0),
     m_DownloadCounter(0),
+    m_DownloadRotation(0),
     m_CountDownCounter(0),
     m_StartPlayers(0),
     m_HostPort(nHostPort),
     m_GameState(nGameState),
     m_VirtualHostPID(255),
+    m_CommandTrigger(static_cast<char>(nAura->m_CommandTrigger)),
     m_Exiting(false),
     m_Saving(false),
     m_SlotInfoChanged(false),
@@ -101,8 +113,13 @@ CGame::CGame(CAura* nAura, CMap* nMap, uint16_t nHostPort, uint8_t nGameState, s
     m_GameLoading(false),
     m_GameLoaded(false),
     m_Lagging(false),
-    m_Desynced(false)
+    m_Desynced(false),
+    m_LCPings(nAura->m_LCPings)
 {
+  // the game is moved to a worker thread when it starts and can't look at the battle.net connections from there, remember their servers now
+
+  for (auto& bnet : m_Aura->m_BNETs)
+    m_Realms[static_cast<uint8_t>(bnet->GetHostCounterID())] = bnet->GetServer();
 
   // wait time of 1 minute  = 0 empty actions required
   // wait time of 2 minutes = 1 empty action required...
@@ -151,12 +168,6 @@ CGame::~CGame()
   if (m_Stats)
     m_Stats->Save(m_Aura, m_Aura->m_DB);
 
-  while (!m_Actions.empty())
-  {
-    delete m_Actions.front();
-    m_Actions.pop();
-  }
-
   for (auto& player : m_DBGamePlayers)
     delete player;
 
@@ -166,24 +177,6 @@ CGame::~CGame()
   delete m_Stats;
 }
 
-int64_t CGame::GetNextTimedActionTicks() const
-{
-  // return the number of ticks (ms) until the next "timed action", which for our purposes is the next game update
-  // the main Aura++ loop will make sure the next loop update happens at or before this value
-  // note: there's no reason this function couldn't take into account the game's other timers too but they're far less critical
-  // warning: this function must take into account when actions are not being sent (e.g. during loading or lagging)
-
-  if (!m_GameLoaded || m_Lagging)
-    return 50;
-
-  const int64_t TicksSinceLastUpdate = GetTicks() - m_LastActionSentTicks;
-
-  if (TicksSinceLastUpdate > m_Latency - m_LastActionLateBy)
-    return 0;
-  else
-    return m_Latency - m_LastActionLateBy - TicksSinceLastUpdate;
-}
-
 uint32_t CGame::GetSlotsOccupied() const
 {
   uint32_t NumSlotsOccupied = 0;
@@ -228,6 +221,16 @@ uint32_t CGame::GetNumHumanPlayers() const
   return NumHumanPlayers;
 }
 
+uint32_t CGame::GetGProxyBufferSize() const
+{
+  uint32_t Size = 0;
+
+  for (const auto& player : m_Players)
+    Size += player->GetGProxyBufferSize();
+
+  return Size;
+}
+
 string CGame::GetDescription() const
 {
   string Description = m_GameName + " : " + m_OwnerName + " : " + to_string(GetNumHumanPlayers()) + "/" + to_string(m_GameLoading || m_GameLoaded ? m_StartPlayers : m_Slots.size());
@@ -280,6 +283,18 @@ string CGame::GetObservers() const
   return Observers;
 }
 
+vector<string> CGame::GetPerfReport() const
+{
+  return vector<string>{
+    "update: " + m_PerfUpdate.GetSummary("us"),
+    "players: " + m_PerfPlayers.GetSummary("us"),
+    "lag check: " + m_PerfLagCheck.GetSummary("us"),
+    "actions: " + m_PerfActions.GetSummary("us"),
+    "flush: " + m_PerfUpdatePost.GetSummary("us"),
+    "actions late by: " + m_PerfActionLateBy.GetSummary("ms"),
+    "in: " + to_string(m_PacketsIn) + " packets, " + to_string(m_BytesIn) + " bytes, out: " + to_string(m_PacketsOut) + " packets, " + to_string(m_BytesOut) + " bytes"};
+}
+
 uint32_t CGame::SetFD(void* fd, void* send_fd, int32_t* nfds)
 {
   uint32_t NumFDs = 0;
@@ -308,8 +323,39 @@ uint32_t CGame::SetFD(void* fd, void* send_fd, int32_t* nfds)
   return NumFDs;
 }
 
+void CGame::SetPoller(CSocketPoller* poller)
+{
+  // move all our sockets to another thread's poller (or unregister them if poller is nullptr)
+
+  if (m_Socket)
+    m_Socket->Register(poller);
+
+  for (auto& player : m_Players)
+    player->GetSocket()->Register(poller);
+
+  for (auto& potential : m_Potentials)
+  {
+    if (potential->GetSocket())
+      potential->GetSocket()->Register(poller);
+  }
+}
+
+void CGame::SetTimerWheel(CTimerWheel* wheel)
+{
+  // move our timers to another thread's wheel (or cancel them if wheel is nullptr)
+
+  m_TimerWheel = wheel;
+
+  if (m_TimerWheel)
+    ScheduleActions();
+  else
+    m_ActionTimer.Cancel();
+}
+
 bool CGame::Update(void* fd, void* send_fd)
 {
+  CHistogramTimer UpdateTimer(&m_PerfUpdate);
+
   const int64_t Time = GetTime(), Ticks = GetTicks();
 
   // ping every 5 seconds
@@ -348,7 +394,9 @@ bool CGame::Update(void* fd, void* send_fd)
       // note: the PrivateGame flag is not set when broadcasting to LAN (as you might expect)
       // note: we do not use m_Map->GetMapGameType because none of the filters are set when broadcasting to LAN (also as you might expect)
 
-      m_Aura->m_UDPSocket->Broadcast(6112, m_Protocol->SEND_W3GS_GAMEINFO(m_Aura->m_LANWar3Version, CreateByteArray(static_cast<uint32_t>(MAPGAMETYPE_UNKNOWN0), false), m_Map->GetMapGameFlags(), m_Map->GetMapWidth(), m_Map->GetMapHeight(), m_GameName, "Clan 007", 0, m_Map->GetMapPath(), m_Map->GetMapCRC(), MAX_SLOTS, MAX_SLOTS, m_HostPort, m_HostCounter & 0x0FFFFFFF, m_EntryKey));
+      CAura*                     Aura     = m_Aura;
+      const std::vector<uint8_t> GameInfo = m_Protocol->SEND_W3GS_GAMEINFO(m_Aura->m_LANWar3Version, CreateByteArray(static_cast<uint32_t>(MAPGAMETYPE_UNKNOWN0), false), m_Map->GetMapGameFlags(), m_Map->GetMapWidth(), m_Map->GetMapHeight(), m_GameName, "Clan 007", 0, m_Map->GetMapPath(), m_Map->GetMapCRC(), MAX_SLOTS, MAX_SLOTS, m_HostPort, m_HostCounter & 0x0FFFFFFF, m_EntryKey);
+      RunOnMainThread([Aura, GameInfo]() { Aura->m_UDPSocket->Broadcast(6112, GameInfo); });
     }
 
     m_LastPingTime = Time;
@@ -356,6 +404,8 @@ bool CGame::Update(void* fd, void* send_fd)
 
   // update players
 
+  int64_t PhaseStart = GetMicroTicks();
+
   for (auto i = begin(m_Players); i != end(m_Players);)
   {
     if ((*i)->Update(fd))
@@ -384,11 +434,15 @@ bool CGame::Update(void* fd, void* send_fd)
       ++i;
   }
 
+  m_PerfPlayers.Record(GetMicroTicks() - PhaseStart);
+
   // keep track of the largest sync counter (the number of keepalive packets received by each player)
   // if anyone falls behind by more than m_SyncLimit keepalives we start the lag screen
 
   if (m_GameLoaded)
   {
+    PhaseStart = GetMicroTicks();
+
     // check if anyone has started lagging
     // we consider a player to have started lagging if they're more than m_SyncLimit keepalives behind
 
@@ -475,10 +529,10 @@ bool CGame::Update(void* fd, void* send_fd)
             // empty actions are used to extend the time a player can use when reconnecting
 
             for (uint8_t j = 0; j < m_GProxyEmptyActions; ++j)
-              Send(_i, m_Protocol->SEND_W3GS_INCOMING_ACTION(queue<CIncomingAction*>(), 0));
+              Send(_i, m_Protocol->SEND_W3GS_INCOMING_ACTION(CByteSpan(), 0));
           }
 
-          Send(_i, m_Protocol->SEND_W3GS_INCOMING_ACTION(queue<CIncomingAction*>(), 0));
+          Send(_i, m_Protocol->SEND_W3GS_INCOMING_ACTION(CByteSpan(), 0));
 
           // start the lag screen
 
@@ -525,18 +579,16 @@ bool CGame::Update(void* fd, void* send_fd)
 
       m_LastActionSentTicks = Ticks;
 
+      if (!m_Lagging)
+        ScheduleActions();
+
       // keep track of the last lag screen time so we can avoid timing out players
 
       m_LastLagScreenTime = Time;
     }
-  }
-
-  // send actions every m_Latency milliseconds
-  // actions are at the heart of every Warcraft 3 game but luckily we don't need to know their contents to relay them
-  // we queue player actions in EventPlayerAction then just resend them in batches to all players here
 
-  if (m_GameLoaded && !m_Lagging && Ticks - m_LastActionSentTicks >= m_Latency - m_LastActionLateBy)
-    SendAllActions();
+    m_PerfLagCheck.Record(GetMicroTicks() - PhaseStart);
+  }
 
   // end the game if there aren't any players left
 
@@ -568,6 +620,7 @@ bool CGame::Update(void* fd, void* send_fd)
       m_GameLoading         = false;
       m_GameLoaded          = true;
       EventGameLoaded();
+      ScheduleActions();
     }
   }
 
@@ -613,13 +666,17 @@ bool CGame::Update(void* fd, void* send_fd)
   {
     // send a game refresh packet to each battle.net connection
 
-    for (auto& bnet : m_Aura->m_BNETs)
-    {
-      // don't queue a game refresh message if the queue contains more than 1 packet because they're very low priority
+    CAura* Aura = m_Aura;
 
-      if (bnet->GetOutPacketsQueued() <= 1)
-        bnet->QueueGameRefresh(m_GameState, m_GameName, m_Map, m_HostCounter);
-    }
+    RunOnMainThread([Aura, GameState = m_GameState, GameName = m_GameName, Map = m_Map, HostCounter = m_HostCounter]() {
+      for (auto& bnet : Aura->m_BNETs)
+      {
+        // don't queue a game refresh message if the queue contains more than 1 packet because they're very low priority
+
+        if (bnet->GetOutPacketsQueued() <= 1)
+          bnet->QueueGameRefresh(GameState, GameName, Map, HostCounter);
+      }
+    });
 
     m_LastRefreshTime = Time;
   }
@@ -640,56 +697,7 @@ bool CGame::Update(void* fd, void* send_fd)
 
   if (!m_GameLoading && Ticks - m_LastDownloadTicks >= 100)
   {
-    uint32_t Downloaders = 0;
-
-    for (auto& player : m_Players)
-    {
-      if (player->GetDownloadStarted() && !player->GetDownloadFinished())
-      {
-        ++Downloaders;
-
-        if (m_Aura->m_MaxDownloaders > 0 && Downloaders > m_Aura->m_MaxDownloaders)
-          break;
-
-        // send up to 100 pieces of the map at once so that the download goes faster
-        // if we wait for each MAPPART packet to be acknowledged by the client it'll take a long time to download
-        // this is because we would have to wait the round trip time (the ping time) between sending every 1442 bytes of map data
-        // doing it this way allows us to send at least 140 KB in each round trip int32_terval which is much more reasonable
-        // the theoretical throughput is [140 KB * 1000 / ping] in KB/sec so someone with 100 ping (round trip ping, not LC ping) could download at 1400 KB/sec
-        // note: this creates a queue of map data which clogs up the connection when the client is on a slower connection (e.g. dialup)
-        // in this case any changes to the lobby are delayed by the amount of time it takes to send the queued data (i.e. 140 KB, which could be 30 seconds or more)
-        // for example, players joining and leaving, slot changes, chat messages would all appear to happen much later for the low bandwidth player
-        // note: the throughput is also limited by the number of times this code is executed each second
-        // e.g. if we send the maximum amount (140 KB) 10 times per second the theoretical throughput is 1400 KB/sec
-        // therefore the maximum throughput is 1400 KB/sec regardless of ping and this value slowly diminishes as the player's ping increases
-        // in addition to this, the throughput is limited by the configuration value bot_maxdownloadspeed
-        // in summary: the actual throughput is MIN( 140 * 1000 / ping, 1400, bot_maxdownloadspeed ) in KB/sec assuming only one player is downloading the map
-
-        const uint32_t MapSize = ByteArrayToUInt32(m_Map->GetMapSize(), false);
-
-        while (player->GetLastMapPartSent() < player->GetLastMapPartAcked() + 1442 * 100 && player->GetLastMapPartSent() < MapSize)
-        {
-          if (player->GetLastMapPartSent() == 0)
-          {
-            // overwrite the "started download ticks" since this is the first time we've sent any map data to the player
-            // prior to this we've only determined if the player needs to download the map but it's possible we could have delayed sending any data due to download limits
-
-            player->SetStartedDownloadingTicks(Ticks);
-          }
-
-          // limit the download speed if we're sending too much data
-          // the download counter is the # of map bytes downloaded in the last second (it's reset once per second)
-
-          if (m_Aura->m_MaxDownloadSpeed > 0 && m_DownloadCounter > m_Aura->m_MaxDownloadSpeed * 1024)
-            break;
-
-          Send(player, m_Protocol->SEND_W3GS_MAPPART(GetHostPID(), player->GetPID(), player->GetLastMapPartSent(), m_Map->GetMapData()));
-          player->SetLastMapPartSent(player->GetLastMapPartSent() + 1442);
-          m_DownloadCounter += 1442;
-        }
-      }
-    }
-
+    UpdateMapDownloads();
     m_LastDownloadTicks = Ticks;
   }
 
@@ -783,8 +791,86 @@ bool CGame::Update(void* fd, void* send_fd)
   return m_Exiting;
 }
 
+void CGame::UpdateMapDownloads()
+{
+  // we don't wait for each MAPPART packet to be acknowledged before sending the next one, that would take a round trip per 1442 bytes
+  // instead each downloader has a window of map data they may have unacknowledged, the throughput is about [window * 1000 / ping] bytes/sec
+  // the window starts small and grows by the amount acknowledged whenever an acknowledgement arrives while the player is keeping up (see EventPlayerMapSize)
+  // if the map data we queued last time is still sitting in our send queue the player's connection can't keep up so the window is halved
+  // this keeps fast players fast without queueing so much map data for slow players that their chat and slot changes are delayed behind it
+
+  const int64_t  Ticks   = GetTicks();
+  const uint32_t MapSize = ByteArrayToUInt32(m_Map->GetMapSize(), false);
+  const uint32_t Backlog = MAPWINDOW_BACKLOG * MAP_PART_SIZE;
+
+  vector<CGamePlayer*> Downloaders;
+  uint32_t             NumDownloaders = 0;
+
+  for (auto& player : m_Players)
+  {
+    if (!player->GetDownloadStarted() || player->GetDownloadFinished())
+      continue;
+
+    ++NumDownloaders;
+
+    if (m_Aura->m_MaxDownloaders > 0 && NumDownloaders > m_Aura->m_MaxDownloaders)
+      break;
+
+    if (player->GetSocket()->GetSendQueueSize() > Backlog)
+    {
+      player->SetMapWindow(max<uint32_t>(player->GetMapWindow() / 2, MAPWINDOW_MIN * MAP_PART_SIZE));
+      continue;
+    }
+
+    Downloaders.push_back(player);
+  }
+
+  if (Downloaders.empty())
+    return;
+
+  // hand out one part at a time to each downloader in turn so they get an even share of bot_maxdownloadspeed
+  // start with a different player each time so the same one isn't always first in line when the limit is hit
+  // the download counter is the # of map bytes downloaded in the last second (it's reset once per second)
+
+  const uint32_t First = m_DownloadRotation++ % Downloaders.size();
+  bool           Sent  = true;
+
+  while (Sent)
+  {
+    Sent = false;
+
+    for (uint32_t i = 0; i < Downloaders.size(); ++i)
+    {
+      if (m_Aura->m_MaxDownloadSpeed > 0 && m_DownloadCounter > m_Aura->m_MaxDownloadSpeed * 1024)
+        return;
+
+      CGamePlayer*   Player   = Downloaders[(First + i) % Downloaders.size()];
+      const uint32_t PartSent = Player->GetLastMapPartSent();
+
+      if (PartSent >= MapSize || PartSent >= Player->GetLastMapPartAcked() + Player->GetMapWindow())
+        continue;
+
+      if (PartSent == 0)
+      {
+        // overwrite the "started download ticks" since this is the first time we've sent any map data to the player
+        // prior to this we've only determined if the player needs to download the map but it's possible we could have delayed sending any data due to download limits
+
+        Player->SetStartedDownloadingTicks(Ticks);
+      }
+
+      Send(Player, m_Protocol->SEND_W3GS_MAPPART(GetHostPID(), Player->GetPID(), PartSent, m_Map->GetMapData(), m_Map->GetMapPartCRC(PartSent)));
+      Player->SetLastMapPartSent(PartSent + MAP_PART_SIZE);
+      m_DownloadCounter += MAP_PART_SIZE;
+      m_Aura->m_MapBytesSent += MAP_PART_SIZE;
+      Sent = true;
+    }
+  }
+}
+
 void CGame::UpdatePost(void* send_fd)
 {
+  CHistogramTimer UpdatePostTimer(&m_PerfUpdatePost);
+
   // we need to manually call DoSend on each player now because CGamePlayer :: Update doesn't do it
   // this is in case player 2 generates a packet for player 1 during the update but it doesn't get sent because player 1 already finished updating
   // in reality since we're queueing actions it might not make a big difference but oh well
@@ -812,16 +898,30 @@ void CGame::Send(uint8_t PID, const std::vector<uint8_t>& data)
 
 void CGame::Send(const std::vector<uint8_t>& PIDs, const std::vector<uint8_t>& data)
 {
+  const CSharedBytes Packet = make_shared<const std::vector<uint8_t>>(data);
+
   for (auto& PID : PIDs)
-    Send(PID, data);
+  {
+    CGamePlayer* Player = GetPlayerFromPID(PID);
+
+    if (Player)
+      Player->Send(Packet);
+  }
 }
 
-void CGame::SendAll(const std::vector<uint8_t>& data)
+void CGame::SendAll(const CSharedBytes& data)
 {
   for (auto& player : m_Players)
     player->Send(data);
 }
 
+void CGame::SendAll(std::vector<uint8_t> data)
+{
+  // build the packet once and let every player's send queue (and GProxy++ buffer) share it
+
+  SendAll(make_shared<const std::vector<uint8_t>>(std::move(data)));
+}
+
 void CGame::SendChat(uint8_t fromPID, CGamePlayer* player, const string& message)
 {
   // send a private message to one player - it'll be marked [Private] in Warcraft 3
@@ -931,6 +1031,8 @@ void CGame::SendFakePlayerInfo(CGamePlayer* player)
 
 void CGame::SendAllActions()
 {
+  CHistogramTimer ActionsTimer(&m_PerfActions);
+
   bool UsingGProxy = false;
 
   for (auto& player : m_Players)
@@ -950,12 +1052,14 @@ void CGame::SendAllActions()
     // GProxy++ will insert these itself so we don't need to send them to GProxy++ players
     // empty actions are used to extend the time a player can use when reconnecting
 
+    const CSharedBytes EmptyActions = make_shared<const std::vector<uint8_t>>(m_Protocol->SEND_W3GS_INCOMING_ACTION(CByteSpan(), 0));
+
     for (auto& player : m_Players)
     {
       if (!player->GetGProxy())
       {
         for (uint8_t j = 0; j < m_GProxyEmptyActions; ++j)
-          Send(player, m_Protocol->SEND_W3GS_INCOMING_ACTION(queue<CIncomingAction*>(), 0));
+          player->Send(EmptyActions);
       }
     }
   }
@@ -964,60 +1068,27 @@ void CGame::SendAllActions()
 
   // we aren't allowed to send more than 1460 bytes in a single packet but it's possible we might have more than that many bytes waiting in the queue
 
-  if (!m_Actions.empty())
-  {
-    // we use a "sub actions queue" which we keep adding actions to until we reach the size limit
-    // start by adding one action to the sub actions queue
-
-    queue<CIncomingAction*> SubActions;
-    CIncomingAction*        Action = m_Actions.front();
-    m_Actions.pop();
-    SubActions.push(Action);
-    uint32_t SubActionsLength = Action->GetLength();
-
-    while (!m_Actions.empty())
-    {
-      Action = m_Actions.front();
-      m_Actions.pop();
-
-      // check if adding the next action to the sub actions queue would put us over the limit (1452 because the INCOMING_ACTION and INCOMING_ACTION2 packets use an extra 8 bytes)
-
-      if (SubActionsLength + Action->GetLength() > 1452)
-      {
-        // we'd be over the limit if we added the next action to the sub actions queue
-        // so send everything already in the queue and then clear it out
-        // the W3GS_INCOMING_ACTION2 packet handles the overflow but it must be sent *before* the corresponding W3GS_INCOMING_ACTION packet
-
-        SendAll(m_Protocol->SEND_W3GS_INCOMING_ACTION2(SubActions));
-
-        while (!SubActions.empty())
-        {
-          delete SubActions.front();
-          SubActions.pop();
-        }
-
-        SubActionsLength = 0;
-      }
-
-      SubActions.push(Action);
-      SubActionsLength += Action->GetLength();
-    }
+  // so we split the queued actions into frames of whole actions which fit (1452 because the INCOMING_ACTION and INCOMING_ACTION2 packets use an extra 8 bytes)
+  // every frame but the last is sent as a W3GS_INCOMING_ACTION2 packet which handles the overflow, it must be sent *before* the corresponding W3GS_INCOMING_ACTION packet
 
-    SendAll(m_Protocol->SEND_W3GS_INCOMING_ACTION(SubActions, m_Latency));
+  uint32_t Start = 0;
+  uint32_t End   = m_Actions.GetFrameEnd(Start, 1452);
 
-    while (!SubActions.empty())
-    {
-      delete SubActions.front();
-      SubActions.pop();
-    }
+  while (End < m_Actions.GetSize())
+  {
+    SendAll(m_Protocol->SEND_W3GS_INCOMING_ACTION2(CByteSpan(m_Actions.GetData() + Start, End - Start)));
+    Start = End;
+    End   = m_Actions.GetFrameEnd(Start, 1452);
   }
-  else
-    SendAll(m_Protocol->SEND_W3GS_INCOMING_ACTION(m_Actions, m_Latency));
+
+  SendAll(m_Protocol->SEND_W3GS_INCOMING_ACTION(CByteSpan(m_Actions.GetData() + Start, End - Start), m_Latency));
+  m_Actions.Clear();
 
   const int64_t Ticks                = GetTicks();
   const int64_t ActualSendInterval   = Ticks - m_LastActionSentTicks;
   const int64_t ExpectedSendInterval = m_Latency - m_LastActionLateBy;
   m_LastActionLateBy                 = ActualSendInterval - ExpectedSendInterval;
+  m_PerfActionLateBy.Record(m_LastActionLateBy);
 
   if (m_LastActionLateBy > m_Latency)
   {
@@ -1027,13 +1098,23 @@ void CGame::SendAllActions()
 
     // this program is SO FAST, I've yet to see this happen *coolface*
 
-    Print2("[GAME: " + m_GameName + "] warning - the latency is " + to_string(m_Latency) + "ms but the last update was late by " + to_string(m_LastActionLateBy) + "ms");
+    Print2("[GAME: " + m_GameName + "] warning - the latency is " + to_string(m_Latency) + "ms but the last update was late by " + to_string(m_LastActionLateBy) + "ms", LOG_WARNING);
     m_LastActionLateBy = m_Latency;
   }
 
   m_LastActionSentTicks = Ticks;
 }
 
+void CGame::ScheduleActions()
+{
+  // the next action packet is due m_Latency ms after the last one, minus however late we were sending that one
+
+  if (!m_TimerWheel || !m_GameLoaded || m_Lagging)
+    return;
+
+  m_ActionTimer.Schedule(m_TimerWheel, m_LastActionSentTicks + m_Latency - m_LastActionLateBy);
+}
+
 void CGame::EventPlayerDeleted(CGamePlayer* player)
 {
   Print2("[GAME: " + m_GameName + "] deleting player [" + player->GetName() + "]: " + player->GetLeftReason());
@@ -1247,25 +1328,21 @@ void CGame::EventPlayerJoined(CPotentialPlayer* potential, CIncomingJoinPlayer*
   }
   else
   {
-    for (auto& bnet : m_Aura->m_BNETs)
-    {
-      if (bnet->GetHostCounterID() == HostCounterID)
-      {
-        JoinedRealm = bnet->GetServer();
-        break;
-      }
-    }
+    const auto Realm = m_Realms.find(static_cast<uint8_t>(HostCounterID));
+
+    if (Realm != end(m_Realms))
+      JoinedRealm = Realm->second;
   }
 
   // check if the new player's name is banned
   // don't allow the player to spam the chat by attempting to join the game multiple times in a row
 
-  for (auto& bnet : m_Aura->m_BNETs)
+  for (const auto& realm : m_Realms)
   {
-    if (bnet->GetServer() == JoinedRealm)
+    if (realm.second == JoinedRealm)
     {
-      CDBBan* Ban   = bnet->IsBannedName(joinPlayer->GetName());
-      CDBBan* IpBan = bnet->IsBannedIp(potential->GetExternalIPString());
+      CDBBan* Ban   = m_Aura->m_DB->BanCheck(JoinedRealm, joinPlayer->GetName(), string());
+      CDBBan* IpBan = m_Aura->m_DB->BanCheck(JoinedRealm, string(), potential->GetExternalIPString());
 
       if (Ban || IpBan)
       {
@@ -1514,13 +1591,13 @@ void CGame::EventPlayerLoaded(CGamePlayer* player)
   SendAll(m_Protocol->SEND_W3GS_GAMELOADED_OTHERS(player->GetPID()));
 }
 
-void CGame::EventPlayerAction(CGamePlayer* player, CIncomingAction* action)
+void CGame::EventPlayerAction(CGamePlayer* player, const CByteSpan& action)
 {
-  m_Actions.push(action);
+  m_Actions.Push(player->GetPID(), action);
 
   // check for players saving the game and notify everyone
 
-  if (!action->GetAction()->empty() && (*action->GetAction())[0] == 6)
+  if (!action.empty() && action[0] == 6)
   {
     Print2("[GAME: " + m_GameName + "] player [" + player->GetName() + "] is saving the game");
     SendAllChat("Player [" + player->GetName() + "] is saving the game");
@@ -1528,7 +1605,7 @@ void CGame::EventPlayerAction(CGamePlayer* player, CIncomingAction* action)
 
   // give the stats class a chance to process the action
 
-  if (m_Stats && action->GetAction()->size() >= 6 && m_Stats->ProcessAction(action) && m_GameOverTime == 0)
+  if (m_Stats && action.size() >= 6 && m_Stats->ProcessAction(action) && m_GameOverTime == 0)
   {
     Print2("[GAME: " + m_GameName + "] gameover timer started (stats class reported game over)");
     m_GameOverTime = GetTime();
@@ -1573,7 +1650,7 @@ void CGame::EventPlayerChatToHost(CGamePlayer* player, CIncomingChatPlayer* chat
 
       // calculate timestamp
 
-      if ((m_MuteAll || m_MuteLobby) && !(chatPlayer->GetMessage()[0] == m_Aura->m_CommandTrigger || chatPlayer->GetMessage()[0] == '/'))
+      if ((m_MuteAll || m_MuteLobby) && !(chatPlayer->GetMessage()[0] == m_CommandTrigger || chatPlayer->GetMessage()[0] == '/'))
         Relay = false;
       else
         Relay = true;
@@ -1633,7 +1710,7 @@ void CGame::EventPlayerChatToHost(CGamePlayer* player, CIncomingChatPlayer* chat
 
       const string Message = m_LastMessage;
 
-      if (!Message.empty() && (Message[0] == m_Aura->m_CommandTrigger || Message[0] == '/'))
+      if (!Message.empty() && (Message[0] == m_CommandTrigger || Message[0] == '/'))
       {
         // extract the command trigger, the command, and the payload
         // e.g. "!say hello world" -> command: "say", payload: "hello world"
@@ -1682,29 +1759,8 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
   const std::string& Command = command;
   const std::string& Payload = payload;
 
-  bool AdminCheck = false, RootAdminCheck = false;
-
-  for (auto& bnet : m_Aura->m_BNETs)
-  {
-    if ((bnet->GetServer() == player->GetSpoofedRealm() || player->GetJoinedRealm().empty()) && bnet->IsRootAdmin(User))
-    {
-      RootAdminCheck = true;
-      AdminCheck     = true;
-      break;
-    }
-  }
-
-  if (!RootAdminCheck)
-  {
-    for (auto& bnet : m_Aura->m_BNETs)
-    {
-      if ((bnet->GetServer() == player->GetSpoofedRealm() || player->GetJoinedRealm().empty()) && bnet->IsAdmin(User))
-      {
-        AdminCheck = true;
-        break;
-      }
-    }
-  }
+  const bool RootAdminCheck = IsRootAdmin(player);
+  const bool AdminCheck     = RootAdminCheck || IsAdmin(player);
 
   const uint64_t CommandHash = HashCode(Command);
 
@@ -1736,7 +1792,7 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
 
             Froms += (*i)->GetName();
             Froms += ": (";
-            Froms += m_Aura->m_DB->FromCheck(ByteArrayToUInt32((*i)->GetExternalIP(), true));
+            Froms += m_Aura->m_IPToCountry->Find(ByteArrayToUInt32((*i)->GetExternalIP(), true));
             Froms += ")";
 
             if (i != end(m_Players) - 1)
@@ -1764,7 +1820,7 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
         case HashCode("banlast"):
         case HashCode("bl"):
         {
-          if (!m_GameLoaded || m_Aura->m_BNETs.empty() || !m_DBBanLast)
+          if (!m_GameLoaded || m_Realms.empty() || !m_DBBanLast)
             break;
 
           if (!RootAdminCheck)
@@ -1955,18 +2011,7 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
             SendAllChat("Unable to kick player [" + Payload + "]. No matches found");
           else if (Matches == 1)
           {
-            bool LastMatchRootAdminCheck = false;
-
-            for (auto& bnet : m_Aura->m_BNETs)
-            {
-              if ((bnet->GetServer() == LastMatch->GetSpoofedRealm() || LastMatch->GetJoinedRealm().empty()) && bnet->IsRootAdmin(LastMatch->GetName()))
-              {
-                LastMatchRootAdminCheck = true;
-                break;
-              }
-            }
-
-            if (!RootAdminCheck && LastMatchRootAdminCheck)
+            if (!RootAdminCheck && IsRootAdmin(LastMatch))
             {
               SendAllChat("Error: You cannont kick a Root Admin!");
               break;
@@ -2021,6 +2066,8 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
             {
               // do nothing
             }
+
+            ScheduleActions();
           }
 
           break;
@@ -2097,6 +2144,18 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
           break;
         }
 
+        //
+        // !PERF
+        //
+
+        case HashCode("perf"):
+        {
+          for (const auto& line : GetPerfReport())
+            SendChat(player, line);
+
+          break;
+        }
+
         //
         // !PRIV (rehost as private game)
         //
@@ -2116,23 +2175,27 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
             m_HostCounter  = m_Aura->m_HostCounter++;
             m_RefreshError = false;
 
-            for (auto& bnet : m_Aura->m_BNETs)
-            {
-              // unqueue any existing game refreshes because we're going to assume the next successful game refresh indicates that the rehost worked
-              // this ignores the fact that it's possible a game refresh was just sent and no response has been received yet
-              // we assume this won't happen very often since the only downside is a potential false positive
+            CAura* Aura = m_Aura;
+
+            RunOnMainThread([Aura, GameState = m_GameState, GameName = m_GameName, Map = m_Map, HostCounter = m_HostCounter]() {
+              for (auto& bnet : Aura->m_BNETs)
+              {
+                // unqueue any existing game refreshes because we're going to assume the next successful game refresh indicates that the rehost worked
+                // this ignores the fact that it's possible a game refresh was just sent and no response has been received yet
+                // we assume this won't happen very often since the only downside is a potential false positive
 
-              bnet->UnqueueGameRefreshes();
-              bnet->QueueGameUncreate();
-              bnet->QueueEnterChat();
+                bnet->UnqueueGameRefreshes();
+                bnet->QueueGameUncreate();
+                bnet->QueueEnterChat();
 
-              // we need to send the game creation message now because private games are not refreshed
+                // we need to send the game creation message now because private games are not refreshed
 
-              bnet->QueueGameCreate(m_GameState, m_GameName, m_Map, m_HostCounter);
+                bnet->QueueGameCreate(GameState, GameName, Map, HostCounter);
 
-              if (!bnet->GetPvPGN())
-                bnet->QueueEnterChat();
-            }
+                if (!bnet->GetPvPGN())
+                  bnet->QueueEnterChat();
+              }
+            });
 
             m_CreationTime    = GetTime();
             m_LastRefreshTime = GetTime();
@@ -2162,18 +2225,22 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
             m_HostCounter  = m_Aura->m_HostCounter++;
             m_RefreshError = false;
 
-            for (auto& bnet : m_Aura->m_BNETs)
-            {
-              // unqueue any existing game refreshes because we're going to assume the next successful game refresh indicates that the rehost worked
-              // this ignores the fact that it's possible a game refresh was just sent and no response has been received yet
-              // we assume this won't happen very often since the only downside is a potential false positive
+            CAura* Aura = m_Aura;
 
-              bnet->UnqueueGameRefreshes();
-              bnet->QueueGameUncreate();
-              bnet->QueueEnterChat();
+            RunOnMainThread([Aura]() {
+              for (auto& bnet : Aura->m_BNETs)
+              {
+                // unqueue any existing game refreshes because we're going to assume the next successful game refresh indicates that the rehost worked
+                // this ignores the fact that it's possible a game refresh was just sent and no response has been received yet
+                // we assume this won't happen very often since the only downside is a potential false positive
 
-              // the game creation message will be sent on the next refresh
-            }
+                bnet->UnqueueGameRefreshes();
+                bnet->QueueGameUncreate();
+                bnet->QueueEnterChat();
+
+                // the game creation message will be sent on the next refresh
+              }
+            });
 
             m_CreationTime = m_LastRefreshTime = GetTime();
           }
@@ -2191,8 +2258,8 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
         case HashCode("sn"):
         {
 
-          for (auto& bnet : m_Aura->m_BNETs){
-            if (!IsOwner(User) || !bnet->IsRootAdmin(User))
+          for (const auto& realm : m_Realms){
+            if (!IsOwner(User) || !m_Aura->m_DB->RootAdminCheck(realm.second, User))
             {
               SendAllChat("You cannot start someone else's lobby if you are not root admin");
               break;
@@ -2226,8 +2293,8 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
         case HashCode("start"):
         case HashCode("s"):
         {
-          for (auto& bnet : m_Aura->m_BNETs){
-            if (!IsOwner(User) || !bnet->IsRootAdmin(User))
+          for (const auto& realm : m_Realms){
+            if (!IsOwner(User) || !m_Aura->m_DB->RootAdminCheck(realm.second, User))
             {
               SendAllChat("You cannot start someone else's lobby if you are not root admin");
               break;
@@ -2447,21 +2514,22 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
           try
           {
             const uint32_t Downloads = stoul(Payload);
+            CAura*         Aura      = m_Aura;
 
             if (Downloads == 0)
             {
               SendAllChat("Map downloads disabled");
-              m_Aura->m_AllowDownloads = 0;
+              RunOnMainThread([Aura]() { Aura->m_AllowDownloads = 0; });
             }
             else if (Downloads == 1)
             {
               SendAllChat("Map downloads enabled");
-              m_Aura->m_AllowDownloads = 1;
+              RunOnMainThread([Aura]() { Aura->m_AllowDownloads = 1; });
             }
             else if (Downloads == 2)
             {
               SendAllChat("Conditional map downloads enabled");
-              m_Aura->m_AllowDownloads = 2;
+              RunOnMainThread([Aura]() { Aura->m_AllowDownloads = 2; });
             }
           }
           catch (...)
@@ -2505,18 +2573,7 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
             SendAllChat("Unable to mute/unmute player [" + Payload + "]. No matches found");
           else if (Matches == 1)
           {
-            bool LastMatchRootAdminCheck = false;
-
-            for (auto& bnet : m_Aura->m_BNETs)
-            {
-              if ((bnet->GetServer() == LastMatch->GetSpoofedRealm() || LastMatch->GetJoinedRealm().empty()) && bnet->IsRootAdmin(LastMatch->GetName()))
-              {
-                LastMatchRootAdminCheck = true;
-                break;
-              }
-            }
-
-            if (!RootAdminCheck && LastMatchRootAdminCheck)
+            if (!RootAdminCheck && IsRootAdmin(LastMatch))
             {
               SendAllChat("Error: You cannont mute a Root Admin!");
               break;
@@ -2571,7 +2628,7 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
         case HashCode("addban"):
         case HashCode("ban"):
         {
-          if (Payload.empty() || m_Aura->m_BNETs.empty())
+          if (Payload.empty() || m_Realms.empty())
             break;
 
           if (!RootAdminCheck)
@@ -2671,35 +2728,16 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
               SendChat(player, "Unable to check player [" + Payload + "]. No matches found");
             else if (Matches == 1)
             {
-              bool LastMatchAdminCheck = false;
+              const bool LastMatchAdminCheck     = IsAdmin(LastMatch);
+              const bool LastMatchRootAdminCheck = IsRootAdmin(LastMatch);
 
-              for (auto& bnet : m_Aura->m_BNETs)
-              {
-                if ((bnet->GetServer() == LastMatch->GetSpoofedRealm() || LastMatch->GetJoinedRealm().empty()) && bnet->IsAdmin(LastMatch->GetName()))
-                {
-                  LastMatchAdminCheck = true;
-                  break;
-                }
-              }
-
-              bool LastMatchRootAdminCheck = false;
-
-              for (auto& bnet : m_Aura->m_BNETs)
-              {
-                if ((bnet->GetServer() == LastMatch->GetSpoofedRealm() || LastMatch->GetJoinedRealm().empty()) && bnet->IsRootAdmin(LastMatch->GetName()))
-                {
-                  LastMatchRootAdminCheck = true;
-                  break;
-                }
-              }
-
-              SendAllChat("Checked player [" + LastMatch->GetName() + "]. Ping: " + (LastMatch->GetNumPings() > 0 ? to_string(LastMatch->GetPing(m_Aura->m_LCPings)) + "ms" : "N/A") + ", From: " + m_Aura->m_DB->FromCheck(ByteArrayToUInt32(LastMatch->GetExternalIP(), true)) + ", Admin: " + (LastMatchAdminCheck || LastMatchRootAdminCheck ? "Yes" : "No") + ", Owner: " + (IsOwner(LastMatch->GetName()) ? "Yes" : "No") + ", Spoof Checked: " + (LastMatch->GetSpoofed() ? "Yes" : "No") + ", Realm: " + (LastMatch->GetJoinedRealm().empty() ? "LAN" : LastMatch->GetJoinedRealm()) + ", Reserved: " + (LastMatch->GetReserved() ? "Yes" : "No"));
+              SendAllChat("Checked player [" + LastMatch->GetName() + "]. Ping: " + (LastMatch->GetNumPings() > 0 ? to_string(LastMatch->GetPing(m_LCPings)) + "ms" : "N/A") + ", From: " + m_Aura->m_IPToCountry->Find(ByteArrayToUInt32(LastMatch->GetExternalIP(), true)) + ", Admin: " + (LastMatchAdminCheck || LastMatchRootAdminCheck ? "Yes" : "No") + ", Owner: " + (IsOwner(LastMatch->GetName()) ? "Yes" : "No") + ", Spoof Checked: " + (LastMatch->GetSpoofed() ? "Yes" : "No") + ", Realm: " + (LastMatch->GetJoinedRealm().empty() ? "LAN" : LastMatch->GetJoinedRealm()) + ", Reserved: " + (LastMatch->GetReserved() ? "Yes" : "No"));
             }
             else
               SendChat(player, "Unable to check player [" + Payload + "]. Found more than one match");
           }
           else
-            SendAllChat("Checked player [" + User + "]. Ping: " + (player->GetNumPings() > 0 ? to_string(player->GetPing(m_Aura->m_LCPings)) + "ms" : "N/A") + ", From: " + m_Aura->m_DB->FromCheck(ByteArrayToUInt32(player->GetExternalIP(), true)) + ", Admin: " + (AdminCheck || RootAdminCheck ? "Yes" : "No") + ", Owner: " + (IsOwner(User) ? "Yes" : "No") + ", Spoof Checked: " + (player->GetSpoofed() ? "Yes" : "No") + ", Realm: " + (player->GetJoinedRealm().empty() ? "LAN" : player->GetJoinedRealm()) + ", Reserved: " + (player->GetReserved() ? "Yes" : "No"));
+            SendAllChat("Checked player [" + User + "]. Ping: " + (player->GetNumPings() > 0 ? to_string(player->GetPing(m_LCPings)) + "ms" : "N/A") + ", From: " + m_Aura->m_IPToCountry->Find(ByteArrayToUInt32(player->GetExternalIP(), true)) + ", Admin: " + (AdminCheck || RootAdminCheck ? "Yes" : "No") + ", Owner: " + (IsOwner(User) ? "Yes" : "No") + ", Spoof Checked: " + (player->GetSpoofed() ? "Yes" : "No") + ", Realm: " + (player->GetJoinedRealm().empty() ? "LAN" : player->GetJoinedRealm()) + ", Reserved: " + (player->GetReserved() ? "Yes" : "No"));
 
           break;
         }
@@ -2710,20 +2748,20 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
 
         case HashCode("checkban"):
         {
-          if (Payload.empty() || m_Aura->m_BNETs.empty())
+          if (Payload.empty() || m_Realms.empty())
             break;
 
-          for (auto& bnet : m_Aura->m_BNETs)
+          for (const auto& realm : m_Realms)
           {
-            CDBBan* Ban = m_Aura->m_DB->BanCheck(bnet->GetServer(), Payload, string( ));
+            CDBBan* Ban = m_Aura->m_DB->BanCheck(realm.second, Payload, string( ));
 
             if (Ban)
             {
-              SendAllChat("User [" + Payload + "] was banned on server [" + bnet->GetServer() + "] on " + Ban->GetDate() + " by [" + Ban->GetAdmin() + "] because [" + Ban->GetReason() + "]");
+              SendAllChat("User [" + Payload + "] was banned on server [" + realm.second + "] on " + Ban->GetDate() + " by [" + Ban->GetAdmin() + "] because [" + Ban->GetReason() + "]");
               delete Ban;
             }
             else
-              SendAllChat("User [" + Payload + "] is not banned on server [" + bnet->GetServer() + "]");
+              SendAllChat("User [" + Payload + "] is not banned on server [" + realm.second + "]");
           }
 
           break;
@@ -2749,15 +2787,31 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
 
         case HashCode("status"):
         {
-          string message = "Status: ";
+          // the connections' states belong to the main thread, it sends the answer back to the game
+          // a game on a worker thread is still around when the main thread gets to this (see RunOnMainThread) but has to be locked
 
-          for (const auto& bnet : m_Aura->m_BNETs)
-            message += bnet->GetServer() + (bnet->GetLoggedIn() ? " [online], " : " [offline], ");
+          CAura*     Aura   = m_Aura;
+          CGame*     Game   = this;
+          const bool Locked = m_Worker != nullptr;
 
-          if (m_Aura->m_IRC)
-            message += m_Aura->m_IRC->m_Server + (!m_Aura->m_IRC->m_WaitingToConnect ? " [online]" : " [offline]");
+          RunOnMainThread([Aura, Game, Locked]() {
+            string message = "Status: ";
+
+            for (const auto& bnet : Aura->m_BNETs)
+              message += bnet->GetServer() + (bnet->GetLoggedIn() ? " [online], " : " [offline], ");
+
+            if (Aura->m_IRC)
+              message += Aura->m_IRC->m_Server + (!Aura->m_IRC->m_WaitingToConnect ? " [online]" : " [offline]");
+
+            if (Locked)
+            {
+              lock_guard<mutex> Lock(Game->GetMutex());
+              Game->SendAllChat(message);
+            }
+            else
+              Game->SendAllChat(message);
+          });
 
-          SendAllChat(message);
           break;
         }
 
@@ -2805,7 +2859,9 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
             // note: the PrivateGame flag is not set when broadcasting to LAN (as you might expect)
             // note: we do not use m_Map->GetMapGameType because none of the filters are set when broadcasting to LAN (also as you might expect)
             
-            m_Aura->m_UDPSocket->SendTo(IP, Port, m_Protocol->SEND_W3GS_GAMEINFO(m_Aura->m_LANWar3Version, CreateByteArray(static_cast<uint32_t>(MAPGAMETYPE_UNKNOWN0), false), m_Map->GetMapGameFlags(), m_Map->GetMapWidth(), m_Map->GetMapHeight(), m_GameName, "Clan 007", 0, m_Map->GetMapPath(), m_Map->GetMapCRC(), MAX_SLOTS, MAX_SLOTS, m_HostPort, m_HostCounter & 0x0FFFFFFF, m_EntryKey));
+            CAura*                     Aura     = m_Aura;
+            const std::vector<uint8_t> GameInfo = m_Protocol->SEND_W3GS_GAMEINFO(m_Aura->m_LANWar3Version, CreateByteArray(static_cast<uint32_t>(MAPGAMETYPE_UNKNOWN0), false), m_Map->GetMapGameFlags(), m_Map->GetMapWidth(), m_Map->GetMapHeight(), m_GameName, "Clan 007", 0, m_Map->GetMapPath(), m_Map->GetMapCRC(), MAX_SLOTS, MAX_SLOTS, m_HostPort, m_HostCounter & 0x0FFFFFFF, m_EntryKey);
+            RunOnMainThread([Aura, IP, Port, GameInfo]() { Aura->m_UDPSocket->SendTo(IP, static_cast<uint16_t>(Port), GameInfo); });
           }
 
           break;
@@ -3028,9 +3084,8 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
           if (m_FakePlayers.empty() || !m_GameLoaded)
             break;
 
-          std::vector<uint8_t> CRC, Action;
-          Action.push_back(1);
-          m_Actions.push(new CIncomingAction(m_FakePlayers[rand() % m_FakePlayers.size()], CRC, Action));
+          const uint8_t Action = 1;
+          m_Actions.Push(m_FakePlayers[rand() % m_FakePlayers.size()], CByteSpan(&Action, 1));
           break;
         }
 
@@ -3044,9 +3099,8 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
           if (m_FakePlayers.empty() || !m_GameLoaded)
             break;
 
-          std::vector<uint8_t> CRC, Action;
-          Action.push_back(2);
-          m_Actions.push(new CIncomingAction(m_FakePlayers[0], CRC, Action));
+          const uint8_t Action = 2;
+          m_Actions.Push(m_FakePlayers[0], CByteSpan(&Action, 1));
           break;
         }
 
@@ -3176,8 +3230,14 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
             Name    = Payload.substr(0, MessageStart);
             Message = Payload.substr(MessageStart + 1);
 
-            for (auto& bnet : m_Aura->m_BNETs)
-              bnet->QueueChatCommand(Message, Name, true, string());
+            // this game may be running on a worker thread so let the main thread queue the whispers
+
+            CAura* Aura = m_Aura;
+
+            m_Aura->QueueEvent([Aura, Message, Name]() {
+              for (auto& bnet : Aura->m_BNETs)
+                bnet->QueueChatCommand(Message, Name, true, string());
+            });
           }
 
           break;
@@ -3192,8 +3252,12 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
           if (Payload.empty())
             break;
 
-          for (auto& bnet : m_Aura->m_BNETs)
-            bnet->QueueChatCommand("/whois " + Payload);
+          CAura* Aura = m_Aura;
+
+          m_Aura->QueueEvent([Aura, Payload]() {
+            for (auto& bnet : Aura->m_BNETs)
+              bnet->QueueChatCommand("/whois " + Payload);
+          });
 
           break;
         }
@@ -3393,12 +3457,12 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
 
         if ((*i)->GetNumPings() > 0)
         {
-          Pings += to_string((*i)->GetPing(m_Aura->m_LCPings));
+          Pings += to_string((*i)->GetPing(m_LCPings));
 
-          if (!m_GameLoaded && !m_GameLoading && !(*i)->GetReserved() && KickPing > 0 && (*i)->GetPing(m_Aura->m_LCPings) > KickPing)
+          if (!m_GameLoaded && !m_GameLoading && !(*i)->GetReserved() && KickPing > 0 && (*i)->GetPing(m_LCPings) > KickPing)
           {
             (*i)->SetDeleteMe(true);
-            (*i)->SetLeftReason("was kicked for excessive ping " + to_string((*i)->GetPing(m_Aura->m_LCPings)) + " > " + to_string(KickPing));
+            (*i)->SetLeftReason("was kicked for excessive ping " + to_string((*i)->GetPing(m_LCPings)) + " > " + to_string(KickPing));
             (*i)->SetLeftCode(PLAYERLEAVE_LOBBY);
             OpenSlot(GetSIDFromPID((*i)->GetPID()), false);
             ++Kicked;
@@ -3436,7 +3500,7 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
 
     case HashCode("checkme"):
     {
-      SendChat(player, "Checked player [" + User + "]. Ping: " + (player->GetNumPings() > 0 ? to_string(player->GetPing(m_Aura->m_LCPings)) + "ms" : "N/A") + ", From: " + m_Aura->m_DB->FromCheck(ByteArrayToUInt32(player->GetExternalIP(), true)) + ", Admin: " + (AdminCheck || RootAdminCheck ? "Yes" : "No") + ", Owner: " + (IsOwner(User) ? "Yes" : "No") + ", Spoof Checked: " + (player->GetSpoofed() ? "Yes" : "No") + ", Realm: " + (player->GetJoinedRealm().empty() ? "LAN" : player->GetJoinedRealm()) + ", Reserved: " + (player->GetReserved() ? "Yes" : "No"));
+      SendChat(player, "Checked player [" + User + "]. Ping: " + (player->GetNumPings() > 0 ? to_string(player->GetPing(m_LCPings)) + "ms" : "N/A") + ", From: " + m_Aura->m_IPToCountry->Find(ByteArrayToUInt32(player->GetExternalIP(), true)) + ", Admin: " + (AdminCheck || RootAdminCheck ? "Yes" : "No") + ", Owner: " + (IsOwner(User) ? "Yes" : "No") + ", Spoof Checked: " + (player->GetSpoofed() ? "Yes" : "No") + ", Realm: " + (player->GetJoinedRealm().empty() ? "LAN" : player->GetJoinedRealm()) + ", Reserved: " + (player->GetReserved() ? "Yes" : "No"));
       break;
     }
 
@@ -3558,8 +3622,8 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
 
             player->SetKickVote(true);
             Print2("[GAME: " + m_GameName + "] votekick against player [" + m_KickVotePlayer + "] started by player [" + User + "]");
-            SendAllChat("Player [" + User + "] voted to kick player [" + LastMatch->GetName() + "]. " + to_string(static_cast<uint32_t>(ceil((GetNumHumanPlayers() - 1) * static_cast<float>(m_Aura->m_VoteKickPercentage) / 100)) - 1) + " more votes are needed to pass");
-            SendAllChat("Type " + string(1, m_Aura->m_CommandTrigger) + "yes to vote");
+            SendAllChat("Player [" + User + "] voted to kick player [" + LastMatch->GetName() + "]. " + to_string(static_cast<uint32_t>(ceil((GetNumHumanPlayers() - 1) * static_cast<float>(m_VoteKickPercentage) / 100)) - 1) + " more votes are needed to pass");
+            SendAllChat("Type " + string(1, m_CommandTrigger) + "yes to vote");
           }
         }
         else
@@ -3579,7 +3643,7 @@ bool CGame::EventPlayerBotCommand(CGamePlayer* player, string& command, string&
         break;
 
       player->SetKickVote(true);
-      uint32_t Votes = 0, VotesNeeded = static_cast<uint32_t>(ceil((GetNumHumanPlayers() - 1) * static_cast<float>(m_Aura->m_VoteKickPercentage) / 100));
+      uint32_t Votes = 0, VotesNeeded = static_cast<uint32_t>(ceil((GetNumHumanPlayers() - 1) * static_cast<float>(m_VoteKickPercentage) / 100));
 
       for (auto& player : m_Players)
       {
@@ -3789,9 +3853,7 @@ void CGame::EventPlayerMapSize(CGamePlayer* player, CIncomingMapSize* mapSize)
 
     if (m_Aura->m_DB->RootAdminCheck(player->GetName()) || m_Aura->m_AllowDownloads)
     {
-      string* MapData = m_Map->GetMapData();
-
-      if (!MapData->empty())
+      if (!m_Map->GetMapData().empty())
       {
         if (Admin || m_Aura->m_AllowDownloads == 1 || (m_Aura->m_AllowDownloads == 2 && player->GetDownloadAllowed()))
         {
@@ -3803,9 +3865,24 @@ void CGame::EventPlayerMapSize(CGamePlayer* player, CIncomingMapSize* mapSize)
             Send(player, m_Protocol->SEND_W3GS_STARTDOWNLOAD(GetHostPID()));
             player->SetDownloadStarted(true);
             player->SetStartedDownloadingTicks(GetTicks());
+
+            // the map server is usually a lot faster than the game protocol, let them know it's there
+
+            const string URL = m_Aura->m_MapServer ? m_Aura->m_MapServer->GetMapURL(m_Map) : string();
+
+            if (!URL.empty())
+              SendChat(player, "You can also download the map from " + URL);
           }
           else
+          {
+            // an acknowledgement while our send queue is (nearly) empty means the player is keeping up, let them have more in flight
+            // growing by the amount acknowledged doubles the window every round trip until it's full
+
+            if (mapSize->GetMapSize() > player->GetLastMapPartAcked() && player->GetSocket()->GetSendQueueSize() <= MAPWINDOW_BACKLOG * MAP_PART_SIZE)
+              player->SetMapWindow(min<uint32_t>(player->GetMapWindow() + mapSize->GetMapSize() - player->GetLastMapPartAcked(), MAPWINDOW_MAX * MAP_PART_SIZE));
+
             player->SetLastMapPartAcked(mapSize->GetMapSize());
+          }
         }
       }
       else
@@ -3858,13 +3935,13 @@ void CGame::EventPlayerPongToHost(CGamePlayer* player)
   // also don't kick anyone if the game is loading or loaded - this could happen because we send pings during loading but we stop sending them after the game is loaded
   // see the Update function for where we send pings
 
-  if (!m_GameLoading && !m_GameLoaded && !player->GetDeleteMe() && !player->GetReserved() && player->GetNumPings() >= 3 && player->GetPing(m_Aura->m_LCPings) > m_Aura->m_AutoKickPing)
+  if (!m_GameLoading && !m_GameLoaded && !player->GetDeleteMe() && !player->GetReserved() && player->GetNumPings() >= 3 && player->GetPing(m_LCPings) > m_Aura->m_AutoKickPing)
   {
     // send a chat message because we don't normally do so when a player leaves the lobby
 
-    SendAllChat("Autokicking player [" + player->GetName() + "] for excessive ping of " + to_string(player->GetPing(m_Aura->m_LCPings)));
+    SendAllChat("Autokicking player [" + player->GetName() + "] for excessive ping of " + to_string(player->GetPing(m_LCPings)));
     player->SetDeleteMe(true);
-    player->SetLeftReason("was autokicked for excessive ping of " + to_string(player->GetPing(m_Aura->m_LCPings)));
+    player->SetLeftReason("was autokicked for excessive ping of " + to_string(player->GetPing(m_LCPings)));
     player->SetLeftCode(PLAYERLEAVE_LOBBY);
     OpenSlot(GetSIDFromPID(player->GetPID()), false);
   }
@@ -3993,18 +4070,21 @@ void CGame::EventGameStarted()
   delete m_Map;
   m_Map = nullptr;
 
-  // move the game to the games in progress vector
+  // move the game to the games in progress vector and finally reenter battle.net chat
 
-  m_Aura->m_CurrentGame = nullptr;
-  m_Aura->m_Games.push_back(this);
+  CAura* Aura = m_Aura;
+  CGame* Game = this;
 
-  // and finally reenter battle.net chat
+  RunOnMainThread([Aura, Game]() {
+    Aura->m_CurrentGame = nullptr;
+    Aura->m_Games.push_back(Game);
 
-  for (auto& bnet : m_Aura->m_BNETs)
-  {
-    bnet->QueueGameUncreate();
-    bnet->QueueEnterChat();
-  }
+    for (auto& bnet : Aura->m_BNETs)
+    {
+      bnet->QueueGameUncreate();
+      bnet->QueueEnterChat();
+    }
+  });
 
   // record everything we need to ban each player in case we decide to do so later
   // this is because when a player leaves the game an admin might want to ban that player
@@ -4015,6 +4095,22 @@ void CGame::EventGameStarted()
     m_DBBans.push_back(new CDBBan(player->GetJoinedRealm(), player->GetName(), string(), string(), string(), player->GetExternalIPString()));
 }
 
+void CGame::EventActionTimer()
+{
+  // send actions every m_Latency milliseconds
+  // actions are at the heart of every Warcraft 3 game but luckily we don't need to know their contents to relay them
+  // we queue player actions in EventPlayerAction then just resend them in batches to all players here
+  // the timer wheel runs this between Update and UpdatePost so the batch includes everything received this loop and is sent right away
+
+  lock_guard<mutex> Lock(m_Mutex);
+
+  if (!m_GameLoaded || m_Lagging)
+    return;
+
+  SendAllActions();
+  ScheduleActions();
+}
+
 void CGame::EventGameLoaded()
 {
   Print2("[GAME: " + m_GameName + "] finished loading with " + to_string(GetNumHumanPlayers()) + " players");
@@ -4713,6 +4809,30 @@ bool CGame::IsReserved(string name) const
   return false;
 }
 
+bool CGame::IsAdmin(CGamePlayer* player) const
+{
+  // an admin on the realm the player was spoof checked on, or on any realm if the player joined over LAN
+
+  for (const auto& realm : m_Realms)
+  {
+    if ((realm.second == player->GetSpoofedRealm() || player->GetJoinedRealm().empty()) && m_Aura->m_DB->AdminCheck(realm.second, player->GetName()))
+      return true;
+  }
+
+  return false;
+}
+
+bool CGame::IsRootAdmin(CGamePlayer* player) const
+{
+  for (const auto& realm : m_Realms)
+  {
+    if ((realm.second == player->GetSpoofedRealm() || player->GetJoinedRealm().empty()) && m_Aura->m_DB->RootAdminCheck(realm.second, player->GetName()))
+      return true;
+  }
+
+  return false;
+}
+
 bool CGame::IsDownloading() const
 {
   // returns true if at least one player is downloading the map
@@ -4962,3 +5082,13 @@ void CGame::DeleteFakePlayers()
   m_FakePlayers.clear();
   SendAllSlotInfo();
 }
+
+void CGame::RunOnMainThread(function<void()> event)
+{
+  // a worker queues its game over event after anything queued here, so the game still exists when the event runs (the event has to lock it to touch it though)
+
+  if (m_Worker)
+    m_Aura->QueueEvent(std::move(event));
+  else
+    event();
+}
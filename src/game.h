@@ -22,9 +22,23 @@
 #define AURA_GAME_H_
 
 #include "gameslot.h"
+#include "timerwheel.h"
+#include "util.h"
+#include "gameprotocol.h"
+#include "histogram.h"
 
 #include <set>
+#include <map>
 #include <queue>
+#include <mutex>
+#include <functional>
+
+// map download windows in map parts (see CGame :: UpdateMapDownloads)
+
+#define MAPWINDOW_MIN 4       // never less than ~6 KB in flight
+#define MAPWINDOW_INITIAL 16  // ~23 KB until we know how fast the player is
+#define MAPWINDOW_MAX 200     // ~280 KB, enough for ~2.8 MB/sec at 100 ms round trip
+#define MAPWINDOW_BACKLOG 8   // more than this many parts stuck in our send queue means the player's connection is backed up
 
 //
 // CGame
@@ -37,7 +51,6 @@ class CPotentialPlayer;
 class CGamePlayer;
 class CMap;
 class CIncomingJoinPlayer;
-class CIncomingAction;
 class CIncomingChatPlayer;
 class CIncomingMapSize;
 class CDBBan;
@@ -45,6 +58,8 @@ class CDBGamePlayer;
 class CStats;
 class CIRC;
 class CBNET;
+class CGameWorker;
+class CSocketPoller;
 
 class CGame
 {
@@ -58,12 +73,23 @@ protected:
   CStats*                        m_Stats;                         // class to keep track of game stats such as kills/deaths/assists in dota
   CGameProtocol*                 m_Protocol;                      // game protocol
   std::vector<CGameSlot>         m_Slots;                         // std::vector of slots
+  CGameWorker*                   m_Worker;                        // the worker thread updating this game (nullptr if it's updated by the main thread)
+  std::mutex                     m_Mutex;                         // held by whichever thread is updating the game, other threads must hold it too before touching the game
+  CTimerWheel*                   m_TimerWheel;                    // the timer wheel of the thread updating this game (nullptr while it's being moved)
+  CTimer                         m_ActionTimer;                   // fires when the next action packet is due
+  CHistogram                     m_PerfUpdate;                    // microseconds spent in Update
+  CHistogram                     m_PerfPlayers;                   // microseconds spent receiving and processing the players' packets (part of Update)
+  CHistogram                     m_PerfLagCheck;                  // microseconds spent checking for lagging players (part of Update)
+  CHistogram                     m_PerfActions;                   // microseconds spent building and queueing the action packets in SendAllActions
+  CHistogram                     m_PerfUpdatePost;                // microseconds spent flushing the send buffers in UpdatePost
+  CHistogram                     m_PerfActionLateBy;              // milliseconds each action packet was sent after it was due
   std::vector<CPotentialPlayer*> m_Potentials;                    // std::vector of potential players (connections that haven't sent a W3GS_REQJOIN packet yet)
   std::vector<CDBGamePlayer*>    m_DBGamePlayers;                 // std::vector of potential gameplayer data for the database
   std::vector<CGamePlayer*>      m_Players;                       // std::vector of players
-  std::queue<CIncomingAction*>   m_Actions;                       // queue of actions to be sent
+  CActionQueue                   m_Actions;                       // queue of actions to be sent
   std::vector<std::string>       m_Reserved;                      // std::vector of player names with reserved slots (from the !hold command)
   std::set<std::string>          m_IgnoredNames;                  // set of player names to NOT print ban messages for when joining because they've already been printed
+  std::map<uint8_t, std::string> m_Realms;                        // host counter ID -> server of each battle.net connection (copied since the connections belong to the main thread)
   std::vector<uint8_t>           m_FakePlayers;                   // the fake player's PIDs (if present)
   CMap*                          m_Map;                           // map data
   std::string                    m_GameName;                      // game name
@@ -96,18 +122,25 @@ protected:
   int64_t                        m_LastPlayerLeaveTicks;          // GetTicks when the most recent player left the game
   int64_t                        m_LastLagScreenResetTime;        // GetTime when the "lag" screen was last reset
   int64_t                        m_RandomSeed;                    // the random seed sent to the Warcraft III clients
+  uint64_t                       m_BytesIn;                       // bytes received from the players
+  uint64_t                       m_BytesOut;                      // bytes queued for the players
+  uint64_t                       m_PacketsIn;                     // packets received from the players
+  uint64_t                       m_PacketsOut;                    // packets queued for the players
   uint32_t                       m_HostCounter;                   // a unique game number
   uint32_t                       m_EntryKey;                      // random entry key for LAN, used to prove that a player is actually joining from LAN
   uint32_t                       m_Latency;                       // the number of ms to wait between sending action packets (we queue any received during this time)
   uint32_t                       m_SyncLimit;                     // the maximum number of packets a player can fall out of sync before starting the lag screen
+  uint32_t                       m_VoteKickPercentage;            // percentage of players required to vote yes for a votekick to pass
   uint32_t                       m_SyncCounter;                   // the number of actions sent so far (for determining if anyone is lagging)
   uint32_t                       m_DownloadCounter;               // # of map bytes downloaded in the last second
+  uint32_t                       m_DownloadRotation;              // which downloader is served first next time, rotated so they all get a fair share
   uint32_t                       m_CountDownCounter;              // the countdown is finished when this reaches zero
   uint32_t                       m_StartPlayers;                  // number of players when the game started
   uint16_t                       m_HostPort;                      // the port to host games on
   uint8_t                        m_GameState;                     // game state, public or private
   uint8_t                        m_VirtualHostPID;                // host's PID
   uint8_t                        m_GProxyEmptyActions;            // empty actions used for gproxy protocol
+  char                           m_CommandTrigger;                // the command trigger inside the game
   bool                           m_Exiting;                       // set to true and this class will be deleted next update
   bool                           m_Saving;                        // if we're currently saving game data to the database
   bool                           m_SlotInfoChanged;               // if the slot info has changed and hasn't been sent to the players yet (optimization)
@@ -120,6 +153,7 @@ protected:
   bool                           m_GameLoaded;                    // if the game has loaded or not
   bool                           m_Lagging;                       // if the lag screen is active or not
   bool                           m_Desynced;                      // if the game has desynced or not
+  bool                           m_LCPings;                       // use LC style pings (divide actual pings by two)
 
 public:
   CGame(CAura* nAura, CMap* nMap, uint16_t nHostPort, uint8_t nGameState, std::string& nGameName, std::string& nOwnerName, std::string& nCreatorName, CBNET* nCreatorServer);
@@ -128,6 +162,8 @@ public:
 
   inline CMap*          GetMap() const { return m_Map; }
   inline CGameProtocol* GetProtocol() const { return m_Protocol; }
+  inline CGameWorker*   GetWorker() const { return m_Worker; }
+  inline std::mutex&    GetMutex() { return m_Mutex; }
   inline uint32_t       GetEntryKey() const { return m_EntryKey; }
   inline uint16_t       GetHostPort() const { return m_HostPort; }
   inline uint8_t        GetGameState() const { return m_GameState; }
@@ -146,31 +182,51 @@ public:
   inline bool           GetGameLoaded() const { return m_GameLoaded; }
   inline bool           GetLagging() const { return m_Lagging; }
 
-  int64_t     GetNextTimedActionTicks() const;
+  inline const CHistogram& GetPerfActionLateBy() const { return m_PerfActionLateBy; }
+
   uint32_t    GetSlotsOccupied() const;
   uint32_t    GetSlotsOpen() const;
   uint32_t    GetNumPlayers() const;
   uint32_t    GetNumHumanPlayers() const;
+  uint32_t    GetGProxyBufferSize() const;
   std::string GetDescription() const;
   std::string GetPlayers() const;
   std::string GetObservers() const;
+  std::vector<std::string> GetPerfReport() const;
+
+  inline void AddPacketIn(uint32_t bytes)
+  {
+    ++m_PacketsIn;
+    m_BytesIn += bytes;
+  }
+
+  inline void AddPacketOut(uint32_t bytes)
+  {
+    ++m_PacketsOut;
+    m_BytesOut += bytes;
+  }
 
   inline void SetExiting(bool nExiting) { m_Exiting = nExiting; }
+  inline void SetWorker(CGameWorker* nWorker) { m_Worker = nWorker; }
   inline void SetRefreshError(bool nRefreshError) { m_RefreshError = nRefreshError; }
   inline void SetStartedLaggingTime(int64_t nStartedLaggingTime) { m_StartedLaggingTime = nStartedLaggingTime; }
 
   // processing functions
 
   uint32_t SetFD(void* fd, void* send_fd, int32_t* nfds);
+  void SetPoller(CSocketPoller* poller);
+  void SetTimerWheel(CTimerWheel* wheel);
   bool Update(void* fd, void* send_fd);
   void UpdatePost(void* send_fd);
+  void UpdateMapDownloads();
 
   // generic functions to send packets to players
 
   void Send(CGamePlayer* player, const std::vector<uint8_t>& data);
   void Send(uint8_t PID, const std::vector<uint8_t>& data);
   void Send(const std::vector<uint8_t>& PIDs, const std::vector<uint8_t>& data);
-  void SendAll(const std::vector<uint8_t>& data);
+  void SendAll(const CSharedBytes& data);
+  void SendAll(std::vector<uint8_t> data);
 
   // functions to send packets to players
 
@@ -184,6 +240,7 @@ public:
   void SendVirtualHostPlayerInfo(CGamePlayer* player);
   void SendFakePlayerInfo(CGamePlayer* player);
   void SendAllActions();
+  void ScheduleActions();
 
   // events
   // note: these are only called while iterating through the m_Potentials or m_Players std::vectors
@@ -196,7 +253,7 @@ public:
   void EventPlayerJoined(CPotentialPlayer* potential, CIncomingJoinPlayer* joinPlayer);
   void EventPlayerLeft(CGamePlayer* player, uint32_t reason);
   void EventPlayerLoaded(CGamePlayer* player);
-  void EventPlayerAction(CGamePlayer* player, CIncomingAction* action);
+  void EventPlayerAction(CGamePlayer* player, const CByteSpan& action);
   void EventPlayerKeepAlive(CGamePlayer* player);
   void EventPlayerChatToHost(CGamePlayer* player, CIncomingChatPlayer* chatPlayer);
   bool EventPlayerBotCommand(CGamePlayer* player, std::string& command, std::string& payload);
@@ -212,6 +269,7 @@ public:
 
   void EventGameStarted();
   void EventGameLoaded();
+  void EventActionTimer();
 
   // other functions
 
@@ -242,6 +300,8 @@ public:
   void RemoveFromReserved(std::string name);
   bool IsOwner(std::string name) const;
   bool IsReserved(std::string name) const;
+  bool IsAdmin(CGamePlayer* player) const;
+  bool IsRootAdmin(CGamePlayer* player) const;
   bool IsDownloading() const;
   void StartCountDown(bool force);
   void StartCountDownNow(bool force);
@@ -251,6 +311,11 @@ public:
   void DeleteVirtualHost();
   void CreateFakePlayer();
   void DeleteFakePlayers();
+
+  // runs event on the main thread, right away if the game is updated by the main thread and with CAura :: QueueEvent if it's on a worker thread
+  // anything a game might do on a worker thread with CAura's state or the battle.net and irc connections has to go through here
+
+  void RunOnMainThread(std::function<void()> event);
 };
 
 #endif // AURA_GAME_H_
@@ -62,48 +62,37 @@ bool CPotentialPlayer::Update(void* fd)
   m_Socket->DoRecv(static_cast<fd_set*>(fd));
 
   // extract as many packets as possible from the socket's receive buffer and process them
+  // the packets are parsed in place, Data points into the receive buffer
 
-  string*              RecvBuffer      = m_Socket->GetBytes();
-  std::vector<uint8_t> Bytes           = CreateByteArray((uint8_t*)RecvBuffer->c_str(), RecvBuffer->size());
-  uint32_t             LengthProcessed = 0;
+  CRecvBuffer* RecvBuffer = m_Socket->GetRecvBuffer();
+  CByteSpan    Data;
 
-  // a packet is at least 4 bytes so loop as long as the buffer contains 4 bytes
-
-  while (Bytes.size() >= 4)
+  while (RecvBuffer->GetPacket(&Data))
   {
-    if (Bytes[0] == W3GS_HEADER_CONSTANT || Bytes[0] == GPS_HEADER_CONSTANT)
-    {
-      // bytes 2 and 3 contain the length of the packet
-
-      const uint16_t             Length = ByteArrayToUInt16(Bytes, false, 2);
-      const std::vector<uint8_t> Data   = std::vector<uint8_t>(begin(Bytes), begin(Bytes) + Length);
+    if (Data[0] != W3GS_HEADER_CONSTANT && Data[0] != GPS_HEADER_CONSTANT)
+      break;
 
-      if (Bytes.size() >= Length)
-      {
-        if (Bytes[0] == W3GS_HEADER_CONSTANT && Bytes[1] == CGameProtocol::W3GS_REQJOIN)
-        {
-          delete m_IncomingJoinPlayer;
-          m_IncomingJoinPlayer = m_Protocol->RECEIVE_W3GS_REQJOIN(Data);
-
-          if (m_IncomingJoinPlayer)
-            m_Game->EventPlayerJoined(this, m_IncomingJoinPlayer);
+    if (Data[0] == W3GS_HEADER_CONSTANT && Data[1] == CGameProtocol::W3GS_REQJOIN)
+    {
+      delete m_IncomingJoinPlayer;
+      m_IncomingJoinPlayer = m_Protocol->RECEIVE_W3GS_REQJOIN(Data);
+      RecvBuffer->Consume(Data.size());
 
-          // this is the packet which int32_terests us for now, the remainder is left for CGamePlayer
+      if (m_IncomingJoinPlayer)
+        m_Game->EventPlayerJoined(this, m_IncomingJoinPlayer);
 
-          LengthProcessed += Length;
-          Bytes = std::vector<uint8_t>(begin(Bytes) + Length, end(Bytes));
-          break;
-        }
+      // this is the packet which interests us for now, the remainder is left for CGamePlayer
 
-        LengthProcessed += Length;
-        Bytes = std::vector<uint8_t>(begin(Bytes) + Length, end(Bytes));
-      }
-      else
-        break;
+      break;
     }
+
+    RecvBuffer->Consume(Data.size());
   }
 
-  *RecvBuffer = RecvBuffer->substr(LengthProcessed);
+  // if the data doesn't look like W3GS or GPS packets we're not talking to a Warcraft III client, there's no way to recover
+
+  if (!m_DeleteMe && !RecvBuffer->IsEmpty() && (RecvBuffer->HasBadPacket() || (RecvBuffer->GetData()[0] != W3GS_HEADER_CONSTANT && RecvBuffer->GetData()[0] != GPS_HEADER_CONSTANT)))
+    m_Socket->Disconnect();
 
   // don't call DoSend here because some other players may not have updated yet and may generate a packet for this player
   // also m_Socket may have been set to nullptr during ProcessPackets but we're banking on the fact that m_DeleteMe has been set to true as well so it'll short circuit before dereferencing
@@ -135,6 +124,7 @@ CGamePlayer::CGamePlayer(CPotentialPlayer* potential, uint8_t nPID, string nJoin
     m_JoinTime(GetTime()),
     m_LastMapPartSent(0),
     m_LastMapPartAcked(0),
+    m_MapWindow(MAPWINDOW_INITIAL * MAP_PART_SIZE),
     m_StartedDownloadingTicks(0),
     m_FinishedDownloadingTime(0),
     m_FinishedLoadingTicks(0),
@@ -196,16 +186,20 @@ bool CGamePlayer::Update(void* fd)
 
   if (m_WhoisShouldBeSent && !m_Spoofed && !m_WhoisSent && !m_JoinedRealm.empty() && Time - m_JoinTime >= 4)
   {
-    for (auto& bnet : m_Game->m_Aura->m_BNETs)
-    {
-      if (bnet->GetServer() == m_JoinedRealm)
+    CAura* Aura = m_Game->m_Aura;
+
+    m_Game->RunOnMainThread([Aura, JoinedRealm = m_JoinedRealm, Name = m_Name, GameState = m_Game->GetGameState()]() {
+      for (auto& bnet : Aura->m_BNETs)
       {
-        if (m_Game->GetGameState() == GAME_PUBLIC || bnet->GetPvPGN())
-          bnet->QueueChatCommand("/whois " + m_Name);
-        else if (m_Game->GetGameState() == GAME_PRIVATE)
-          bnet->QueueChatCommand(R"(Spoof check by replying to this message with "sc" [ /r sc ])", m_Name, true, string());
+        if (bnet->GetServer() == JoinedRealm)
+        {
+          if (GameState == GAME_PUBLIC || bnet->GetPvPGN())
+            bnet->QueueChatCommand("/whois " + Name);
+          else if (GameState == GAME_PRIVATE)
+            bnet->QueueChatCommand(R"(Spoof check by replying to this message with "sc" [ /r sc ])", Name, true, string());
+        }
       }
-    }
+    });
 
     m_WhoisSent = true;
   }
@@ -229,175 +223,155 @@ bool CGamePlayer::Update(void* fd)
   m_Socket->DoRecv(static_cast<fd_set*>(fd));
 
   // extract as many packets as possible from the socket's receive buffer and process them
+  // the packets are parsed in place, Data points into the receive buffer until it's consumed
 
-  string*              RecvBuffer      = m_Socket->GetBytes();
-  std::vector<uint8_t> Bytes           = CreateByteArray((uint8_t*)RecvBuffer->c_str(), RecvBuffer->size());
-  uint32_t             LengthProcessed = 0;
+  CRecvBuffer* RecvBuffer = m_Socket->GetRecvBuffer();
+  CByteSpan    Data;
 
-  // a packet is at least 4 bytes so loop as long as the buffer contains 4 bytes
-
-  CIncomingAction*     Action;
+  CByteSpan            Action;
   CIncomingChatPlayer* ChatPlayer;
   CIncomingMapSize*    MapSize;
   uint32_t             Pong;
 
-  while (Bytes.size() >= 4)
+  while (RecvBuffer->GetPacket(&Data))
   {
-    // bytes 2 and 3 contain the length of the packet
-
-    const uint16_t             Length = ByteArrayToUInt16(Bytes, false, 2);
-    const std::vector<uint8_t> Data   = std::vector<uint8_t>(begin(Bytes), begin(Bytes) + Length);
-
-    if (Bytes[0] == W3GS_HEADER_CONSTANT)
+    if (Data[0] == W3GS_HEADER_CONSTANT)
     {
       ++m_TotalPacketsReceived;
+      m_Game->AddPacketIn(Data.size());
 
-      if (Bytes.size() >= Length)
-      {
-        // byte 1 contains the packet ID
+      // byte 1 contains the packet ID
 
-        switch (Bytes[1])
-        {
-          case CGameProtocol::W3GS_LEAVEGAME:
-            m_Game->EventPlayerLeft(this, m_Protocol->RECEIVE_W3GS_LEAVEGAME(Data));
-            break;
+      switch (Data[1])
+      {
+        case CGameProtocol::W3GS_LEAVEGAME:
+          m_Game->EventPlayerLeft(this, m_Protocol->RECEIVE_W3GS_LEAVEGAME(Data));
+          break;
 
-          case CGameProtocol::W3GS_GAMELOADED_SELF:
-            if (m_Protocol->RECEIVE_W3GS_GAMELOADED_SELF(Data))
+        case CGameProtocol::W3GS_GAMELOADED_SELF:
+          if (m_Protocol->RECEIVE_W3GS_GAMELOADED_SELF(Data))
+          {
+            if (!m_FinishedLoading)
             {
-              if (!m_FinishedLoading)
-              {
-                m_FinishedLoading      = true;
-                m_FinishedLoadingTicks = GetTicks();
-                m_Game->EventPlayerLoaded(this);
-              }
+              m_FinishedLoading      = true;
+              m_FinishedLoadingTicks = GetTicks();
+              m_Game->EventPlayerLoaded(this);
             }
+          }
 
-            break;
+          break;
 
-          case CGameProtocol::W3GS_OUTGOING_ACTION:
-            Action = m_Protocol->RECEIVE_W3GS_OUTGOING_ACTION(Data, m_PID);
+        case CGameProtocol::W3GS_OUTGOING_ACTION:
+          // Action points into the receive buffer, the game copies it into its action queue
 
-            if (Action)
-              m_Game->EventPlayerAction(this, Action);
+          if (m_Protocol->RECEIVE_W3GS_OUTGOING_ACTION(Data, m_PID, &Action))
+            m_Game->EventPlayerAction(this, Action);
 
-            // don't delete Action here because the game is going to store it in a queue and delete it later
+          break;
 
-            break;
+        case CGameProtocol::W3GS_OUTGOING_KEEPALIVE:
+          m_CheckSums.push(m_Protocol->RECEIVE_W3GS_OUTGOING_KEEPALIVE(Data));
+          ++m_SyncCounter;
+          m_Game->EventPlayerKeepAlive(this);
+          break;
 
-          case CGameProtocol::W3GS_OUTGOING_KEEPALIVE:
-            m_CheckSums.push(m_Protocol->RECEIVE_W3GS_OUTGOING_KEEPALIVE(Data));
-            ++m_SyncCounter;
-            m_Game->EventPlayerKeepAlive(this);
-            break;
+        case CGameProtocol::W3GS_CHAT_TO_HOST:
+          ChatPlayer = m_Protocol->RECEIVE_W3GS_CHAT_TO_HOST(Data);
 
-          case CGameProtocol::W3GS_CHAT_TO_HOST:
-            ChatPlayer = m_Protocol->RECEIVE_W3GS_CHAT_TO_HOST(Data);
+          if (ChatPlayer)
+            m_Game->EventPlayerChatToHost(this, ChatPlayer);
 
-            if (ChatPlayer)
-              m_Game->EventPlayerChatToHost(this, ChatPlayer);
+          delete ChatPlayer;
+          break;
 
-            delete ChatPlayer;
-            break;
+        case CGameProtocol::W3GS_DROPREQ:
+          if (!m_DropVote)
+          {
+            m_DropVote = true;
+            m_Game->EventPlayerDropRequest(this);
+          }
 
-          case CGameProtocol::W3GS_DROPREQ:
-            if (!m_DropVote)
-            {
-              m_DropVote = true;
-              m_Game->EventPlayerDropRequest(this);
-            }
+          break;
 
-            break;
+        case CGameProtocol::W3GS_MAPSIZE:
+          MapSize = m_Protocol->RECEIVE_W3GS_MAPSIZE(Data);
 
-          case CGameProtocol::W3GS_MAPSIZE:
-            MapSize = m_Protocol->RECEIVE_W3GS_MAPSIZE(Data);
+          if (MapSize)
+            m_Game->EventPlayerMapSize(this, MapSize);
 
-            if (MapSize)
-              m_Game->EventPlayerMapSize(this, MapSize);
+          delete MapSize;
+          break;
 
-            delete MapSize;
-            break;
+        case CGameProtocol::W3GS_PONG_TO_HOST:
+          Pong = m_Protocol->RECEIVE_W3GS_PONG_TO_HOST(Data);
 
-          case CGameProtocol::W3GS_PONG_TO_HOST:
-            Pong = m_Protocol->RECEIVE_W3GS_PONG_TO_HOST(Data);
+          // we discard pong values of 1
+          // the client sends one of these when connecting plus we return 1 on error to kill two birds with one stone
 
-            // we discard pong values of 1
-            // the client sends one of these when connecting plus we return 1 on error to kill two birds with one stone
+          if (Pong != 1)
+          {
+            // we also discard pong values when we're downloading because they're almost certainly inaccurate
+            // this statement also gives the player a 5 second grace period after downloading the map to allow queued (i.e. delayed) ping packets to be ignored
 
-            if (Pong != 1)
+            if (!m_DownloadStarted || (m_DownloadFinished && GetTime() - m_FinishedDownloadingTime >= 5))
             {
-              // we also discard pong values when we're downloading because they're almost certainly inaccurate
-              // this statement also gives the player a 5 second grace period after downloading the map to allow queued (i.e. delayed) ping packets to be ignored
+              // we also discard pong values when anyone else is downloading if we're configured to
 
-              if (!m_DownloadStarted || (m_DownloadFinished && GetTime() - m_FinishedDownloadingTime >= 5))
+              if (!m_Game->IsDownloading())
               {
-                // we also discard pong values when anyone else is downloading if we're configured to
+                m_Pings.push_back(GetTicks() - Pong);
 
-                if (!m_Game->IsDownloading())
-                {
-                  m_Pings.push_back(GetTicks() - Pong);
-
-                  if (m_Pings.size() > 10)
-                    m_Pings.erase(begin(m_Pings));
-                }
+                if (m_Pings.size() > 10)
+                  m_Pings.erase(begin(m_Pings));
               }
             }
+          }
 
-            m_Game->EventPlayerPongToHost(this);
-            break;
-          case CGameProtocol::W3GS_REFORGED_UNKNOWN:  //  TEST 2/2/2025
-			m_Game->SendAll(Data);
+          m_Game->EventPlayerPongToHost(this);
+          break;
+        case CGameProtocol::W3GS_REFORGED_UNKNOWN:  //  TEST 2/2/2025
+			m_Game->SendAll(std::vector<uint8_t>(begin(Data), end(Data)));
 			break;
 		}
-
-        LengthProcessed += Length;
-        Bytes = std::vector<uint8_t>(begin(Bytes) + Length, end(Bytes));
-      }
-      else
-        break;
     }
-    else if (Bytes[0] == GPS_HEADER_CONSTANT)
+    else if (Data[0] == GPS_HEADER_CONSTANT)
     {
-      if (Length >= 4)
+      if (Data[1] == CGPSProtocol::GPS_ACK && Data.size() == 8)
       {
-        if (Bytes.size() >= Length)
-        {
-          if (Bytes[1] == CGPSProtocol::GPS_ACK && Data.size() == 8)
-          {
-            const uint32_t LastPacket             = ByteArrayToUInt32(Data, false, 4);
-            const uint32_t PacketsAlreadyUnqueued = m_TotalPacketsSent - m_GProxyBuffer.size();
+        const uint32_t LastPacket             = ByteArrayToUInt32(Data, false, 4);
+        const uint32_t PacketsAlreadyUnqueued = m_TotalPacketsSent - m_GProxyBuffer.size();
 
-            if (LastPacket > PacketsAlreadyUnqueued)
-            {
-              uint32_t PacketsToUnqueue = LastPacket - PacketsAlreadyUnqueued;
+        if (LastPacket > PacketsAlreadyUnqueued)
+        {
+          uint32_t PacketsToUnqueue = LastPacket - PacketsAlreadyUnqueued;
 
-              if (PacketsToUnqueue > m_GProxyBuffer.size())
-                PacketsToUnqueue = m_GProxyBuffer.size();
+          if (PacketsToUnqueue > m_GProxyBuffer.size())
+            PacketsToUnqueue = m_GProxyBuffer.size();
 
-              while (PacketsToUnqueue > 0)
-              {
-                m_GProxyBuffer.pop();
-                --PacketsToUnqueue;
-              }
-            }
-          }
-          else if (Bytes[1] == CGPSProtocol::GPS_INIT)
+          while (PacketsToUnqueue > 0)
           {
-            m_GProxy = true;
-            m_Socket->PutBytes(m_Game->m_Aura->m_GPSProtocol->SEND_GPSS_INIT(m_Game->m_Aura->m_ReconnectPort, m_PID, m_GProxyReconnectKey, m_Game->GetGProxyEmptyActions()));
-            Print("[GAME: " + m_Game->GetGameName() + "] player [" + m_Name + "] is using GProxy++");
+            m_GProxyBuffer.pop();
+            --PacketsToUnqueue;
           }
         }
-
-        LengthProcessed += Length;
-        Bytes = std::vector<uint8_t>(begin(Bytes) + Length, end(Bytes));
       }
-      else
-        break;
+      else if (Data[1] == CGPSProtocol::GPS_INIT)
+      {
+        m_GProxy = true;
+        m_Socket->PutBytes(m_Game->m_Aura->m_GPSProtocol->SEND_GPSS_INIT(m_Game->m_Aura->m_ReconnectPort, m_PID, m_GProxyReconnectKey, m_Game->GetGProxyEmptyActions()));
+        Print("[GAME: " + m_Game->GetGameName() + "] player [" + m_Name + "] is using GProxy++");
+      }
     }
+    else
+      break;
+
+    RecvBuffer->Consume(Data.size());
   }
 
-  *RecvBuffer = RecvBuffer->substr(LengthProcessed);
+  // if the data doesn't look like W3GS or GPS packets we've lost track of the packet boundaries, there's no way to recover
+
+  if (m_Socket && !RecvBuffer->IsEmpty() && (RecvBuffer->HasBadPacket() || (RecvBuffer->GetData()[0] != W3GS_HEADER_CONSTANT && RecvBuffer->GetData()[0] != GPS_HEADER_CONSTANT)))
+    m_Socket->Disconnect();
 
   // try to find out why we're requesting deletion
   // in cases other than the ones covered here m_LeftReason should have been set when m_DeleteMe was set
@@ -428,7 +402,7 @@ bool CGamePlayer::Update(void* fd)
   return false;
 }
 
-void CGamePlayer::Send(const std::vector<uint8_t>& data)
+void CGamePlayer::Send(const CSharedBytes& data)
 {
   // must start counting packet total from beginning of connection
   // but we can avoid buffering packets until we know the client is using GProxy++ since that'll be determined before the game starts
@@ -439,9 +413,24 @@ void CGamePlayer::Send(const std::vector<uint8_t>& data)
   if (m_GProxy && m_Game->GetGameLoaded())
     m_GProxyBuffer.push(data);
 
+  m_Game->AddPacketOut(data->size());
+
   m_Socket->PutBytes(data);
 }
 
+void CGamePlayer::Send(std::vector<uint8_t>&& data)
+{
+  Send(make_shared<const std::vector<uint8_t>>(std::move(data)));
+}
+
+void CGamePlayer::Send(const std::vector<uint8_t>& data)
+{
+  // the buffer has to be copied to be shared, count it like the socket's own copies
+
+  CSendQueue::AddBytesCopied(data.size());
+  Send(make_shared<const std::vector<uint8_t>>(data));
+}
+
 void CGamePlayer::EventGProxyReconnect(CTCPSocket* NewSocket, uint32_t LastPacket)
 {
   delete m_Socket;
@@ -465,17 +454,18 @@ void CGamePlayer::EventGProxyReconnect(CTCPSocket* NewSocket, uint32_t LastPacke
   }
 
   // send remaining packets from buffer, preserve buffer
+  // the packets are shared so this only copies references
 
-  queue<std::vector<uint8_t>> TempBuffer;
+  queue<CSharedBytes> TempBuffer;
 
   while (!m_GProxyBuffer.empty())
   {
     m_Socket->PutBytes(m_GProxyBuffer.front());
-    TempBuffer.push(m_GProxyBuffer.front());
+    TempBuffer.push(std::move(m_GProxyBuffer.front()));
     m_GProxyBuffer.pop();
   }
 
-  m_GProxyBuffer               = TempBuffer;
+  m_GProxyBuffer.swap(TempBuffer);
   m_GProxyDisconnectNoticeSent = false;
   m_Game->SetStartedLaggingTime(0);
   m_Game->SendAllChat("Player [" + m_Name + "] reconnected with GProxy++!");
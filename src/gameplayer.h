@@ -87,7 +87,7 @@ private:
   std::vector<uint8_t>             m_InternalIP;                   // the player's internal IP address as reported by the player when connecting
   std::vector<uint32_t>            m_Pings;                        // store the last few (10) pings received so we can take an average
   std::queue<uint32_t>             m_CheckSums;                    // the last few checksums the player has sent (for detecting desyncs)
-  std::queue<std::vector<uint8_t>> m_GProxyBuffer;                 // buffer with data used with GProxy++
+  std::queue<CSharedBytes>         m_GProxyBuffer;                 // buffer with data used with GProxy++
   std::string                      m_LeftReason;                   // the reason the player left the game
   std::string                      m_SpoofedRealm;                 // the realm the player last spoof checked :wq
   std::string                      m_JoinedRealm;                  // the realm the player joined on (probable, can be spoofed)
@@ -99,6 +99,7 @@ private:
   int64_t                          m_JoinTime;                     // GetTime when the player joined the game (used to delay sending the /whois a few seconds to allow for some lag)
   uint32_t                         m_LastMapPartSent;              // the last mappart sent to the player (for sending more than one part at a time)
   uint32_t                         m_LastMapPartAcked;             // the last mappart acknowledged by the player
+  uint32_t                         m_MapWindow;                    // how many map bytes the player may have unacknowledged (see CGame :: UpdateMapDownloads)
   int64_t                          m_StartedDownloadingTicks;      // GetTicks when the player started downloading the map
   int64_t                          m_FinishedDownloadingTime;      // GetTime when the player finished downloading the map
   int64_t                          m_FinishedLoadingTicks;         // GetTicks when the player finished loading the game
@@ -149,6 +150,7 @@ public:
   inline int64_t               GetJoinTime() const { return m_JoinTime; }
   inline uint32_t              GetLastMapPartSent() const { return m_LastMapPartSent; }
   inline uint32_t              GetLastMapPartAcked() const { return m_LastMapPartAcked; }
+  inline uint32_t              GetMapWindow() const { return m_MapWindow; }
   inline int64_t               GetStartedDownloadingTicks() const { return m_StartedDownloadingTicks; }
   inline int64_t               GetFinishedDownloadingTime() const { return m_FinishedDownloadingTime; }
   inline int64_t               GetFinishedLoadingTicks() const { return m_FinishedLoadingTicks; }
@@ -156,6 +158,7 @@ public:
   inline int64_t               GetLastGProxyWaitNoticeSentTime() const { return m_LastGProxyWaitNoticeSentTime; }
   inline uint32_t              GetGProxyReconnectKey() const { return m_GProxyReconnectKey; }
   inline bool                  GetGProxy() const { return m_GProxy; }
+  inline uint32_t              GetGProxyBufferSize() const { return m_GProxyBuffer.size(); }
   inline bool                  GetGProxyDisconnectNoticeSent() const { return m_GProxyDisconnectNoticeSent; }
   inline bool                  GetSpoofed() const { return m_Spoofed; }
   inline bool                  GetReserved() const { return m_Reserved; }
@@ -178,6 +181,7 @@ public:
   inline void SetSyncCounter(uint32_t nSyncCounter) { m_SyncCounter = nSyncCounter; }
   inline void SetLastMapPartSent(uint32_t nLastMapPartSent) { m_LastMapPartSent = nLastMapPartSent; }
   inline void SetLastMapPartAcked(uint32_t nLastMapPartAcked) { m_LastMapPartAcked = nLastMapPartAcked; }
+  inline void SetMapWindow(uint32_t nMapWindow) { m_MapWindow = nMapWindow; }
   inline void SetStartedDownloadingTicks(uint64_t nStartedDownloadingTicks) { m_StartedDownloadingTicks = nStartedDownloadingTicks; }
   inline void SetFinishedDownloadingTime(uint64_t nFinishedDownloadingTime) { m_FinishedDownloadingTime = nFinishedDownloadingTime; }
   inline void SetStartedLaggingTicks(uint64_t nStartedLaggingTicks) { m_StartedLaggingTicks = nStartedLaggingTicks; }
@@ -201,6 +205,8 @@ public:
 
   // other functions
 
+  void Send(const CSharedBytes& data);
+  void Send(std::vector<uint8_t>&& data);
   void Send(const std::vector<uint8_t>& data);
   void EventGProxyReconnect(CTCPSocket* NewSocket, uint32_t LastPacket);
 };
@@ -27,6 +27,7 @@
 #include "gameplayer.h"
 #include "gameslot.h"
 #include "game.h"
+#include "map.h"
 
 using namespace std;
 
@@ -45,7 +46,7 @@ CGameProtocol::~CGameProtocol() = default;
 // RECEIVE FUNCTIONS //
 ///////////////////////
 
-CIncomingJoinPlayer* CGameProtocol::RECEIVE_W3GS_REQJOIN(const std::vector<uint8_t>& data)
+CIncomingJoinPlayer* CGameProtocol::RECEIVE_W3GS_REQJOIN(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED W3GS_REQJOIN" );
   // DEBUG_Print( data );
@@ -78,7 +79,7 @@ CIncomingJoinPlayer* CGameProtocol::RECEIVE_W3GS_REQJOIN(const std::vector<uint8
   return nullptr;
 }
 
-uint32_t CGameProtocol::RECEIVE_W3GS_LEAVEGAME(const std::vector<uint8_t>& data)
+uint32_t CGameProtocol::RECEIVE_W3GS_LEAVEGAME(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED W3GS_LEAVEGAME" );
   // DEBUG_Print( data );
@@ -93,7 +94,7 @@ uint32_t CGameProtocol::RECEIVE_W3GS_LEAVEGAME(const std::vector<uint8_t>& data)
   return 0;
 }
 
-bool CGameProtocol::RECEIVE_W3GS_GAMELOADED_SELF(const std::vector<uint8_t>& data)
+bool CGameProtocol::RECEIVE_W3GS_GAMELOADED_SELF(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED W3GS_GAMELOADED_SELF" );
   // DEBUG_Print( data );
@@ -107,7 +108,7 @@ bool CGameProtocol::RECEIVE_W3GS_GAMELOADED_SELF(const std::vector<uint8_t>& dat
   return false;
 }
 
-CIncomingAction* CGameProtocol::RECEIVE_W3GS_OUTGOING_ACTION(const std::vector<uint8_t>& data, uint8_t PID)
+bool CGameProtocol::RECEIVE_W3GS_OUTGOING_ACTION(const CByteSpan& data, uint8_t PID, CByteSpan* action)
 {
   // DEBUG_Print( "RECEIVED W3GS_OUTGOING_ACTION" );
   // DEBUG_Print( data );
@@ -119,15 +120,14 @@ CIncomingAction* CGameProtocol::RECEIVE_W3GS_OUTGOING_ACTION(const std::vector<u
 
   if (PID != 255 && ValidateLength(data) && data.size() >= 8)
   {
-    const std::vector<uint8_t> CRC    = std::vector<uint8_t>(begin(data) + 4, begin(data) + 8);
-    const std::vector<uint8_t> Action = std::vector<uint8_t>(begin(data) + 8, end(data));
-    return new CIncomingAction(PID, CRC, Action);
+    *action = CByteSpan(data.data() + 8, data.size() - 8);
+    return true;
   }
 
-  return nullptr;
+  return false;
 }
 
-uint32_t CGameProtocol::RECEIVE_W3GS_OUTGOING_KEEPALIVE(const std::vector<uint8_t>& data)
+uint32_t CGameProtocol::RECEIVE_W3GS_OUTGOING_KEEPALIVE(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED W3GS_OUTGOING_KEEPALIVE" );
   // DEBUG_Print( data );
@@ -143,7 +143,7 @@ uint32_t CGameProtocol::RECEIVE_W3GS_OUTGOING_KEEPALIVE(const std::vector<uint8_
   return 0;
 }
 
-CIncomingChatPlayer* CGameProtocol::RECEIVE_W3GS_CHAT_TO_HOST(const std::vector<uint8_t>& data)
+CIncomingChatPlayer* CGameProtocol::RECEIVE_W3GS_CHAT_TO_HOST(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED W3GS_CHAT_TO_HOST" );
   // DEBUG_Print( data );
@@ -210,7 +210,7 @@ CIncomingChatPlayer* CGameProtocol::RECEIVE_W3GS_CHAT_TO_HOST(const std::vector<
   return nullptr;
 }
 
-CIncomingMapSize* CGameProtocol::RECEIVE_W3GS_MAPSIZE(const std::vector<uint8_t>& data)
+CIncomingMapSize* CGameProtocol::RECEIVE_W3GS_MAPSIZE(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED W3GS_MAPSIZE" );
   // DEBUG_Print( data );
@@ -227,7 +227,7 @@ CIncomingMapSize* CGameProtocol::RECEIVE_W3GS_MAPSIZE(const std::vector<uint8_t>
   return nullptr;
 }
 //test 2/2/2025
-uint32_t CGameProtocol::RECEIVE_W3GS_MAPPARTOK(const std::vector<uint8_t>& data)
+uint32_t CGameProtocol::RECEIVE_W3GS_MAPPARTOK(const CByteSpan& data)
 {
 	// DEBUG_Print( "RECEIVED W3GS_MAPPARTOK" );
 	// DEBUG_Print( data );
@@ -245,7 +245,7 @@ uint32_t CGameProtocol::RECEIVE_W3GS_MAPPARTOK(const std::vector<uint8_t>& data)
   return 0;
 }
 
-uint32_t CGameProtocol::RECEIVE_W3GS_PONG_TO_HOST(const std::vector<uint8_t>& data)
+uint32_t CGameProtocol::RECEIVE_W3GS_PONG_TO_HOST(const CByteSpan& data)
 {
   // DEBUG_Print( "RECEIVED W3GS_PONG_TO_HOST" );
   // DEBUG_Print( data );
@@ -403,35 +403,24 @@ std::vector<uint8_t> CGameProtocol::SEND_W3GS_COUNTDOWN_END()
   return std::vector<uint8_t>{W3GS_HEADER_CONSTANT, W3GS_COUNTDOWN_END, 4, 0};
 }
 
-std::vector<uint8_t> CGameProtocol::SEND_W3GS_INCOMING_ACTION(queue<CIncomingAction*> actions, uint16_t sendInterval)
+std::vector<uint8_t> CGameProtocol::SEND_W3GS_INCOMING_ACTION(const CByteSpan& actions, uint16_t sendInterval)
 {
-  std::vector<uint8_t> packet = {W3GS_HEADER_CONSTANT, W3GS_INCOMING_ACTION, 0, 0};
-  AppendByteArray(packet, sendInterval, false); // send int32_terval
+  // the actions are already encoded as the subpacket (see CActionQueue)
 
-  // create subpacket
+  std::vector<uint8_t> packet;
+  packet.reserve(8 + actions.size());
+  packet.insert(end(packet), {W3GS_HEADER_CONSTANT, W3GS_INCOMING_ACTION, 0, 0});
+  AppendByteArray(packet, sendInterval, false); // send int32_terval
 
   if (!actions.empty())
   {
-    std::vector<uint8_t> subpacket;
-
-    do
-    {
-      CIncomingAction* Action = actions.front();
-      actions.pop();
-      subpacket.push_back(Action->GetPID());
-      AppendByteArray(subpacket, static_cast<uint16_t>(Action->GetAction()->size()), false);
-      AppendByteArrayFast(subpacket, *Action->GetAction());
-    } while (!actions.empty());
-
     // calculate crc (we only care about the first 2 bytes though)
 
-    std::vector<uint8_t> crc32 = CreateByteArray(m_Aura->m_CRC->CalculateCRC((uint8_t*)string(begin(subpacket), end(subpacket)).c_str(), subpacket.size()), false);
-    crc32.resize(2);
-
-    // finish subpacket
+    const uint32_t CRC = m_Aura->m_CRC->CalculateCRC(actions.data(), actions.size());
 
-    AppendByteArrayFast(packet, crc32);     // crc
-    AppendByteArrayFast(packet, subpacket); // subpacket
+    packet.push_back(static_cast<uint8_t>(CRC));      // crc
+    packet.push_back(static_cast<uint8_t>(CRC >> 8));
+    packet.insert(end(packet), begin(actions), end(actions)); // subpacket
   }
 
   AssignLength(packet);
@@ -577,29 +566,26 @@ std::vector<uint8_t> CGameProtocol::SEND_W3GS_STARTDOWNLOAD(uint8_t fromPID)
   return std::vector<uint8_t>{W3GS_HEADER_CONSTANT, W3GS_STARTDOWNLOAD, 9, 0, 1, 0, 0, 0, fromPID};
 }
 
-std::vector<uint8_t> CGameProtocol::SEND_W3GS_MAPPART(uint8_t fromPID, uint8_t toPID, uint32_t start, const string* mapData)
+std::vector<uint8_t> CGameProtocol::SEND_W3GS_MAPPART(uint8_t fromPID, uint8_t toPID, uint32_t start, const CByteSpan& mapData, uint32_t crc)
 {
-  if (start < mapData->size())
+  if (start < mapData.size())
   {
-    std::vector<uint8_t> packet = {W3GS_HEADER_CONSTANT, W3GS_MAPPART, 0, 0, toPID, fromPID, 1, 0, 0, 0};
-    AppendByteArray(packet, start, false); // start position
-
-    // calculate end position (don't send more than 1442 map bytes in one packet)
+    // calculate end position (don't send more than MAP_PART_SIZE map bytes in one packet)
 
-    uint32_t End = start + 1442;
+    uint32_t End = start + MAP_PART_SIZE;
 
-    if (End > mapData->size())
-      End = mapData->size();
+    if (End > mapData.size())
+      End = mapData.size();
 
-    // calculate crc
-
-    const std::vector<uint8_t> crc32 = CreateByteArray(m_Aura->m_CRC->CalculateCRC((uint8_t*)mapData->c_str() + start, End - start), false);
-    AppendByteArrayFast(packet, crc32);
+    std::vector<uint8_t> packet;
+    packet.reserve(18 + End - start);
+    packet.insert(end(packet), {W3GS_HEADER_CONSTANT, W3GS_MAPPART, 0, 0, toPID, fromPID, 1, 0, 0, 0});
+    AppendByteArray(packet, start, false); // start position
+    AppendByteArray(packet, crc, false);   // crc of the map part (see CMapFile)
 
-    // map data
+    // map data, straight from the mapped file
 
-    const std::vector<uint8_t> data = CreateByteArray((uint8_t*)mapData->c_str() + start, End - start);
-    AppendByteArrayFast(packet, data);
+    packet.insert(end(packet), mapData.data() + start, mapData.data() + End);
     AssignLength(packet);
     return packet;
   }
@@ -608,34 +594,23 @@ std::vector<uint8_t> CGameProtocol::SEND_W3GS_MAPPART(uint8_t fromPID, uint8_t t
   return std::vector<uint8_t>();
 }
 
-std::vector<uint8_t> CGameProtocol::SEND_W3GS_INCOMING_ACTION2(queue<CIncomingAction*> actions)
+std::vector<uint8_t> CGameProtocol::SEND_W3GS_INCOMING_ACTION2(const CByteSpan& actions)
 {
-  std::vector<uint8_t> packet = {W3GS_HEADER_CONSTANT, W3GS_INCOMING_ACTION2, 0, 0, 0, 0};
+  // the actions are already encoded as the subpacket (see CActionQueue)
 
-  // create subpacket
+  std::vector<uint8_t> packet;
+  packet.reserve(8 + actions.size());
+  packet.insert(end(packet), {W3GS_HEADER_CONSTANT, W3GS_INCOMING_ACTION2, 0, 0, 0, 0});
 
   if (!actions.empty())
   {
-    std::vector<uint8_t> subpacket;
-
-    while (!actions.empty())
-    {
-      CIncomingAction* Action = actions.front();
-      actions.pop();
-      subpacket.push_back(Action->GetPID());
-      AppendByteArray(subpacket, static_cast<uint16_t>(Action->GetAction()->size()), false);
-      AppendByteArrayFast(subpacket, *Action->GetAction());
-    }
-
     // calculate crc (we only care about the first 2 bytes though)
 
-    std::vector<uint8_t> crc32 = CreateByteArray(m_Aura->m_CRC->CalculateCRC((uint8_t*)string(begin(subpacket), end(subpacket)).c_str(), subpacket.size()), false);
-    crc32.resize(2);
+    const uint32_t CRC = m_Aura->m_CRC->CalculateCRC(actions.data(), actions.size());
 
-    // finish subpacket
-
-    AppendByteArrayFast(packet, crc32);     // crc
-    AppendByteArrayFast(packet, subpacket); // subpacket
+    packet.push_back(static_cast<uint8_t>(CRC));      // crc
+    packet.push_back(static_cast<uint8_t>(CRC >> 8));
+    packet.insert(end(packet), begin(actions), end(actions)); // subpacket
   }
 
   AssignLength(packet);
@@ -646,7 +621,7 @@ std::vector<uint8_t> CGameProtocol::SEND_W3GS_INCOMING_ACTION2(queue<CIncomingAc
 // OTHER FUNCTIONS //
 /////////////////////
 
-bool CGameProtocol::ValidateLength(const std::vector<uint8_t>& content)
+bool CGameProtocol::ValidateLength(const CByteSpan& content)
 {
   // verify that bytes 3 and 4 (indices 2 and 3) of the content array describe the length
 
@@ -682,17 +657,37 @@ CIncomingJoinPlayer::CIncomingJoinPlayer(uint32_t nHostCounter, uint32_t nEntryK
 CIncomingJoinPlayer::~CIncomingJoinPlayer() = default;
 
 //
-// CIncomingAction
+// CActionQueue
 //
 
-CIncomingAction::CIncomingAction(uint8_t nPID, std::vector<uint8_t> nCRC, std::vector<uint8_t> nAction)
-  : m_CRC(std::move(nCRC)),
-    m_Action(std::move(nAction)),
-    m_PID(nPID)
+CActionQueue::CActionQueue() = default;
+
+CActionQueue::~CActionQueue() = default;
+
+void CActionQueue::Push(uint8_t PID, const CByteSpan& action)
 {
+  m_Data.push_back(PID);
+  m_Data.push_back(static_cast<uint8_t>(action.size()));
+  m_Data.push_back(static_cast<uint8_t>(action.size() >> 8));
+  m_Data.insert(end(m_Data), begin(action), end(action));
 }
 
-CIncomingAction::~CIncomingAction() = default;
+uint32_t CActionQueue::GetFrameEnd(uint32_t start, uint32_t maxSize) const
+{
+  uint32_t End = start;
+
+  while (End < m_Data.size())
+  {
+    const uint32_t Length = 3 + (m_Data[End + 1] | m_Data[End + 2] << 8);
+
+    if (End > start && End + Length - start > maxSize)
+      break;
+
+    End += Length;
+  }
+
+  return End;
+}
 
 //
 // CIncomingChatPlayer
@@ -53,9 +53,10 @@
 #define REJECTJOIN_WRONGPASSWORD 27
 
 class CAura;
+class CByteSpan;
 class CGamePlayer;
 class CIncomingJoinPlayer;
-class CIncomingAction;
+class CActionQueue;
 class CIncomingChatPlayer;
 class CIncomingMapSize;
 class CGameSlot;
@@ -112,15 +113,15 @@ public:
 
   // receive functions
 
-  CIncomingJoinPlayer* RECEIVE_W3GS_REQJOIN(const std::vector<uint8_t>& data);
-  uint32_t RECEIVE_W3GS_LEAVEGAME(const std::vector<uint8_t>& data);
-  bool RECEIVE_W3GS_GAMELOADED_SELF(const std::vector<uint8_t>& data);
-  CIncomingAction* RECEIVE_W3GS_OUTGOING_ACTION(const std::vector<uint8_t>& data, uint8_t PID);
-  uint32_t RECEIVE_W3GS_OUTGOING_KEEPALIVE(const std::vector<uint8_t>& data);
-  CIncomingChatPlayer* RECEIVE_W3GS_CHAT_TO_HOST(const std::vector<uint8_t>& data);
-  CIncomingMapSize* RECEIVE_W3GS_MAPSIZE(const std::vector<uint8_t>& data);
-  uint32_t RECEIVE_W3GS_MAPPARTOK(const std::vector<uint8_t>& data );     // test 2/2/2025
-  uint32_t RECEIVE_W3GS_PONG_TO_HOST(const std::vector<uint8_t>& data);
+  CIncomingJoinPlayer* RECEIVE_W3GS_REQJOIN(const CByteSpan& data);
+  uint32_t RECEIVE_W3GS_LEAVEGAME(const CByteSpan& data);
+  bool RECEIVE_W3GS_GAMELOADED_SELF(const CByteSpan& data);
+  bool RECEIVE_W3GS_OUTGOING_ACTION(const CByteSpan& data, uint8_t PID, CByteSpan* action);
+  uint32_t RECEIVE_W3GS_OUTGOING_KEEPALIVE(const CByteSpan& data);
+  CIncomingChatPlayer* RECEIVE_W3GS_CHAT_TO_HOST(const CByteSpan& data);
+  CIncomingMapSize* RECEIVE_W3GS_MAPSIZE(const CByteSpan& data);
+  uint32_t RECEIVE_W3GS_MAPPARTOK(const CByteSpan& data );     // test 2/2/2025
+  uint32_t RECEIVE_W3GS_PONG_TO_HOST(const CByteSpan& data);
 
   // send functions
 
@@ -133,8 +134,8 @@ public:
   std::vector<uint8_t> SEND_W3GS_SLOTINFO(std::vector<CGameSlot>& slots, uint32_t randomSeed, uint8_t layoutStyle, uint8_t playerSlots);
   std::vector<uint8_t> SEND_W3GS_COUNTDOWN_START();
   std::vector<uint8_t> SEND_W3GS_COUNTDOWN_END();
-  std::vector<uint8_t> SEND_W3GS_INCOMING_ACTION(std::queue<CIncomingAction*> actions, uint16_t sendInterval);
-  std::vector<uint8_t> SEND_W3GS_INCOMING_ACTION2(std::queue<CIncomingAction*> actions);
+  std::vector<uint8_t> SEND_W3GS_INCOMING_ACTION(const CByteSpan& actions, uint16_t sendInterval);
+  std::vector<uint8_t> SEND_W3GS_INCOMING_ACTION2(const CByteSpan& actions);
   std::vector<uint8_t> SEND_W3GS_CHAT_FROM_HOST(uint8_t fromPID, const std::vector<uint8_t>& toPIDs, uint8_t flag, const std::vector<uint8_t>& flagExtra, const std::string& message);
   std::vector<uint8_t> SEND_W3GS_START_LAG(std::vector<CGamePlayer*> players);
   std::vector<uint8_t> SEND_W3GS_STOP_LAG(CGamePlayer* player);
@@ -144,12 +145,12 @@ public:
   std::vector<uint8_t> SEND_W3GS_DECREATEGAME();
   std::vector<uint8_t> SEND_W3GS_MAPCHECK(const std::string& mapPath, const std::vector<uint8_t>& mapSize, const std::vector<uint8_t>& mapInfo, const std::vector<uint8_t>& mapCRC, const std::vector<uint8_t>& mapSHA1);
   std::vector<uint8_t> SEND_W3GS_STARTDOWNLOAD(uint8_t fromPID);
-  std::vector<uint8_t> SEND_W3GS_MAPPART(uint8_t fromPID, uint8_t toPID, uint32_t start, const std::string* mapData);
+  std::vector<uint8_t> SEND_W3GS_MAPPART(uint8_t fromPID, uint8_t toPID, uint32_t start, const CByteSpan& mapData, uint32_t crc);
 
   // other functions
 
 private:
-  bool ValidateLength(const std::vector<uint8_t>& content);
+  bool ValidateLength(const CByteSpan& content);
   std::vector<uint8_t> EncodeSlotInfo(const std::vector<CGameSlot>& slots, uint32_t randomSeed, uint8_t layoutStyle, uint8_t playerSlots);
 };
 
@@ -176,24 +177,33 @@ public:
 };
 
 //
-// CIncomingAction
+// CActionQueue
 //
 
-class CIncomingAction
+// the player actions waiting to be sent in the next W3GS_INCOMING_ACTION packet(s)
+// they're stored back to back already encoded the way the packet wants them (PID, 16 bit length, action) so sending them is a single copy
+// the buffer keeps its capacity when it's cleared so after the first few action packets queueing an action doesn't allocate
+
+class CActionQueue final
 {
 private:
-  std::vector<uint8_t> m_CRC;
-  std::vector<uint8_t> m_Action;
-  uint8_t              m_PID;
+  std::vector<uint8_t> m_Data;
 
 public:
-  CIncomingAction(uint8_t nPID, std::vector<uint8_t> nCRC, std::vector<uint8_t> nAction);
-  ~CIncomingAction();
+  CActionQueue();
+  ~CActionQueue();
+
+  inline const uint8_t* GetData() const { return m_Data.data(); }
+  inline uint32_t       GetSize() const { return m_Data.size(); }
+  inline bool           IsEmpty() const { return m_Data.empty(); }
+  inline void           Clear() { m_Data.clear(); }
+
+  void Push(uint8_t PID, const CByteSpan& action);
+
+  // returns the end of the longest run of whole actions starting at offset start which is no longer than maxSize
+  // (the first action is always included even if it's longer on its own)
 
-  inline uint8_t               GetPID() const { return m_PID; }
-  inline std::vector<uint8_t>  GetCRC() const { return m_CRC; }
-  inline std::vector<uint8_t>* GetAction() { return &m_Action; }
-  inline uint32_t              GetLength() const { return m_Action.size() + 3; }
+  uint32_t GetFrameEnd(uint32_t start, uint32_t maxSize) const;
 };
 
 //
@@ -0,0 +1,243 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+#include "gameworker.h"
+#include "aura.h"
+#include "socket.h"
+#include "game.h"
+#include "gameplayer.h"
+#include "includes.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+//
+// CGameWorker
+//
+
+CGameWorker::CGameWorker(CAura* nAura, uint32_t nID)
+  : m_Aura(nAura),
+    m_Exiting(false),
+    m_NumGames(0),
+    m_ID(nID)
+{
+  m_Thread = thread(&CGameWorker::Run, this);
+}
+
+CGameWorker::~CGameWorker()
+{
+  m_Exiting = true;
+
+  if (m_Thread.joinable())
+    m_Thread.join();
+}
+
+void CGameWorker::QueueTask(function<void()> task)
+{
+  lock_guard<mutex> Lock(m_TasksMutex);
+  m_Tasks.push_back(std::move(task));
+}
+
+void CGameWorker::ProcessTasks()
+{
+  vector<function<void()>> Tasks;
+
+  {
+    lock_guard<mutex> Lock(m_TasksMutex);
+    Tasks.swap(m_Tasks);
+  }
+
+  for (auto& task : Tasks)
+    task();
+}
+
+void CGameWorker::AdoptGame(CGame* game)
+{
+  // the game's sockets and timers belong to the main thread, take them out before the worker adds them to its own poller and wheel
+
+  game->SetPoller(nullptr);
+  game->SetTimerWheel(nullptr);
+  game->SetWorker(this);
+  ++m_NumGames;
+
+  QueueTask([this, game]() {
+    game->SetPoller(CSocketPoller::GetDefault());
+    game->SetTimerWheel(CTimerWheel::GetDefault());
+    m_Games.push_back(game);
+  });
+}
+
+void CGameWorker::DeleteGame(CGame* game)
+{
+  // the main thread has already announced the game is over and forgotten about it
+  // delete it here so the database writes in the destructor don't stall the main thread
+
+  --m_NumGames;
+
+  QueueTask([game]() {
+    delete game;
+  });
+}
+
+void CGameWorker::GProxyReconnect(CGame* game, CTCPSocket* socket, uint8_t PID, uint32_t reconnectKey, uint32_t lastPacket)
+{
+  socket->Register(nullptr);
+
+  QueueTask([this, game, socket, PID, reconnectKey, lastPacket]() {
+    socket->Register(CSocketPoller::GetDefault());
+
+    // the game may have ended or the player may have left while this task was queued
+
+    CGamePlayer* Match = nullptr;
+
+    if (find(begin(m_Games), end(m_Games), game) != end(m_Games))
+    {
+      lock_guard<mutex> Lock(game->GetMutex());
+      CGamePlayer*      Player = game->GetPlayerFromPID(PID);
+
+      if (Player && Player->GetGProxy() && Player->GetGProxyReconnectKey() == reconnectKey)
+      {
+        Match = Player;
+        Match->EventGProxyReconnect(socket, lastPacket);
+      }
+    }
+
+    if (!Match)
+      delete socket;
+  });
+}
+
+void CGameWorker::Run()
+{
+  Print("[WORKER " + to_string(m_ID) + "] started");
+
+  CSocketPoller* Poller = CSocketPoller::GetDefault();
+  CTimerWheel*   Wheel  = CTimerWheel::GetDefault();
+
+  while (!m_Exiting)
+  {
+    ProcessTasks();
+
+    fd_set fd, send_fd;
+    FD_ZERO(&fd);
+    FD_ZERO(&send_fd);
+
+    // block until the next timer is due, 50 ms is the hard maximum
+
+    int64_t       usecBlock    = 50000;
+    const int64_t NextDeadline = Wheel->GetNextDeadline();
+
+    if (NextDeadline != -1)
+      usecBlock = max<int64_t>(0, min<int64_t>(usecBlock, (NextDeadline - GetTicks()) * 1000));
+
+#ifdef AURA_EPOLL
+    // we may not have been handed a game yet, don't spin if there's nothing to block on
+
+    if (Poller->GetNumSockets() > 0)
+      Poller->Wait(usecBlock);
+    else
+      this_thread::sleep_for(chrono::microseconds(usecBlock));
+#else
+    uint32_t NumFDs = 0;
+    int32_t  nfds   = 0;
+
+    for (auto& game : m_Games)
+    {
+      lock_guard<mutex> Lock(game->GetMutex());
+      NumFDs += game->SetFD(&fd, &send_fd, &nfds);
+    }
+
+    struct timeval tv;
+    tv.tv_sec  = 0;
+    tv.tv_usec = static_cast<long int>(usecBlock);
+
+    struct timeval send_tv;
+    send_tv.tv_sec  = 0;
+    send_tv.tv_usec = 0;
+
+    // we may not have been handed a game yet, don't spin if there's nothing to block on
+
+    if (NumFDs == 0)
+      this_thread::sleep_for(chrono::microseconds(usecBlock));
+    else
+    {
+#ifdef WIN32
+      select(1, &fd, nullptr, nullptr, &tv);
+      select(1, nullptr, &send_fd, nullptr, &send_tv);
+#else
+      select(nfds + 1, &fd, nullptr, nullptr, &tv);
+      select(nfds + 1, nullptr, &send_fd, nullptr, &send_tv);
+#endif
+    }
+#endif
+
+    for (auto i = begin(m_Games); i != end(m_Games);)
+    {
+      CGame* Game = *i;
+      bool   Over;
+
+      {
+        lock_guard<mutex> Lock(Game->GetMutex());
+        Over = Game->Update(&fd, &send_fd);
+      }
+
+      if (Over)
+      {
+        // the main thread announces the game is over and then hands it back to us for deletion
+        // stop polling its sockets now since the game may outlive this thread if we're shutting down
+
+        Game->SetPoller(nullptr);
+        Game->SetTimerWheel(nullptr);
+        i = m_Games.erase(i);
+        m_Aura->QueueEvent([this, Game]() { m_Aura->EventWorkerGameOver(this, Game); });
+      }
+      else
+        ++i;
+    }
+
+    // run the timers that are due (e.g. sending the action packets) and then flush the games' send buffers
+
+    Wheel->Advance(GetTicks());
+
+    for (auto& game : m_Games)
+    {
+      lock_guard<mutex> Lock(game->GetMutex());
+      game->UpdatePost(&send_fd);
+    }
+  }
+
+  // we're shutting down, finish any queued work and give the sockets back
+  // the poller and the timer wheel belong to this thread and are destroyed with it, the main thread deletes any games that are left
+
+  ProcessTasks();
+
+  for (auto& game : m_Games)
+  {
+    lock_guard<mutex> Lock(game->GetMutex());
+    game->SetPoller(nullptr);
+    game->SetTimerWheel(nullptr);
+  }
+
+  m_Games.clear();
+
+  Print("[WORKER " + to_string(m_ID) + "] stopped");
+}
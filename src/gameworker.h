@@ -0,0 +1,75 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+#ifndef AURA_GAMEWORKER_H_
+#define AURA_GAMEWORKER_H_
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+
+//
+// CGameWorker
+//
+
+// a thread that updates games which have left the lobby (see bot_gamethreads)
+// each worker owns its games and their sockets, the sockets are registered with the worker's own poller
+// the main thread only talks to a worker by queueing tasks and the worker talks back with CAura :: QueueEvent
+// anything else the main thread does with a game it owns has to hold the game's mutex
+
+class CAura;
+class CGame;
+class CTCPSocket;
+
+class CGameWorker final
+{
+private:
+  CAura*                             m_Aura;
+  std::vector<CGame*>                m_Games;       // the games owned by this worker (only touched by the worker thread)
+  std::vector<std::function<void()>> m_Tasks;       // tasks queued by the main thread, protected by m_TasksMutex
+  std::mutex                         m_TasksMutex;
+  std::thread                        m_Thread;
+  std::atomic<bool>                  m_Exiting;
+  uint32_t                           m_NumGames;    // the number of games assigned to this worker (only touched by the main thread)
+  uint32_t                           m_ID;
+
+  void Run();
+  void ProcessTasks();
+  void QueueTask(std::function<void()> task);
+
+public:
+  CGameWorker(CAura* nAura, uint32_t nID);
+  ~CGameWorker();
+  CGameWorker(CGameWorker&) = delete;
+
+  inline uint32_t GetNumGames() const { return m_NumGames; }
+  inline uint32_t GetID() const { return m_ID; }
+
+  // these are called by the main thread
+
+  void AdoptGame(CGame* game);
+  void DeleteGame(CGame* game);
+  void GProxyReconnect(CGame* game, CTCPSocket* socket, uint8_t PID, uint32_t reconnectKey, uint32_t lastPacket);
+};
+
+#endif // AURA_GAMEWORKER_H_
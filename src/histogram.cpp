@@ -0,0 +1,137 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+
+#include "histogram.h"
+
+#include <cstring>
+
+using namespace std;
+
+//
+// CHistogram
+//
+
+CHistogram::CHistogram()
+{
+  Reset();
+}
+
+CHistogram::~CHistogram() = default;
+
+uint32_t CHistogram::GetBucket(uint64_t value)
+{
+  if (value < LINEAR_BUCKETS)
+    return static_cast<uint32_t>(value);
+
+  if (value >= (static_cast<uint64_t>(1) << MAX_VALUE_BITS))
+    return NUM_BUCKETS - 1;
+
+  // the position of the highest set bit picks the power of two range, the next SUB_BUCKET_BITS bits pick the bucket within it
+
+  uint32_t Magnitude = 0;
+
+  for (uint64_t v = value >> 1; v != 0; v >>= 1)
+    ++Magnitude;
+
+  const uint32_t Shift = Magnitude - SUB_BUCKET_BITS;
+  return LINEAR_BUCKETS + (Magnitude - SUB_BUCKET_BITS - 1) * SUB_BUCKETS + static_cast<uint32_t>((value >> Shift) - SUB_BUCKETS);
+}
+
+uint64_t CHistogram::GetBucketHighValue(uint32_t bucket)
+{
+  if (bucket < LINEAR_BUCKETS)
+    return bucket;
+
+  const uint32_t Magnitude = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + SUB_BUCKET_BITS + 1;
+  const uint32_t Shift     = Magnitude - SUB_BUCKET_BITS;
+  const uint64_t Low       = static_cast<uint64_t>(SUB_BUCKETS + (bucket - LINEAR_BUCKETS) % SUB_BUCKETS) << Shift;
+  return Low + (static_cast<uint64_t>(1) << Shift) - 1;
+}
+
+void CHistogram::Record(int64_t value)
+{
+  const uint64_t Value = value < 0 ? 0 : static_cast<uint64_t>(value);
+
+  ++m_Counts[GetBucket(Value)];
+  ++m_Count;
+  m_Sum += Value;
+
+  if (Value < m_Min)
+    m_Min = Value;
+
+  if (Value > m_Max)
+    m_Max = Value;
+}
+
+void CHistogram::Merge(const CHistogram& other)
+{
+  for (uint32_t i = 0; i < NUM_BUCKETS; ++i)
+    m_Counts[i] += other.m_Counts[i];
+
+  m_Count += other.m_Count;
+  m_Sum += other.m_Sum;
+
+  if (other.m_Min < m_Min)
+    m_Min = other.m_Min;
+
+  if (other.m_Max > m_Max)
+    m_Max = other.m_Max;
+}
+
+void CHistogram::Reset()
+{
+  memset(m_Counts, 0, sizeof(m_Counts));
+  m_Count = 0;
+  m_Sum   = 0;
+  m_Min   = UINT64_MAX;
+  m_Max   = 0;
+}
+
+uint64_t CHistogram::GetValueAtPercentile(double percentile) const
+{
+  if (m_Count == 0)
+    return 0;
+
+  // the smallest value which at least percentile % of the recorded values are less than or equal to
+  // we only know which bucket it's in so report the top of the bucket (but never more than the largest value we've actually seen)
+
+  uint64_t Target = static_cast<uint64_t>(percentile / 100.0 * m_Count + 0.5);
+
+  if (Target == 0)
+    Target = 1;
+
+  uint64_t Seen = 0;
+
+  for (uint32_t i = 0; i < NUM_BUCKETS; ++i)
+  {
+    Seen += m_Counts[i];
+
+    if (Seen >= Target)
+      return min(GetBucketHighValue(i), m_Max);
+  }
+
+  return m_Max;
+}
+
+string CHistogram::GetSummary(const string& unit) const
+{
+  return "n=" + to_string(m_Count) + " min=" + to_string(GetMin()) + " p50=" + to_string(GetValueAtPercentile(50)) + " p90=" + to_string(GetValueAtPercentile(90)) + " p99=" + to_string(GetValueAtPercentile(99)) + " p99.9=" + to_string(GetValueAtPercentile(99.9)) + " max=" + to_string(m_Max) + " mean=" + to_string(GetMean()) + " (" + unit + ")";
+}
@@ -0,0 +1,104 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+
+#ifndef AURA_HISTOGRAM_H_
+#define AURA_HISTOGRAM_H_
+
+#include "includes.h"
+
+#include <cstdint>
+#include <string>
+
+//
+// CHistogram
+//
+
+// a fixed size log-linear histogram in the style of HdrHistogram for latencies and durations
+// values below 32 get a bucket each, above that every power of two range is split into 16 buckets so percentiles are within ~6% of the true value
+// recording is a few shifts and an increment so it's cheap enough to do on every update, values above 2^40 are clamped
+
+class CHistogram final
+{
+private:
+  static const uint32_t SUB_BUCKET_BITS = 4;
+  static const uint32_t SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+  static const uint32_t LINEAR_BUCKETS  = 2 * SUB_BUCKETS;
+  static const uint32_t MAX_VALUE_BITS  = 40;
+  static const uint32_t NUM_BUCKETS     = LINEAR_BUCKETS + (MAX_VALUE_BITS - SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+
+  uint64_t m_Counts[NUM_BUCKETS];
+  uint64_t m_Count;
+  uint64_t m_Sum;
+  uint64_t m_Min;
+  uint64_t m_Max;
+
+  static uint32_t GetBucket(uint64_t value);
+  static uint64_t GetBucketHighValue(uint32_t bucket);
+
+public:
+  CHistogram();
+  ~CHistogram();
+
+  inline uint64_t GetCount() const { return m_Count; }
+  inline uint64_t GetMin() const { return m_Count ? m_Min : 0; }
+  inline uint64_t GetMax() const { return m_Max; }
+  inline uint64_t GetSum() const { return m_Sum; }
+  inline uint64_t GetMean() const { return m_Count ? m_Sum / m_Count : 0; }
+
+  void     Record(int64_t value); // negative values are recorded as 0
+  void     Merge(const CHistogram& other);
+  void     Reset();
+  uint64_t GetValueAtPercentile(double percentile) const;
+
+  // e.g. "n=1200 min=3 p50=12 p90=20 p99=41 p99.9=88 max=95 mean=13 (ms)"
+
+  std::string GetSummary(const std::string& unit) const;
+};
+
+//
+// CHistogramTimer
+//
+
+// records the microseconds between its construction and destruction, handy for functions with more than one return
+
+class CHistogramTimer final
+{
+private:
+  CHistogram* m_Histogram;
+  int64_t     m_Start;
+
+public:
+  explicit CHistogramTimer(CHistogram* nHistogram)
+    : m_Histogram(nHistogram),
+      m_Start(GetMicroTicks())
+  {
+  }
+
+  ~CHistogramTimer()
+  {
+    m_Histogram->Record(GetMicroTicks() - m_Start);
+  }
+
+  CHistogramTimer(CHistogramTimer&) = delete;
+  CHistogramTimer& operator=(CHistogramTimer&) = delete;
+};
+
+#endif // AURA_HISTOGRAM_H_
@@ -42,18 +42,25 @@ inline int64_t GetTicks()
   return std::chrono::duration_cast<std::chrono::milliseconds>(time_now.time_since_epoch()).count();
 }
 
-// output
-
-inline void Print(const std::string& message) // outputs to console
+inline int64_t GetMicroTicks()
 {
-  std::cout << message << std::endl;
+  const std::chrono::steady_clock::time_point time_now = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(time_now.time_since_epoch()).count();
 }
 
-inline void Print(const char* message)
-{
-  std::cout << message << std::endl;
-}
+// output
+// the messages are queued for the logging thread (see CLogger) so printing never blocks on the console or the log file
 
-void Print2(const std::string& message); // outputs to console and irc
+enum LogLevel : uint8_t
+{
+  LOG_ERROR = 0,
+  LOG_WARNING,
+  LOG_INFO,
+  LOG_DEBUG
+};
+
+void Print(const std::string& message, LogLevel level = LOG_INFO);  // outputs to console
+void Print2(const std::string& message, LogLevel level = LOG_INFO); // outputs to console and irc
+bool IsLogEnabled(LogLevel level);
 
 #endif // AURA_INCLUDES_H_
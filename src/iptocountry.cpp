@@ -0,0 +1,235 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+#include "iptocountry.h"
+#include "csvparser.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+#define IPTOCOUNTRY_MAGIC 0x31435049 // "IPC1" on little endian machines, the cache isn't portable so a different byte order just fails the check
+
+struct CIPToCountryHeader
+{
+  uint32_t Magic;
+  uint32_t Count;
+  uint64_t SourceSize;     // the size of the csv the cache was built from
+  int64_t  SourceModified; // the modification time of the csv the cache was built from
+};
+
+static_assert(sizeof(CIPToCountryHeader) == 24, "the arrays following the header must be aligned");
+
+//
+// CIPToCountry
+//
+
+CIPToCountry::CIPToCountry()
+  : m_Starts(nullptr),
+    m_Ends(nullptr),
+    m_Countries(nullptr),
+    m_Count(0)
+{
+}
+
+CIPToCountry::~CIPToCountry() = default;
+
+bool CIPToCountry::Use(const uint8_t* data, uint32_t size, uint64_t sourceSize, int64_t sourceModified, bool checkSource)
+{
+  CIPToCountryHeader Header;
+
+  if (size < sizeof(Header))
+    return false;
+
+  memcpy(&Header, data, sizeof(Header));
+
+  if (Header.Magic != IPTOCOUNTRY_MAGIC || size != sizeof(Header) + static_cast<uint64_t>(Header.Count) * 10)
+    return false;
+
+  if (checkSource && (Header.SourceSize != sourceSize || Header.SourceModified != sourceModified))
+    return false;
+
+  m_Starts    = reinterpret_cast<const uint32_t*>(data + sizeof(Header));
+  m_Ends      = m_Starts + Header.Count;
+  m_Countries = reinterpret_cast<const char*>(m_Ends + Header.Count);
+  m_Count     = Header.Count;
+  return true;
+}
+
+bool CIPToCountry::Build(const string& csvFile, uint64_t sourceSize, int64_t sourceModified)
+{
+  ifstream in;
+  in.open(csvFile);
+
+  if (in.fail())
+    return false;
+
+  struct CRange
+  {
+    uint32_t Start;
+    uint32_t End;
+    char     Country[2];
+  };
+
+  vector<CRange> Ranges;
+  string         Line, Skip, IP1, IP2, Country;
+  CSVParser      parser;
+
+  while (getline(in, Line))
+  {
+    if (Line.empty())
+      continue;
+
+    parser << Line;
+    parser >> Skip;
+    parser >> Skip;
+    parser >> IP1;
+    parser >> IP2;
+    parser >> Country;
+
+    // skip anything that isn't a range (e.g. a header line) instead of throwing
+
+    try
+    {
+      CRange Range;
+      Range.Start      = stoul(IP1);
+      Range.End        = stoul(IP2);
+      Range.Country[0] = Country.size() > 0 ? Country[0] : '?';
+      Range.Country[1] = Country.size() > 1 ? Country[1] : '?';
+
+      if (Range.Start <= Range.End)
+        Ranges.push_back(Range);
+    }
+    catch (...)
+    {
+    }
+  }
+
+  in.close();
+
+  sort(begin(Ranges), end(Ranges), [](const CRange& a, const CRange& b) { return a.Start < b.Start; });
+
+  CIPToCountryHeader Header;
+  Header.Magic          = IPTOCOUNTRY_MAGIC;
+  Header.Count          = static_cast<uint32_t>(Ranges.size());
+  Header.SourceSize     = sourceSize;
+  Header.SourceModified = sourceModified;
+
+  m_Data.resize(sizeof(Header) + Ranges.size() * 10);
+  memcpy(m_Data.data(), &Header, sizeof(Header));
+
+  uint32_t* Starts    = reinterpret_cast<uint32_t*>(m_Data.data() + sizeof(Header));
+  uint32_t* Ends      = Starts + Ranges.size();
+  char*     Countries = reinterpret_cast<char*>(Ends + Ranges.size());
+
+  for (uint32_t i = 0; i < Ranges.size(); ++i)
+  {
+    Starts[i]            = Ranges[i].Start;
+    Ends[i]              = Ranges[i].End;
+    Countries[i * 2]     = Ranges[i].Country[0];
+    Countries[i * 2 + 1] = Ranges[i].Country[1];
+  }
+
+  return Use(m_Data.data(), static_cast<uint32_t>(m_Data.size()), sourceSize, sourceModified, true);
+}
+
+bool CIPToCountry::Load(const string& csvFile, const string& cacheFile)
+{
+  uint64_t   SourceSize     = 0;
+  int64_t    SourceModified = 0;
+  const bool HasSource      = FileStat(csvFile, &SourceSize, &SourceModified);
+
+  // the cache can be used on its own, e.g. when only the cache was copied to another machine
+
+  if (FileExists(cacheFile) && m_File.Open(cacheFile))
+  {
+    if (Use(m_File.data(), m_File.size(), SourceSize, SourceModified, HasSource))
+    {
+      Print("[IPTOCOUNTRY] loaded " + to_string(m_Count) + " ranges from [" + cacheFile + "]");
+      return true;
+    }
+
+    m_File.Close();
+  }
+
+  if (!HasSource)
+  {
+    Print("[IPTOCOUNTRY] warning - unable to read file [" + csvFile + "], iptocountry data not loaded", LOG_WARNING);
+    return false;
+  }
+
+  Print("[IPTOCOUNTRY] started loading [" + csvFile + "]");
+
+  if (!Build(csvFile, SourceSize, SourceModified))
+  {
+    Print("[IPTOCOUNTRY] warning - unable to read file [" + csvFile + "], iptocountry data not loaded", LOG_WARNING);
+    return false;
+  }
+
+  Print("[IPTOCOUNTRY] finished loading " + to_string(m_Count) + " ranges from [" + csvFile + "]");
+
+  // write to a temporary file and rename it over the cache so another process mapping the old cache isn't affected
+
+  const string TempFile = cacheFile + ".tmp";
+
+  if (!FileWrite(TempFile, m_Data.data(), static_cast<uint32_t>(m_Data.size())))
+    return true;
+
+#ifdef WIN32
+  // rename doesn't replace existing files on windows
+
+  remove(cacheFile.c_str());
+#endif
+
+  if (rename(TempFile.c_str(), cacheFile.c_str()) != 0)
+    Print("[IPTOCOUNTRY] warning - unable to write cache [" + cacheFile + "]", LOG_WARNING);
+
+  return true;
+}
+
+string CIPToCountry::Find(uint32_t ip) const
+{
+  if (!m_Count)
+    return "??";
+
+  // find the last range starting at or before ip
+  // the loop always runs log2(m_Count) times and the comparison compiles to a conditional move so there's nothing to mispredict
+
+  const uint32_t* Base = m_Starts;
+  uint32_t        N    = m_Count;
+
+  while (N > 1)
+  {
+    const uint32_t Half = N / 2;
+    Base                = Base[Half] <= ip ? Base + Half : Base;
+    N -= Half;
+  }
+
+  const uint32_t i = static_cast<uint32_t>(Base - m_Starts);
+
+  if (*Base > ip || m_Ends[i] < ip)
+    return "??";
+
+  return string(m_Countries + i * 2, 2);
+}
@@ -0,0 +1,69 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+#ifndef AURA_IPTOCOUNTRY_H_
+#define AURA_IPTOCOUNTRY_H_
+
+#include "fileutil.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// CIPToCountry
+//
+
+// maps IPv4 addresses to two letter country codes using the ranges in ip-to-country.csv
+// parsing the csv is slow so the ranges are sorted once and saved to a binary cache file next to it, which is simply mapped on later startups
+// the cache is rebuilt whenever the csv's size or modification time no longer match the ones it was built from
+// the cache file is laid out as a header followed by three arrays: the range starts, the range ends and the country codes (two bytes each)
+// the lookups only read the mapped arrays so they're safe from any thread
+
+class CIPToCountry final
+{
+private:
+  CMappedFile          m_File;      // the cache file, unless it was just built (the ranges are in m_Data then)
+  std::vector<uint8_t> m_Data;      // the cache built by this process
+  const uint32_t*      m_Starts;    // the first ip of each range, sorted
+  const uint32_t*      m_Ends;      // the last ip of each range
+  const char*          m_Countries; // the country code of each range
+  uint32_t             m_Count;     // the number of ranges
+
+  bool Use(const uint8_t* data, uint32_t size, uint64_t sourceSize, int64_t sourceModified, bool checkSource);
+  bool Build(const std::string& csvFile, uint64_t sourceSize, int64_t sourceModified);
+
+public:
+  CIPToCountry();
+  ~CIPToCountry();
+  CIPToCountry(CIPToCountry&) = delete;
+
+  inline uint32_t GetCount() const { return m_Count; }
+
+  // loads the ranges from cacheFile, or from csvFile (and saves them to cacheFile) if the cache is missing or out of date
+
+  bool Load(const std::string& csvFile, const std::string& cacheFile);
+
+  // returns the country code of ip (in host byte order), "??" if it's not in any range
+
+  std::string Find(uint32_t ip) const;
+};
+
+#endif // AURA_IPTOCOUNTRY_H_
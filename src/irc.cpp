@@ -45,7 +45,7 @@ CIRC::CIRC(CAura* nAura, string nServer, const string& nNickname, const string&
     m_Password(std::move(nPassword)),
     m_LastConnectionAttemptTime(0),
     m_LastPacketTime(GetTime()),
-    m_LastAntiIdleTime(GetTime()),
+    m_AntiIdleTimer([this]() { EventAntiIdleTimer(); }),
     m_Port(nPort),
     m_CommandTrigger(nCommandTrigger),
     m_Exiting(false),
@@ -105,12 +105,6 @@ bool CIRC::Update(void* fd, void* send_fd)
       return m_Exiting;
     }
 
-    if (Time - m_LastAntiIdleTime > 60)
-    {
-      SendIRC("TIME");
-      m_LastAntiIdleTime = Time;
-    }
-
     m_Socket->DoRecv(static_cast<fd_set*>(fd));
     ExtractPackets();
     m_Socket->DoSend(static_cast<fd_set*>(send_fd));
@@ -150,6 +144,7 @@ bool CIRC::Update(void* fd, void* send_fd)
       Print("[IRC: " + m_Server + "] connected");
 
       m_LastPacketTime = Time;
+      m_AntiIdleTimer.Schedule(CTimerWheel::GetDefault(), GetTicks() + 60000);
 
       return m_Exiting;
     }
@@ -194,14 +189,25 @@ bool CIRC::Update(void* fd, void* send_fd)
   return m_Exiting;
 }
 
+void CIRC::EventAntiIdleTimer()
+{
+  // send something every 60 seconds so the server doesn't consider us idle
+
+  if (!m_Socket->GetConnected())
+    return;
+
+  SendIRC("TIME");
+  m_AntiIdleTimer.Schedule(CTimerWheel::GetDefault(), GetTicks() + 60000);
+}
+
 void CIRC::ExtractPackets()
 {
   const int64_t Time = GetTime();
-  string*       Recv = m_Socket->GetBytes();
+  CRecvBuffer*  Recv = m_Socket->GetRecvBuffer();
 
   // separate packets using the CRLF delimiter
 
-  vector<string> Packets = Tokenize(*Recv, '\n');
+  vector<string> Packets = Tokenize(string(reinterpret_cast<const char*>(Recv->GetData()), Recv->GetSize()), '\n');
 
   for (auto& Packets_Packet : Packets)
   {
@@ -21,6 +21,8 @@
 #ifndef AURA_IRC_H_
 #define AURA_IRC_H_
 
+#include "timerwheel.h"
+
 #include <vector>
 #include <string>
 #include <cstdint>
@@ -45,7 +47,7 @@ public:
   std::string              m_Password;
   int64_t                  m_LastConnectionAttemptTime;
   int64_t                  m_LastPacketTime;
-  int64_t                  m_LastAntiIdleTime;
+  CTimer                   m_AntiIdleTimer;
   uint16_t                 m_Port;
   int8_t                   m_CommandTrigger;
   bool                     m_Exiting;
@@ -59,6 +61,7 @@ public:
   uint32_t SetFD(void* fd, void* send_fd, int32_t* nfds);
   bool Update(void* fd, void* send_fd);
   void ExtractPackets();
+  void EventAntiIdleTimer();
   void SendIRC(const std::string& message);
   void SendMessageIRC(const std::string& message, const std::string& target);
 };
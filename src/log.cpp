@@ -0,0 +1,209 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+
+#include "log.h"
+#include "config.h"
+
+#include <chrono>
+
+using namespace std;
+
+static CLogger* gLogger = nullptr;
+
+void Print(const string& message, LogLevel level)
+{
+  // before the logger exists (and after it's gone) just write it out ourselves
+
+  if (gLogger)
+    gLogger->Log(message, level);
+  else if (level <= LOG_INFO)
+    cout << message << endl;
+}
+
+bool IsLogEnabled(LogLevel level)
+{
+  return gLogger ? gLogger->IsEnabled(level) : level <= LOG_INFO;
+}
+
+//
+// CLogMessage
+//
+
+CLogMessage::CLogMessage(string nText)
+  : m_Next(nullptr),
+    m_Text(std::move(nText))
+{
+}
+
+CLogMessage::~CLogMessage() = default;
+
+//
+// CLogger
+//
+
+CLogger::CLogger(CConfig* CFG)
+  : m_Head(&m_Stub),
+    m_Tail(&m_Stub),
+    m_Stub(string()),
+    m_Exiting(false),
+    m_RateWindow(0),
+    m_RateCount(0),
+    m_Dropped(0),
+    m_RateLimit(CFG->GetInt("bot_lograte", 500)),
+    m_Level(static_cast<LogLevel>(CFG->GetInt("bot_loglevel", LOG_INFO)))
+{
+  const string File = CFG->GetString("bot_logfile", string());
+
+  if (!File.empty())
+  {
+    m_File.open(File, ios::app);
+
+    if (m_File.fail())
+      cout << "[LOG] warning - unable to open log file [" << File << "] for writing" << endl;
+  }
+
+  m_Thread = thread(&CLogger::Run, this);
+  gLogger  = this;
+}
+
+CLogger::~CLogger()
+{
+  // write out whatever is still queued before we go
+
+  gLogger   = nullptr;
+  m_Exiting = true;
+  m_Wake.notify_one();
+
+  if (m_Thread.joinable())
+    m_Thread.join();
+}
+
+void CLogger::Log(const string& message, LogLevel level)
+{
+  if (level > m_Level)
+    return;
+
+  // errors and warnings always get through, everything else counts against the rate limit
+
+  if (level >= LOG_INFO && m_RateLimit > 0)
+  {
+    const int64_t Time   = GetTime();
+    int64_t       Window = m_RateWindow.load(memory_order_relaxed);
+
+    if (Window != Time && m_RateWindow.compare_exchange_strong(Window, Time))
+      m_RateCount = 0;
+
+    if (++m_RateCount > m_RateLimit)
+    {
+      ++m_Dropped;
+      return;
+    }
+  }
+
+  Push(new CLogMessage(message));
+}
+
+void CLogger::Push(CLogMessage* message)
+{
+  // claim the head with a single exchange then link the previous head to us
+  // until that link is made the consumer sees the queue as ending at the previous head and just tries again later
+
+  message->m_Next.store(nullptr, memory_order_relaxed);
+  CLogMessage* Previous = m_Head.exchange(message, memory_order_acq_rel);
+  Previous->m_Next.store(message, memory_order_release);
+}
+
+CLogMessage* CLogger::Pop()
+{
+  CLogMessage* Tail = m_Tail;
+  CLogMessage* Next = Tail->m_Next.load(memory_order_acquire);
+
+  if (Tail == &m_Stub)
+  {
+    if (!Next)
+      return nullptr;
+
+    m_Tail = Next;
+    Tail   = Next;
+    Next   = Next->m_Next.load(memory_order_acquire);
+  }
+
+  if (Next)
+  {
+    m_Tail = Next;
+    return Tail;
+  }
+
+  // Tail is the last message we can see, we can only take it once something is linked after it
+  // if a producer is halfway through a push we'll get it next time, otherwise put the stub back behind it
+
+  if (Tail != m_Head.load(memory_order_acquire))
+    return nullptr;
+
+  Push(&m_Stub);
+  Next = Tail->m_Next.load(memory_order_acquire);
+
+  if (Next)
+  {
+    m_Tail = Next;
+    return Tail;
+  }
+
+  return nullptr;
+}
+
+void CLogger::Run()
+{
+  string Batch;
+
+  while (true)
+  {
+    const bool Exiting = m_Exiting;
+
+    for (CLogMessage* Message = Pop(); Message; Message = Pop())
+    {
+      Batch += Message->m_Text;
+      Batch += '\n';
+      delete Message;
+    }
+
+    const uint32_t Dropped = m_Dropped.exchange(0);
+
+    if (Dropped > 0)
+      Batch += "[LOG] dropped " + to_string(Dropped) + " messages (more than bot_lograte per second)\n";
+
+    if (!Batch.empty())
+    {
+      cout << Batch << flush;
+
+      if (m_File.is_open())
+        m_File << Batch << flush;
+
+      Batch.clear();
+    }
+
+    if (Exiting)
+      return;
+
+    unique_lock<mutex> Lock(m_WakeMutex);
+    m_Wake.wait_for(Lock, chrono::milliseconds(10), [this]() { return m_Exiting.load(); });
+  }
+}
@@ -0,0 +1,92 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+
+#ifndef AURA_LOG_H_
+#define AURA_LOG_H_
+
+#include "includes.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+class CConfig;
+
+//
+// CLogMessage
+//
+
+// a node in the logger's queue
+
+class CLogMessage final
+{
+public:
+  std::atomic<CLogMessage*> m_Next;
+  std::string               m_Text;
+
+  explicit CLogMessage(std::string nText);
+  ~CLogMessage();
+  CLogMessage(CLogMessage&) = delete;
+};
+
+//
+// CLogger
+//
+
+// Print and Print2 hand their messages to this class instead of writing them out themselves
+// any thread can queue a message, the queue is a lock free multiple producer single consumer linked list (Vyukov's intrusive MPSC queue)
+// a background thread drains it every few milliseconds and writes each batch to the console (and the log file) with a single flush
+// messages above bot_loglevel are dropped before they're queued, informational and debug messages beyond bot_lograte per second are dropped and counted
+
+class CLogger final
+{
+private:
+  std::atomic<CLogMessage*> m_Head;          // the most recently queued message (producers push here)
+  CLogMessage*              m_Tail;          // the oldest queued message (only touched by the logging thread)
+  CLogMessage               m_Stub;          // a dummy node so the queue is never empty
+  std::ofstream             m_File;          // the log file (if bot_logfile is set)
+  std::thread               m_Thread;
+  std::mutex                m_WakeMutex;
+  std::condition_variable   m_Wake;
+  std::atomic<bool>         m_Exiting;
+  std::atomic<int64_t>      m_RateWindow;    // the second the current rate limiting window started
+  std::atomic<uint32_t>     m_RateCount;     // messages counted against the rate limit in the current window
+  std::atomic<uint32_t>     m_Dropped;       // messages dropped by the rate limit since the last report
+  uint32_t                  m_RateLimit;     // config value: maximum informational and debug messages per second (0 for no limit)
+  LogLevel                  m_Level;         // config value: the most verbose level to log
+
+  void         Push(CLogMessage* message);
+  CLogMessage* Pop();
+  void         Run();
+
+public:
+  explicit CLogger(CConfig* CFG);
+  ~CLogger();
+  CLogger(CLogger&) = delete;
+
+  inline bool IsEnabled(LogLevel level) const { return level <= m_Level; }
+
+  void Log(const std::string& message, LogLevel level);
+};
+
+#endif // AURA_LOG_H_
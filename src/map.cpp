@@ -27,6 +27,10 @@
 #include "config.h"
 #include "gameslot.h"
 
+#include <algorithm>
+#include <fstream>
+#include <future>
+
 #define __STORMLIB_SELF__
 #include <StormLib.h>
 
@@ -35,18 +39,327 @@
 
 using namespace std;
 
+// a file hashed for map_crc and map_sha1, see CMap :: Load
+
+struct CMapSubFile
+{
+  vector<uint8_t>  Data;
+  future<uint32_t> Term;        // the file's part of map_crc
+  bool             AfterScript; // the file comes after war3map.j (or its equivalent)
+
+  CMapSubFile()
+    : AfterScript(false)
+  {
+  }
+};
+
+// map_info (the CRC) and map_hash (the sha1) both cover the whole map file
+// calculate them in one pass over the file so each chunk is still in the cache for the second hash
+
+static void HashMapFile(const CByteSpan& data, const CCRC32* crc, uint32_t* info, uint8_t hash[20])
+{
+  CSHA1    SHA;
+  uint32_t CRC = 0;
+
+  for (uint32_t Start = 0; Start < data.size(); Start += 65536)
+  {
+    const uint32_t Size = min<uint32_t>(65536, data.size() - Start);
+    CRC                 = crc->CalculateCRC(data.data() + Start, Size, CRC);
+    SHA.Update(data.data() + Start, Size);
+  }
+
+  SHA.Final();
+  SHA.GetHash(hash);
+  *info = CRC;
+}
+
+static bool ReadSubFile(HANDLE mpq, const string& fileName, vector<uint8_t>* data)
+{
+  HANDLE SubFile;
+
+  if (!SFileOpenFileEx(mpq, fileName.c_str(), 0, &SubFile))
+    return false;
+
+  const uint32_t FileLength = SFileGetFileSize(SubFile, nullptr);
+  DWORD          BytesRead  = 0;
+  bool           Success    = false;
+
+  if (FileLength > 0 && FileLength != 0xFFFFFFFF)
+  {
+    data->resize(FileLength);
+    Success = SFileReadFile(SubFile, data->data(), FileLength, &BytesRead, nullptr);
+    data->resize(BytesRead);
+  }
+
+  SFileCloseFile(SubFile);
+  return Success;
+}
+
+//
+// CMapFile
+//
+
+CMapFile::CMapFile() = default;
+
+CMapFile::CMapFile(const string& file, const CCRC32* crc)
+  : m_File(file)
+{
+  m_PartCRCs.reserve(m_File.size() / MAP_PART_SIZE + 1);
+
+  for (uint32_t Start = 0; Start < m_File.size(); Start += MAP_PART_SIZE)
+    m_PartCRCs.push_back(crc->CalculateCRC(m_File.data() + Start, min<uint32_t>(MAP_PART_SIZE, m_File.size() - Start)));
+}
+
+CMapFile::~CMapFile() = default;
+
+//
+// CMapDataCache
+//
+
+CMapDataCache::CMapDataCache() = default;
+
+CMapDataCache::~CMapDataCache() = default;
+
+CMapDataCache* CMapDataCache::GetDefault()
+{
+  static CMapDataCache Cache;
+  return &Cache;
+}
+
+CMapData CMapDataCache::Insert(const vector<uint8_t>& hash, const CMapData& data)
+{
+  lock_guard<mutex> Lock(m_Mutex);
+
+  // forget about any data nobody is using anymore while we're here
+
+  for (auto i = begin(m_Entries); i != end(m_Entries);)
+  {
+    if (i->second.expired())
+      i = m_Entries.erase(i);
+    else
+      ++i;
+  }
+
+  auto&    Entry  = m_Entries[hash];
+  CMapData Cached = Entry.lock();
+
+  if (!Cached || Cached->size() != data->size())
+  {
+    Entry  = data;
+    Cached = data;
+  }
+
+  // keep the most recently loaded maps around even after every CMap using them is gone
+
+  auto Recent = find(begin(m_Recent), end(m_Recent), Cached);
+
+  if (Recent != end(m_Recent))
+    m_Recent.erase(Recent);
+
+  m_Recent.push_front(Cached);
+
+  if (m_Recent.size() > MAPDATA_RECENT)
+    m_Recent.pop_back();
+
+  return Cached;
+}
+
+CMapData CMapDataCache::Find(const vector<uint8_t>& hash)
+{
+  lock_guard<mutex> Lock(m_Mutex);
+  auto              Entry = m_Entries.find(hash);
+
+  if (Entry == end(m_Entries))
+    return CMapData();
+
+  return Entry->second.lock();
+}
+
+uint32_t CMapDataCache::GetNumEntries()
+{
+  lock_guard<mutex> Lock(m_Mutex);
+  uint32_t          Count = 0;
+
+  for (const auto& entry : m_Entries)
+  {
+    if (!entry.second.expired())
+      ++Count;
+  }
+
+  return Count;
+}
+
+uint64_t CMapDataCache::GetNumBytes()
+{
+  lock_guard<mutex> Lock(m_Mutex);
+  uint64_t          Bytes = 0;
+
+  for (const auto& entry : m_Entries)
+  {
+    if (CMapData Data = entry.second.lock())
+      Bytes += Data->size();
+  }
+
+  return Bytes;
+}
+
+//
+// CMapCache
+//
+
+// one line per map file, tab separated
+// path, file size, file time, war3 version, map_size, map_info, map_crc, map_sha1, map_hash, map_width, map_height, map_options, map_numplayers, map_numteams, map_filter_type, map_slot<x> (separated by commas)
+// the byte arrays are written the same way as in the map configs
+
+#define MAPCACHE_HEADER "# aura map cache 1"
+#define MAPCACHE_FIELDS 16
+
+CMapCache::CMapCache(string nFile)
+  : m_File(std::move(nFile))
+{
+  ifstream IS(m_File);
+
+  if (IS.fail())
+    return;
+
+  string Line;
+
+  if (!getline(IS, Line) || Line != MAPCACHE_HEADER)
+  {
+    Print("[MAP] map cache [" + m_File + "] was written by a different version, ignoring it");
+    return;
+  }
+
+  while (getline(IS, Line))
+  {
+    const vector<string> Fields = Tokenize(Line, '\t');
+
+    if (Fields.size() != MAPCACHE_FIELDS)
+      continue;
+
+    CMapCacheEntry Entry;
+
+    try
+    {
+      Entry.FileSize      = stoull(Fields[1]);
+      Entry.FileTime      = stoll(Fields[2]);
+      Entry.War3Version   = static_cast<uint8_t>(stoul(Fields[3]));
+      Entry.MapSize       = ExtractNumbers(Fields[4], 4);
+      Entry.MapInfo       = ExtractNumbers(Fields[5], 4);
+      Entry.MapCRC        = ExtractNumbers(Fields[6], 4);
+      Entry.MapSHA1       = ExtractNumbers(Fields[7], 20);
+      Entry.MapHash       = ExtractNumbers(Fields[8], 20);
+      Entry.MapWidth      = ExtractNumbers(Fields[9], 2);
+      Entry.MapHeight     = ExtractNumbers(Fields[10], 2);
+      Entry.MapOptions    = stoul(Fields[11]);
+      Entry.MapNumPlayers = stoul(Fields[12]);
+      Entry.MapNumTeams   = stoul(Fields[13]);
+      Entry.MapFilterType = stoul(Fields[14]);
+
+      for (const auto& slot : Tokenize(Fields[15], ','))
+        Entry.Slots.emplace_back(ExtractNumbers(slot, 9));
+    }
+    catch (...)
+    {
+      continue;
+    }
+
+    m_Entries[Fields[0]] = Entry;
+  }
+
+  Print("[MAP] loaded " + to_string(m_Entries.size()) + " entries from map cache [" + m_File + "]");
+}
+
+CMapCache::~CMapCache() = default;
+
+bool CMapCache::Get(const string& file, uint64_t fileSize, int64_t fileTime, uint8_t war3Version, CMapCacheEntry* entry)
+{
+  lock_guard<mutex> Lock(m_Mutex);
+  auto              Entry = m_Entries.find(file);
+
+  if (Entry == end(m_Entries) || Entry->second.FileSize != fileSize || Entry->second.FileTime != fileTime || Entry->second.War3Version != war3Version)
+    return false;
+
+  *entry = Entry->second;
+  return true;
+}
+
+void CMapCache::Put(const string& file, const CMapCacheEntry& entry)
+{
+  lock_guard<mutex> Lock(m_Mutex);
+  m_Entries[file] = entry;
+  Write();
+}
+
+bool CMapCache::Write()
+{
+  // write to a temporary file and rename it over the cache so we never leave a half written cache behind
+
+  const string TempFile = m_File + ".tmp";
+  ofstream     OS(TempFile, ios::trunc);
+
+  if (OS.fail())
+  {
+    Print("[MAP] warning - unable to write map cache [" + TempFile + "]", LOG_WARNING);
+    return false;
+  }
+
+  OS << MAPCACHE_HEADER << '\n';
+
+  for (const auto& entry : m_Entries)
+  {
+    const CMapCacheEntry& Entry = entry.second;
+    string                Slots;
+
+    for (const auto& slot : Entry.Slots)
+    {
+      if (!Slots.empty())
+        Slots += ',';
+
+      Slots += ByteArrayToDecString(slot.GetByteArray());
+    }
+
+    OS << entry.first << '\t' << Entry.FileSize << '\t' << Entry.FileTime << '\t' << static_cast<uint32_t>(Entry.War3Version) << '\t';
+    OS << ByteArrayToDecString(Entry.MapSize) << '\t' << ByteArrayToDecString(Entry.MapInfo) << '\t' << ByteArrayToDecString(Entry.MapCRC) << '\t';
+    OS << ByteArrayToDecString(Entry.MapSHA1) << '\t' << ByteArrayToDecString(Entry.MapHash) << '\t';
+    OS << ByteArrayToDecString(Entry.MapWidth) << '\t' << ByteArrayToDecString(Entry.MapHeight) << '\t';
+    OS << Entry.MapOptions << '\t' << Entry.MapNumPlayers << '\t' << Entry.MapNumTeams << '\t' << Entry.MapFilterType << '\t' << Slots << '\n';
+  }
+
+  OS.close();
+
+#ifdef WIN32
+  // rename doesn't replace existing files on windows
+
+  remove(m_File.c_str());
+#endif
+
+  if (OS.fail() || rename(TempFile.c_str(), m_File.c_str()) != 0)
+  {
+    Print("[MAP] warning - unable to write map cache [" + m_File + "]", LOG_WARNING);
+    return false;
+  }
+
+  return true;
+}
+
 //
 // CMap
 //
 
-CMap::CMap(CAura* nAura, CConfig* CFG, const string& nCFGFile)
+CMap::CMap(CAura* nAura, const CMapLoadSettings& settings, CConfig* CFG, const string& nCFGFile)
   : m_Aura(nAura)
 {
-  Load(CFG, nCFGFile);
+  Load(settings, CFG, nCFGFile);
 }
 
 CMap::~CMap() = default;
 
+CByteSpan CMap::GetMapData() const
+{
+  return CByteSpan(m_MapData->data(), m_MapData->size());
+}
+
 std::vector<uint8_t> CMap::GetMapGameFlags() const
 {
   uint32_t GameFlags = 0;
@@ -197,7 +510,7 @@ uint8_t CMap::GetMapLayoutStyle() const
   return 3;
 }
 
-void CMap::Load(CConfig* CFG, const string& nCFGFile)
+void CMap::Load(const CMapLoadSettings& settings, CConfig* CFG, const string& nCFGFile)
 {
   m_Valid   = true;
   m_CFGFile = nCFGFile;
@@ -205,76 +518,117 @@ void CMap::Load(CConfig* CFG, const string& nCFGFile)
   // load the map data
 
   m_MapLocalPath = CFG->GetString("map_localpath", string());
-  m_MapData.clear();
 
   if (!m_MapLocalPath.empty())
-    m_MapData = FileRead(m_Aura->m_MapPath + m_MapLocalPath);
+    m_MapData = make_shared<const CMapFile>(settings.MapPath + m_MapLocalPath, m_Aura->m_CRC);
+  else
+    m_MapData = make_shared<const CMapFile>();
+
+  // if we've loaded this exact file before (same size and modification time) we don't have to calculate anything
+
+  string         MapMPQFileName = settings.MapPath + m_MapLocalPath;
+  uint64_t       MapFileSize    = 0;
+  int64_t        MapFileTime    = 0;
+  CMapCacheEntry Cached;
+  const bool     FromCache = !m_MapData->empty() && m_Aura->m_MapCache && FileStat(MapMPQFileName, &MapFileSize, &MapFileTime) && m_Aura->m_MapCache->Get(MapMPQFileName, MapFileSize, MapFileTime, settings.ScriptsWar3Version, &Cached);
+
+  std::vector<uint8_t> MapSize, MapInfo, MapCRC, MapSHA1, MapHash;
+  std::vector<uint8_t> MapWidth;
+  std::vector<uint8_t> MapHeight;
+  uint32_t             MapOptions    = 0;
+  uint32_t             MapNumPlayers = 0;
+  uint32_t             MapFilterType = MAPFILTER_TYPE_SCENARIO;
+  uint32_t             MapNumTeams   = 0;
+  vector<CGameSlot>    Slots;
+
+  if (FromCache)
+  {
+    Print("[MAP] using cached map_size, map_info, map_crc, map_sha1, map_hash, map_options, map_width, map_height, map_slot<x>, map_numplayers, map_numteams for [" + MapMPQFileName + "]");
+    MapSize       = Cached.MapSize;
+    MapInfo       = Cached.MapInfo;
+    MapCRC        = Cached.MapCRC;
+    MapSHA1       = Cached.MapSHA1;
+    MapHash       = Cached.MapHash;
+    MapWidth      = Cached.MapWidth;
+    MapHeight     = Cached.MapHeight;
+    MapOptions    = Cached.MapOptions;
+    MapNumPlayers = Cached.MapNumPlayers;
+    MapFilterType = Cached.MapFilterType;
+    MapNumTeams   = Cached.MapNumTeams;
+    Slots         = Cached.Slots;
+    m_MapData     = CMapDataCache::GetDefault()->Insert(MapHash, m_MapData);
+    m_MapDataHash = MapHash;
+  }
 
   // load the map MPQ
 
-  string MapMPQFileName = m_Aura->m_MapPath + m_MapLocalPath;
   HANDLE MapMPQ;
   bool   MapMPQReady = false;
 
+  if (!FromCache)
+  {
 #ifdef WIN32
-  const wstring MapMPQFileNameW = wstring(begin(MapMPQFileName), end(MapMPQFileName));
+    const wstring MapMPQFileNameW = wstring(begin(MapMPQFileName), end(MapMPQFileName));
 
-  if (SFileOpenArchive(MapMPQFileNameW.c_str(), 0, MPQ_OPEN_FORCE_MPQ_V1, &MapMPQ))
+    if (SFileOpenArchive(MapMPQFileNameW.c_str(), 0, BASE_PROVIDER_MAP | MPQ_OPEN_FORCE_MPQ_V1, &MapMPQ))
 #else
-  if (SFileOpenArchive(MapMPQFileName.c_str(), 0, MPQ_OPEN_FORCE_MPQ_V1, &MapMPQ))
+    if (SFileOpenArchive(MapMPQFileName.c_str(), 0, BASE_PROVIDER_MAP | MPQ_OPEN_FORCE_MPQ_V1, &MapMPQ))
 #endif
-  {
-    Print("[MAP] loading MPQ file [" + MapMPQFileName + "]");
-    MapMPQReady = true;
+    {
+      Print("[MAP] loading MPQ file [" + MapMPQFileName + "]");
+      MapMPQReady = true;
+    }
+    else
+      Print("[MAP] warning - unable to load MPQ file [" + MapMPQFileName + "]", LOG_WARNING);
   }
-  else
-    Print("[MAP] warning - unable to load MPQ file [" + MapMPQFileName + "]");
 
-  // try to calculate map_size, map_info, map_crc, map_sha1
-
-  std::vector<uint8_t> MapSize, MapInfo, MapCRC, MapSHA1, MapHash;
+  // try to calculate map_size, map_info, map_crc, map_sha1, map_hash
 
-  if (!m_MapData.empty())
+  if (!FromCache && !m_MapData->empty())
   {
-    m_Aura->m_SHA->Reset();
-
     // calculate map_size
 
-    MapSize = CreateByteArray(static_cast<uint32_t>(m_MapData.size()), false);
+    MapSize = CreateByteArray(static_cast<uint32_t>(m_MapData->size()), false);
     Print("[MAP] calculated map_size = " + ByteArrayToDecString(MapSize));
 
-    // calculate map_info (this is actually the CRC)
+    // map_info (this is actually the CRC) and map_hash only depend on the map file, calculate them on another thread while we read the MPQ
 
-    MapInfo = CreateByteArray(m_Aura->m_CRC->CalculateCRC((uint8_t*)m_MapData.c_str(), m_MapData.size()), false);
-    Print("[MAP] calculated map_info = " + ByteArrayToDecString(MapInfo));
+    uint32_t       Info       = 0;
+    uint8_t        Hash[20];
+    const CCRC32*  CRC        = m_Aura->m_CRC;
+    const CMapData Data       = m_MapData;
+    future<void>   FileHashes = async(launch::async, [CRC, Data, &Info, &Hash]() { HashMapFile(CByteSpan(Data->data(), Data->size()), CRC, &Info, Hash); });
 
     // calculate map_crc (this is not the CRC) and map_sha1
     // a big thank you to Strilanc for figuring the map_crc algorithm out
 
-    string CommonJ = FileRead(m_Aura->m_MapCFGPath + "common.j");
+    string CommonJ = FileRead(settings.MapCFGPath + "common.j");
 
     if (CommonJ.empty())
-      Print("[MAP] unable to calculate map_crc/sha1 - unable to read file [" + m_Aura->m_MapCFGPath + "common.j]");
+      Print("[MAP] unable to calculate map_crc/sha1 - unable to read file [" + settings.MapCFGPath + "common.j]");
     else
     {
-      string BlizzardJ = FileRead(m_Aura->m_MapCFGPath + "blizzard.j");
+      string BlizzardJ = FileRead(settings.MapCFGPath + "blizzard.j");
 
       if (BlizzardJ.empty())
-        Print("[MAP] unable to calculate map_crc/sha1 - unable to read file [" + m_Aura->m_MapCFGPath + "blizzard.j]");
+        Print("[MAP] unable to calculate map_crc/sha1 - unable to read file [" + settings.MapCFGPath + "blizzard.j]");
       else
       {
-        uint32_t Val = 0;
+        // the subfiles are read one at a time (StormLib can't read one archive from several threads) and hashed for map_sha1 in order as they're read
+        // each subfile's part of map_crc doesn't depend on the others so those are calculated in parallel and combined in order at the end
+
+        vector<CMapSubFile> SubFiles;
+        CSHA1               SHA;
+
+        // the tasks hold references to the elements so make sure they never move, there's common.j, blizzard.j and at most 12 others
+
+        SubFiles.reserve(14);
 
         // update: it's possible for maps to include their own copies of common.j and/or blizzard.j
         // this code now overrides the default copies if required
 
-        bool OverrodeCommonJ   = false;
-        bool OverrodeBlizzardJ = false;
-
         if (MapMPQReady)
         {
-          HANDLE SubFile;
-          
           //0     Neutral/English (American)  | 0x404	Chinese (Taiwan)
           //0x405 Czech	                  | 0x407  German
           //0x409 English	               | 0x40a  Spanish
@@ -283,78 +637,33 @@ void CMap::Load(CConfig* CFG, const string& nCFGFile)
           //0x415 Polish	               | 0x416  Portuguese
           //0x419 Russsian	               | 0x809  English (UK) 
           SFileSetLocale(0x412);
-
-          // override common.j
-
-          if (SFileOpenFileEx(MapMPQ, R"(Scripts\common.j)", 0, &SubFile))
-          {
-            uint32_t FileLength = SFileGetFileSize(SubFile, nullptr);
-
-            if (FileLength > 0 && FileLength != 0xFFFFFFFF)
-            {
-              auto  SubFileData = new char[FileLength];
-              DWORD BytesRead   = 0;
-
-              if (SFileReadFile(SubFile, SubFileData, FileLength, &BytesRead, nullptr))
-              {
-                Print("[MAP] overriding default common.j with map copy while calculating map_crc/sha1");
-                OverrodeCommonJ = true;
-                Val             = Val ^ XORRotateLeft(reinterpret_cast<uint8_t*>(SubFileData), BytesRead);
-                m_Aura->m_SHA->Update(reinterpret_cast<uint8_t*>(SubFileData), BytesRead);
-              }
-
-              delete[] SubFileData;
-            }
-
-            SFileCloseFile(SubFile);
-          }
-        }
-
-        if (!OverrodeCommonJ)
-        {
-          Val = Val ^ XORRotateLeft((uint8_t*)CommonJ.c_str(), CommonJ.size());
-          m_Aura->m_SHA->Update((uint8_t*)CommonJ.c_str(), CommonJ.size());
         }
 
-        if (MapMPQReady)
-        {
-          HANDLE SubFile;
+        // override common.j
 
-          // override blizzard.j
+        SubFiles.emplace_back();
 
-          if (SFileOpenFileEx(MapMPQ, R"(Scripts\blizzard.j)", 0, &SubFile))
-          {
-            uint32_t FileLength = SFileGetFileSize(SubFile, nullptr);
+        if (MapMPQReady && ReadSubFile(MapMPQ, R"(Scripts\common.j)", &SubFiles.back().Data))
+          Print("[MAP] overriding default common.j with map copy while calculating map_crc/sha1");
+        else
+          SubFiles.back().Data.assign(begin(CommonJ), end(CommonJ));
 
-            if (FileLength > 0 && FileLength != 0xFFFFFFFF)
-            {
-              auto  SubFileData = new char[FileLength];
-              DWORD BytesRead   = 0;
+        // override blizzard.j
 
-              if (SFileReadFile(SubFile, SubFileData, FileLength, &BytesRead, nullptr))
-              {
-                Print("[MAP] overriding default blizzard.j with map copy while calculating map_crc/sha1");
-                OverrodeBlizzardJ = true;
-                Val               = Val ^ XORRotateLeft(reinterpret_cast<uint8_t*>(SubFileData), BytesRead);
-                m_Aura->m_SHA->Update(reinterpret_cast<uint8_t*>(SubFileData), BytesRead);
-              }
+        SubFiles.emplace_back();
 
-              delete[] SubFileData;
-            }
-
-            SFileCloseFile(SubFile);
-          }
-        }
+        if (MapMPQReady && ReadSubFile(MapMPQ, R"(Scripts\blizzard.j)", &SubFiles.back().Data))
+          Print("[MAP] overriding default blizzard.j with map copy while calculating map_crc/sha1");
+        else
+          SubFiles.back().Data.assign(begin(BlizzardJ), end(BlizzardJ));
 
-        if (!OverrodeBlizzardJ)
+        for (auto& subFile : SubFiles)
         {
-          Val = Val ^ XORRotateLeft((uint8_t*)BlizzardJ.c_str(), BlizzardJ.size());
-          m_Aura->m_SHA->Update((uint8_t*)BlizzardJ.c_str(), BlizzardJ.size());
+          subFile.Term = async(launch::async, [&subFile]() { return XORRotateLeft(subFile.Data.data(), subFile.Data.size()); });
+          SHA.Update(subFile.Data.data(), subFile.Data.size());
         }
 
-        Val = ROTL(Val, 3);
-        Val = ROTL(Val ^ 0x03F1379E, 3);
-        m_Aura->m_SHA->Update((uint8_t*)"\x9E\x37\xF1\x03", 4);
+        SHA.Update((uint8_t*)"\x9E\x37\xF1\x03", 4);
 
         if (MapMPQReady)
         {
@@ -380,54 +689,71 @@ void CMap::Load(CConfig* CFG, const string& nCFGFile)
             if (FoundScript && (fileName == R"(scripts\war3map.j)" || fileName == "war3map.lua" || fileName == R"(scripts\war3map.lua)"))
               continue;
 
-            HANDLE SubFile;
+            vector<uint8_t> FileData;
 
-            if (SFileOpenFileEx(MapMPQ, fileName.c_str(), 0, &SubFile))
-            {
-              uint32_t FileLength = SFileGetFileSize(SubFile, nullptr);
+            if (!ReadSubFile(MapMPQ, fileName, &FileData))
+              continue;
 
-              if (FileLength > 0 && FileLength != 0xFFFFFFFF)
-              {
-                auto  SubFileData = new char[FileLength];
-                DWORD BytesRead   = 0;
+            SubFiles.emplace_back();
+            CMapSubFile& SubFile = SubFiles.back();
+            SubFile.Data         = std::move(FileData);
+            SubFile.AfterScript  = FoundScript;
 
-                if (SFileReadFile(SubFile, SubFileData, FileLength, &BytesRead, nullptr))
-                {
-				  if (m_Aura->m_LANWar3Version >= 32)  // giant Thank You to Fingon for the checksum algorithm
-				  {
-					if (FoundScript)
-					  if (m_Aura->m_LANWar3Version >= 33) // I found this one out myself
-						Val = ROTL(Val ^ XORRotateLeft((uint8_t*)SubFileData, BytesRead), 3);
-					  else
-						Val = ChunkedChecksum((uint8_t*)SubFileData, BytesRead, Val);
-					else
-					  Val = XORRotateLeft((uint8_t*)SubFileData, BytesRead);
-				  }
-				  else
-					Val = ROTL(Val ^ XORRotateLeft((uint8_t*)SubFileData, BytesRead), 3);
-                  if (fileName == "war3map.j" || fileName == R"(scripts\war3map.j)" || fileName == "war3map.lua" || fileName == R"(scripts\war3map.lua)")
-                    FoundScript = true;
-
-                  m_Aura->m_SHA->Update(reinterpret_cast<uint8_t*>(SubFileData), BytesRead);
-                }
+            // before 1.33 the files after the script were checksummed 1 KB at a time, the last partial chunk is skipped (giant Thank You to Fingon for the checksum algorithm)
 
-                delete[] SubFileData;
-              }
+            if (settings.LANWar3Version == 32 && FoundScript)
+              SubFile.Term = async(launch::async, [&SubFile]() { return ChunkedChecksum(SubFile.Data.data(), static_cast<int32_t>(SubFile.Data.size()), 0); });
+            else
+              SubFile.Term = async(launch::async, [&SubFile]() { return XORRotateLeft(SubFile.Data.data(), SubFile.Data.size()); });
 
-              SFileCloseFile(SubFile);
-            }
+            SHA.Update(SubFile.Data.data(), SubFile.Data.size());
+
+            if (fileName == "war3map.j" || fileName == R"(scripts\war3map.j)" || fileName == "war3map.lua" || fileName == R"(scripts\war3map.lua)")
+              FoundScript = true;
           }
 
           if (!FoundScript)
             Print(R"([MAP] couldn't find war3map.j or scripts\war3map.j in MPQ file, calculated map_crc/sha1 is probably wrong)");
+        }
+
+        // combine the checksums in order
+        // common.j and blizzard.j are xored together and the rest are chained with a rotation after each one
+
+        uint32_t Val = SubFiles[0].Term.get() ^ SubFiles[1].Term.get();
+        Val          = ROTL(Val, 3);
+        Val          = ROTL(Val ^ 0x03F1379E, 3);
 
+        for (auto i = begin(SubFiles) + 2; i != end(SubFiles); ++i)
+        {
+          const uint32_t Term = i->Term.get();
+
+          if (settings.LANWar3Version >= 32)
+          {
+            if (!i->AfterScript)
+              Val = Term;
+            else if (settings.LANWar3Version >= 33) // I found this one out myself
+              Val = ROTL(Val ^ Term, 3);
+            else
+            {
+              // the chunks are chained like the words in XORRotateLeft so the starting value ends up rotated 3 bits per chunk
+
+              const uint32_t Bits = (3 * (i->Data.size() / 0x400)) % 32;
+              Val                 = Term ^ (Bits == 0 ? Val : ROTL(Val, Bits));
+            }
+          }
+          else
+            Val = ROTL(Val ^ Term, 3);
+        }
+
+        if (MapMPQReady)
+        {
           MapCRC = CreateByteArray(Val, false);
           Print("[MAP] calculated map_crc = " + ByteArrayToDecString(MapCRC));
 
-          m_Aura->m_SHA->Final();
+          SHA.Final();
           uint8_t SHA1[20];
           memset(SHA1, 0, sizeof(uint8_t) * 20);
-          m_Aura->m_SHA->GetHash(SHA1);
+          SHA.GetHash(SHA1);
           MapSHA1 = CreateByteArray(SHA1, 20);
           Print("[MAP] calculated map_sha1 = " + ByteArrayToDecString(MapSHA1));
         }
@@ -435,29 +761,26 @@ void CMap::Load(CConfig* CFG, const string& nCFGFile)
           Print("[MAP] unable to calculate map_crc/sha1 - map MPQ file not loaded");
       }
     }
-	m_Aura->m_SHA->Reset();
-	m_Aura->m_SHA->Update((uint8_t*)m_MapData.c_str(), m_MapData.size());
-	m_Aura->m_SHA->Final();
-	uint8_t Hash[20];
-	memset(Hash, 0, sizeof(uint8_t) * 20);
-	m_Aura->m_SHA->GetHash(Hash);
-	MapHash = CreateByteArray(Hash, 20);
-	Print("[MAP] calculated map_hash = " + ByteArrayToDecString(MapHash));
+
+    FileHashes.get();
+
+    MapInfo = CreateByteArray(Info, false);
+    Print("[MAP] calculated map_info = " + ByteArrayToDecString(MapInfo));
+
+    MapHash = CreateByteArray(Hash, 20);
+    Print("[MAP] calculated map_hash = " + ByteArrayToDecString(MapHash));
+
+    // if this map is already loaded (e.g. by a lobby) share that copy and free the one we just read
+
+    m_MapData     = CMapDataCache::GetDefault()->Insert(MapHash, m_MapData);
+    m_MapDataHash = MapHash;
   }
-  else
+  else if (m_MapData->empty())
     Print("[MAP] no map data available, using config file for map_size, map_info, map_crc, map_sha1");
 
   // try to calculate map_width, map_height, map_slot<x>, map_numplayers, map_numteams, map_filtertype
 
-  std::vector<uint8_t> MapWidth;
-  std::vector<uint8_t> MapHeight;
-  uint32_t             MapOptions    = 0;
-  uint32_t             MapNumPlayers = 0;
-  uint32_t             MapFilterType = MAPFILTER_TYPE_SCENARIO;
-  uint32_t             MapNumTeams   = 0;
-  vector<CGameSlot>    Slots;
-
-  if (!m_MapData.empty())
+  if (!FromCache && !m_MapData->empty())
   {
     if (MapMPQReady)
     {
@@ -705,7 +1028,7 @@ void CMap::Load(CConfig* CFG, const string& nCFGFile)
     else
       Print("[MAP] unable to calculate map_options, map_width, map_height, map_slot<x>, map_numplayers, map_numteams - map MPQ file not loaded");
   }
-  else
+  else if (m_MapData->empty())
     Print("[MAP] no map data available, using config file for map_options, map_width, map_height, map_slot<x>, map_numplayers, map_numteams");
 
   // close the map MPQ
@@ -713,6 +1036,28 @@ void CMap::Load(CConfig* CFG, const string& nCFGFile)
   if (MapMPQReady)
     SFileCloseArchive(MapMPQ);
 
+  // remember what we calculated for next time, but only if we managed to calculate everything
+
+  if (!FromCache && m_Aura->m_MapCache && MapSize.size() == 4 && MapInfo.size() == 4 && MapCRC.size() == 4 && MapSHA1.size() == 20 && MapHash.size() == 20 && !MapWidth.empty() && !Slots.empty() && FileStat(MapMPQFileName, &MapFileSize, &MapFileTime))
+  {
+    Cached.FileSize      = MapFileSize;
+    Cached.FileTime      = MapFileTime;
+    Cached.War3Version   = settings.ScriptsWar3Version;
+    Cached.MapSize       = MapSize;
+    Cached.MapInfo       = MapInfo;
+    Cached.MapCRC        = MapCRC;
+    Cached.MapSHA1       = MapSHA1;
+    Cached.MapHash       = MapHash;
+    Cached.MapWidth      = MapWidth;
+    Cached.MapHeight     = MapHeight;
+    Cached.MapOptions    = MapOptions;
+    Cached.MapNumPlayers = MapNumPlayers;
+    Cached.MapFilterType = MapFilterType;
+    Cached.MapNumTeams   = MapNumTeams;
+    Cached.Slots         = Slots;
+    m_Aura->m_MapCache->Put(MapMPQFileName, Cached);
+  }
+
   m_MapPath = CFG->GetString("map_path", string());
 
   if (MapSize.empty())
@@ -909,14 +1254,14 @@ const char* CMap::CheckValid()
   }
 
   if (m_MapPath.find('/') != string::npos)
-    Print(R"(warning - map_path contains forward slashes '/' but it must use Windows style back slashes '\')");
+    Print(R"(warning - map_path contains forward slashes '/' but it must use Windows style back slashes '\')", LOG_WARNING);
 
   if (m_MapSize.size() != 4)
   {
     m_Valid = false;
     return "invalid map_size detected";
   }
-  else if (!m_MapData.empty() && m_MapData.size() != ByteArrayToUInt32(m_MapSize, false))
+  else if (!m_MapData->empty() && m_MapData->size() != ByteArrayToUInt32(m_MapSize, false))
   {
     m_Valid = false;
     return "invalid map_size detected - size mismatch with actual map data";
@@ -990,40 +1335,3 @@ const char* CMap::CheckValid()
 
   return nullptr;
 }
-
-uint32_t CMap::XORRotateLeft(uint8_t* data, uint32_t length)
-{
-  // a big thank you to Strilanc for figuring this out
-
-  uint32_t i   = 0;
-  uint32_t Val = 0;
-
-  if (length > 3)
-  {
-    while (i < length - 3)
-    {
-      Val = ROTL(Val ^ ((uint32_t)data[i] + (uint32_t)(data[i + 1] << 8) + (uint32_t)(data[i + 2] << 16) + (uint32_t)(data[i + 3] << 24)), 3);
-      i += 4;
-    }
-  }
-
-  while (i < length)
-  {
-    Val = ROTL(Val ^ data[i], 3);
-    ++i;
-  }
-
-  return Val;
-}
-
-uint32_t CMap::ChunkedChecksum(uint8_t* data, int32_t length, uint32_t checksum)
-{
-	int32_t index = 0;
-	int32_t t = length - 0x400;
-	while (index <= t)
-	{
-		checksum = ROTL(checksum ^ XORRotateLeft(&data[index], 0x400), 3);
-		index += 0x400;
-	}
-	return checksum;
-}
\ No newline at end of file
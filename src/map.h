@@ -83,17 +83,157 @@
 #define MAPGAMETYPE_OBSONDEATH 1 << 21
 #define MAPGAMETYPE_OBSNONE 1 << 22
 
-//
-// CMap
-//
+#define MAP_PART_SIZE 1442 // the number of map bytes in each W3GS_MAPPART packet
+#define MAPDATA_RECENT 4     // the number of recently loaded maps kept mapped even if nothing is using them
 
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <deque>
+
+#include "fileutil.h"
 
 class CAura;
 class CGameSlot;
 class CConfig;
+class CCRC32;
+class CByteSpan;
+
+//
+// CMapFile
+//
+
+// a mapped map file and the crc of every part of it we send to downloading players
+// the crcs are calculated once when the file is loaded so serving a download to any number of players is just copying
+
+class CMapFile final
+{
+private:
+  CMappedFile           m_File;
+  std::vector<uint32_t> m_PartCRCs; // crc32 of each MAP_PART_SIZE bytes of the file
+
+public:
+  CMapFile();
+  CMapFile(const std::string& file, const CCRC32* crc);
+  ~CMapFile();
+
+  inline const uint8_t* data() const { return m_File.data(); }
+  inline uint32_t       size() const { return m_File.size(); }
+  inline bool           empty() const { return m_File.empty(); }
+  inline const CMappedFile& GetFile() const { return m_File; }
+  inline uint32_t       GetPartCRC(uint32_t start) const { return start / MAP_PART_SIZE < m_PartCRCs.size() ? m_PartCRCs[start / MAP_PART_SIZE] : 0; }
+};
+
+typedef std::shared_ptr<const CMapFile> CMapData;
+
+//
+// CMapDataCache
+//
+
+// the mapped map files in use, keyed by the map_hash (sha1 of the whole file)
+// the data is immutable once loaded so every CMap (the bot's and a copy per lobby) just holds a reference to it
+// entries don't keep the data alive, it's freed as soon as the last CMap referencing it goes away
+// except for the last few maps loaded which stay around so the map server can keep serving them
+
+class CMapDataCache final
+{
+private:
+  std::mutex                                                    m_Mutex;
+  std::map<std::vector<uint8_t>, std::weak_ptr<const CMapFile>> m_Entries;
+  std::deque<CMapData>                                          m_Recent; // the last MAPDATA_RECENT maps loaded
+
+public:
+  CMapDataCache();
+  ~CMapDataCache();
+  CMapDataCache(CMapDataCache&) = delete;
+  CMapDataCache& operator=(CMapDataCache&) = delete;
+
+  static CMapDataCache* GetDefault();
+
+  // returns the cached data with this hash if it's still alive, otherwise caches and returns the given data
+
+  CMapData Insert(const std::vector<uint8_t>& hash, const CMapData& data);
+  CMapData Find(const std::vector<uint8_t>& hash);
+
+  uint32_t GetNumEntries();
+  uint64_t GetNumBytes();
+};
+
+//
+// CMapCacheEntry
+//
+
+// everything CMap :: Load calculates from a map file, before any config overrides are applied
+// the file's size and modification time and the war3 version the scripts were extracted for tell us whether it's still valid
+
+struct CMapCacheEntry
+{
+  uint64_t               FileSize;
+  int64_t                FileTime;
+  uint8_t                War3Version;
+  std::vector<uint8_t>   MapSize;
+  std::vector<uint8_t>   MapInfo;
+  std::vector<uint8_t>   MapCRC;
+  std::vector<uint8_t>   MapSHA1;
+  std::vector<uint8_t>   MapHash;
+  std::vector<uint8_t>   MapWidth;
+  std::vector<uint8_t>   MapHeight;
+  uint32_t               MapOptions;
+  uint32_t               MapNumPlayers;
+  uint32_t               MapNumTeams;
+  uint32_t               MapFilterType;
+  std::vector<CGameSlot> Slots;
+};
+
+//
+// CMapCache
+//
+
+// the calculated metadata of every map we've loaded, kept in a text file so loading a map we've seen before doesn't have to hash it again
+// the whole file is read on startup and rewritten (it's small) whenever an entry is added or replaced
+
+class CMapCache final
+{
+private:
+  std::mutex                            m_Mutex;
+  std::map<std::string, CMapCacheEntry> m_Entries; // map file path -> metadata
+  std::string                           m_File;
+
+  bool Write();
+
+public:
+  explicit CMapCache(std::string nFile);
+  ~CMapCache();
+  CMapCache(CMapCache&) = delete;
+  CMapCache& operator=(CMapCache&) = delete;
+
+  // returns false if there's no entry for this file or it was calculated from a different version of it
+
+  bool Get(const std::string& file, uint64_t fileSize, int64_t fileTime, uint8_t war3Version, CMapCacheEntry* entry);
+  void Put(const std::string& file, const CMapCacheEntry& entry);
+};
+
+//
+// CMapLoadSettings
+//
+
+// the bot settings a map is loaded with
+// they're copied when the load starts since the main thread can change them (e.g. on a config reload) while a map loads on another thread
+
+struct CMapLoadSettings
+{
+  std::string MapPath;            // config value: map path
+  std::string MapCFGPath;         // config value: map cfg path, common.j and blizzard.j are read from here
+  uint8_t     LANWar3Version;     // config value: LAN warcraft 3 version
+  uint8_t     ScriptsWar3Version; // the warcraft 3 version common.j and blizzard.j were extracted for
+};
+
+//
+// CMap
+//
 
 class CMap
 {
@@ -114,7 +254,8 @@ private:
   std::string            m_MapType;       // config value: map type (for stats class)
   std::string            m_MapDefaultHCL; // config value: map default HCL to use (this should really be specified elsewhere and not part of the map config)
   std::string            m_MapLocalPath;  // config value: map local path
-  std::string            m_MapData;       // the map data itself, for sending the map to players
+  std::vector<uint8_t>   m_MapDataHash;   // the sha1 of the map data itself, its key in CMapDataCache (map_hash might be overridden by the config)
+  CMapData               m_MapData;       // the map data itself, for sending the map to players (mapped and shared, see CMapDataCache)
   uint32_t               m_MapOptions;
   uint32_t               m_MapNumPlayers; // config value: max map number of players
   uint32_t               m_MapNumTeams;   // config value: max map number of teams
@@ -129,7 +270,7 @@ private:
   bool                   m_Valid;
 
 public:
-  CMap(CAura* nAura, CConfig* CFG, const std::string& nCFGFile);
+  CMap(CAura* nAura, const CMapLoadSettings& settings, CConfig* CFG, const std::string& nCFGFile);
   ~CMap();
 
   inline bool                   GetValid() const { return m_Valid; }
@@ -153,15 +294,17 @@ public:
   inline std::string            GetMapType() const { return m_MapType; }
   inline std::string            GetMapDefaultHCL() const { return m_MapDefaultHCL; }
   inline std::string            GetMapLocalPath() const { return m_MapLocalPath; }
-  inline std::string*           GetMapData() { return &m_MapData; }
+  CByteSpan                     GetMapData() const;
+  inline std::vector<uint8_t>   GetMapDataHash() const { return m_MapDataHash; }
+  inline uint32_t               GetMapPartCRC(uint32_t start) const { return m_MapData->GetPartCRC(start); }
   inline uint32_t               GetMapNumPlayers() const { return m_MapNumPlayers; }
   inline uint32_t               GetMapNumTeams() const { return m_MapNumTeams; }
   inline std::vector<CGameSlot> GetSlots() const { return m_Slots; }
 
-  void Load(CConfig* CFG, const std::string& nCFGFile);
+  void Load(const CMapLoadSettings& settings, CConfig* CFG, const std::string& nCFGFile);
   const char* CheckValid();
-  uint32_t XORRotateLeft(uint8_t* data, uint32_t length);
-  uint32_t ChunkedChecksum(uint8_t* data, int32_t length, uint32_t checksum);
+  static uint32_t XORRotateLeft(const uint8_t* data, uint32_t length, bool accelerate = true); // accelerate = false never uses AVX2 (for testing)
+  static uint32_t ChunkedChecksum(const uint8_t* data, int32_t length, uint32_t checksum);
 };
 
 #endif // AURA_MAP_H_
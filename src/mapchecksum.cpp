@@ -0,0 +1,152 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+// the checksums CMap :: Load calculates map_crc with
+// they're kept apart from the rest of CMap so they can be tested and timed without StormLib (see bench/bench.cpp)
+
+#include "map.h"
+#include "gameslot.h"
+#include "cpu.h"
+
+#include <algorithm>
+
+#ifdef AURA_X86
+#include <immintrin.h>
+#endif
+
+#define ROTL(x, n) ((x) << (n)) | ((x) >> (32 - (n))) // this won't work with signed types
+
+using namespace std;
+
+// these xor every whole block of 32 words in data into the 32 lanes of CMap :: XORRotateLeft and return the number of words done
+
+#ifdef AURA_X86
+AURA_TARGET("avx2") static uint32_t XORLanesAVX2(const uint8_t* data, uint32_t words, uint32_t lanes[32])
+{
+  __m256i  Acc[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+  uint32_t i      = 0;
+
+  for (; i + 32 <= words; i += 32)
+  {
+    for (uint32_t j = 0; j < 4; ++j)
+      Acc[j] = _mm256_xor_si256(Acc[j], _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i * 4) + j));
+  }
+
+  for (uint32_t j = 0; j < 4; ++j)
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes) + j, Acc[j]);
+
+  return i;
+}
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+static uint32_t XORLanesSSE2(const uint8_t* data, uint32_t words, uint32_t lanes[32])
+{
+  __m128i  Acc[8];
+  uint32_t i = 0;
+
+  for (uint32_t j = 0; j < 8; ++j)
+    Acc[j] = _mm_setzero_si128();
+
+  for (; i + 32 <= words; i += 32)
+  {
+    for (uint32_t j = 0; j < 8; ++j)
+      Acc[j] = _mm_xor_si128(Acc[j], _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * 4) + j));
+  }
+
+  for (uint32_t j = 0; j < 8; ++j)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes) + j, Acc[j]);
+
+  return i;
+}
+#endif
+
+//
+// CMap
+//
+
+uint32_t CMap::XORRotateLeft(const uint8_t* data, uint32_t length, bool accelerate)
+{
+  // a big thank you to Strilanc for figuring this out
+  // every word is xored in and then rotated left by 3 bits for each word that follows it, so the result is the xor of ROTL(word i, 3 * (words - i))
+  // 3 and 32 are coprime so the rotations repeat every 32 words, the words are xored into 32 lanes (one per rotation) and only the lanes are rotated at the end
+  // this gets rid of the dependency on the previous value and the xors can run 16 or 32 bytes at a time
+
+  const uint32_t Words     = length / 4;
+  uint32_t       Lanes[32] = {0};
+  uint32_t       i         = 0;
+
+  // AVX2 if the CPU has it (checked once since ChunkedChecksum calls this for every 1 KB), otherwise SSE2 if the build has it
+  // neither does anything with less than one block so it doesn't matter that SSE2 runs again then
+
+#ifdef AURA_X86
+  static const bool AVX2 = CPUHasAVX2();
+
+  if (accelerate && AVX2)
+    i = XORLanesAVX2(data, Words, Lanes);
+#else
+  (void)accelerate;
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+  if (i == 0)
+    i = XORLanesSSE2(data, Words, Lanes);
+#endif
+
+  // what's left (or everything without SIMD), the words are little endian
+
+  for (; i < Words; i += 32)
+  {
+    const uint8_t* Block = data + i * 4;
+    const uint32_t Count = min<uint32_t>(32, Words - i);
+
+    for (uint32_t j = 0; j < Count; ++j)
+      Lanes[j] ^= static_cast<uint32_t>(Block[j * 4]) | static_cast<uint32_t>(Block[j * 4 + 1]) << 8 | static_cast<uint32_t>(Block[j * 4 + 2]) << 16 | static_cast<uint32_t>(Block[j * 4 + 3]) << 24;
+  }
+
+  // word i is in lane i % 32 and is rotated by 3 * (words - i) bits, the unsigned wraparound doesn't matter since 2^32 is a multiple of 32
+
+  uint32_t Val = 0;
+
+  for (uint32_t j = 0; j < 32; ++j)
+  {
+    const uint32_t Bits = (3 * (Words - j)) % 32;
+    Val ^= Bits == 0 ? Lanes[j] : ROTL(Lanes[j], Bits);
+  }
+
+  // the trailing bytes are xored in one at a time
+
+  for (i = Words * 4; i < length; ++i)
+    Val = ROTL(Val ^ data[i], 3);
+
+  return Val;
+}
+
+uint32_t CMap::ChunkedChecksum(const uint8_t* data, int32_t length, uint32_t checksum)
+{
+	int32_t index = 0;
+	int32_t t = length - 0x400;
+	while (index <= t)
+	{
+		checksum = ROTL(checksum ^ XORRotateLeft(&data[index], 0x400), 3);
+		index += 0x400;
+	}
+	return checksum;
+}
@@ -0,0 +1,511 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+#include "mapserver.h"
+#include "gameslot.h"
+#include "map.h"
+#include "includes.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#ifndef WIN32
+#include <poll.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+using namespace std;
+
+#define MAPSERVER_MAX_CLIENTS 32
+#define MAPSERVER_MAX_REQUEST 8192
+#define MAPSERVER_TIMEOUT 30        // seconds without any progress before a connection is dropped
+#define MAPSERVER_MAX_SEND 262144   // the most bytes sent to one connection before the others get a turn
+
+static int32_t GetSocketError()
+{
+#ifdef WIN32
+  return WSAGetLastError();
+#else
+  return errno;
+#endif
+}
+
+static void SetNonBlocking(SOCKET s)
+{
+#ifdef WIN32
+  int32_t iMode = 1;
+  ioctlsocket(s, FIONBIO, (u_long FAR*)&iMode);
+#else
+  fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+static int HexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  else if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  else if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+
+  return -1;
+}
+
+// percent decodes the file name part of a request and drops anything that doesn't belong in a Content-Disposition header
+
+static string DecodeFileName(const string& encoded)
+{
+  string Decoded;
+
+  for (uint32_t i = 0; i < encoded.size(); ++i)
+  {
+    char c = encoded[i];
+
+    if (c == '%' && i + 2 < encoded.size() && HexValue(encoded[i + 1]) != -1 && HexValue(encoded[i + 2]) != -1)
+    {
+      c = static_cast<char>(HexValue(encoded[i + 1]) * 16 + HexValue(encoded[i + 2]));
+      i += 2;
+    }
+
+    if (static_cast<uint8_t>(c) >= 32 && c != '"' && c != '\\' && c != '/' && c != 127)
+      Decoded += c;
+  }
+
+  return Decoded;
+}
+
+static string EncodeFileName(const string& name)
+{
+  static const char Digits[] = "0123456789ABCDEF";
+  string            Encoded;
+
+  for (const auto& c : name)
+  {
+    if (isalnum(static_cast<uint8_t>(c)) || c == '-' || c == '_' || c == '.' || c == '~')
+      Encoded += c;
+    else
+    {
+      Encoded += '%';
+      Encoded += Digits[static_cast<uint8_t>(c) >> 4];
+      Encoded += Digits[static_cast<uint8_t>(c) & 15];
+    }
+  }
+
+  return Encoded;
+}
+
+//
+// CMapServerClient
+//
+
+CMapServerClient::CMapServerClient(SOCKET nSocket)
+  : m_Socket(nSocket),
+    m_Offset(0),
+    m_End(0),
+    m_LastActive(GetTime()),
+    m_Responding(false)
+{
+  SetNonBlocking(m_Socket);
+}
+
+CMapServerClient::~CMapServerClient()
+{
+  closesocket(m_Socket);
+}
+
+void CMapServerClient::Respond(const string& status, const string& headers)
+{
+  // every response closes the connection afterwards, nobody downloads more than one map at a time so keep-alive isn't worth the trouble
+
+  m_Header     = "HTTP/1.1 " + status + "\r\n" + headers + (m_Data ? string() : string("Content-Length: 0\r\n")) + "Connection: close\r\n\r\n";
+  m_Responding = true;
+}
+
+void CMapServerClient::ParseRequest()
+{
+  // the request line is "<method> /<sha1 in hex>[/<file name>] HTTP/1.x"
+
+  const string::size_type LineEnd = m_Request.find("\r\n");
+  const string            Line    = m_Request.substr(0, LineEnd);
+  const string::size_type Space1  = Line.find(' ');
+  const string::size_type Space2  = Line.find(' ', Space1 == string::npos ? 0 : Space1 + 1);
+
+  if (Space1 == string::npos || Space2 == string::npos)
+  {
+    Respond("400 Bad Request", string());
+    return;
+  }
+
+  const string Method = Line.substr(0, Space1);
+  string       Target = Line.substr(Space1 + 1, Space2 - Space1 - 1);
+
+  if (Method != "GET" && Method != "HEAD")
+  {
+    Respond("405 Method Not Allowed", "Allow: GET, HEAD\r\n");
+    return;
+  }
+
+  Target = Target.substr(0, Target.find('?'));
+
+  vector<uint8_t> Hash;
+
+  if (Target.size() >= 41 && Target[0] == '/' && (Target.size() == 41 || Target[41] == '/'))
+  {
+    for (uint32_t i = 1; i < 41; i += 2)
+    {
+      const int High = HexValue(Target[i]);
+      const int Low  = HexValue(Target[i + 1]);
+
+      if (High == -1 || Low == -1)
+        break;
+
+      Hash.push_back(static_cast<uint8_t>(High * 16 + Low));
+    }
+  }
+
+  if (Hash.size() == 20)
+    m_Data = CMapDataCache::GetDefault()->Find(Hash);
+
+  if (!m_Data || m_Data->empty())
+  {
+    m_Data.reset();
+    Respond("404 Not Found", string());
+    return;
+  }
+
+  string FileName = Target.size() > 42 ? DecodeFileName(Target.substr(42)) : string();
+
+  if (FileName.empty())
+    FileName = Target.substr(1, 40) + ".w3x";
+
+  // look for a single byte range, anything fancier (e.g. several ranges) just gets the whole file which is allowed
+
+  const uint32_t Size  = m_Data->size();
+  uint32_t       Start = 0;
+  uint32_t       End   = Size;
+  bool           Range = false;
+
+  string Lower = m_Request;
+  transform(begin(Lower), end(Lower), begin(Lower), [](char c) { return static_cast<char>(tolower(static_cast<uint8_t>(c))); });
+  const string::size_type RangeStart = Lower.find("\r\nrange:");
+
+  if (RangeStart != string::npos)
+  {
+    string Value = Lower.substr(RangeStart + 8, Lower.find("\r\n", RangeStart + 8) - RangeStart - 8);
+    Value.erase(remove(begin(Value), end(Value), ' '), end(Value));
+    const string::size_type Dash = Value.find('-');
+
+    if (Value.compare(0, 6, "bytes=") == 0 && Dash != string::npos && Value.find(',') == string::npos)
+    {
+      const string First = Value.substr(6, Dash - 6);
+      const string Last  = Value.substr(Dash + 1);
+
+      try
+      {
+        if (First.empty() && !Last.empty())
+        {
+          // the last n bytes, asking for the last 0 bytes can't be satisfied
+
+          const uint64_t Suffix = min<uint64_t>(stoull(Last), Size);
+
+          if (Suffix == 0)
+          {
+            m_Data.reset();
+            Respond("416 Range Not Satisfiable", "Content-Range: bytes */" + to_string(Size) + "\r\n");
+            return;
+          }
+
+          Start = Size - static_cast<uint32_t>(Suffix);
+          Range = true;
+        }
+        else if (!First.empty())
+        {
+          const uint64_t FirstByte = stoull(First);
+          const uint64_t LastByte  = Last.empty() ? Size - 1 : min<uint64_t>(stoull(Last), Size - 1);
+
+          if (FirstByte >= Size || LastByte < FirstByte)
+          {
+            m_Data.reset();
+            Respond("416 Range Not Satisfiable", "Content-Range: bytes */" + to_string(Size) + "\r\n");
+            return;
+          }
+
+          Start = static_cast<uint32_t>(FirstByte);
+          End   = static_cast<uint32_t>(LastByte + 1);
+          Range = true;
+        }
+      }
+      catch (...)
+      {
+        Start = 0;
+        End   = Size;
+        Range = false;
+      }
+    }
+  }
+
+  string Headers = "Content-Type: application/octet-stream\r\nContent-Length: " + to_string(End - Start) + "\r\nAccept-Ranges: bytes\r\nContent-Disposition: attachment; filename=\"" + FileName + "\"\r\n";
+
+  if (Range)
+    Headers += "Content-Range: bytes " + to_string(Start) + "-" + to_string(End - 1) + "/" + to_string(Size) + "\r\n";
+
+  Respond(Range ? "206 Partial Content" : "200 OK", Headers);
+
+  if (Method == "GET")
+  {
+    m_Offset = Start;
+    m_End    = End;
+  }
+}
+
+bool CMapServerClient::Update(bool readable, bool writable, atomic<uint64_t>* bytesSent)
+{
+  const int64_t Time = GetTime();
+
+  if (!m_Responding && readable)
+  {
+    char Buffer[1024];
+
+    while (true)
+    {
+      const int c = recv(m_Socket, Buffer, sizeof(Buffer), 0);
+
+      if (c > 0)
+      {
+        m_Request.append(Buffer, c);
+        m_LastActive = Time;
+
+        if (m_Request.size() > MAPSERVER_MAX_REQUEST)
+          return false;
+      }
+      else if (c == 0 || GetSocketError() != EWOULDBLOCK)
+        return false;
+      else
+        break;
+    }
+
+    if (m_Request.find("\r\n\r\n") != string::npos)
+    {
+      ParseRequest();
+      writable = true;
+    }
+  }
+
+  if (m_Responding && writable)
+  {
+    uint32_t Sent = 0;
+
+    while (!m_Header.empty())
+    {
+      const int c = send(m_Socket, m_Header.data(), static_cast<int>(m_Header.size()), MSG_NOSIGNAL);
+
+      if (c > 0)
+      {
+        m_Header.erase(0, c);
+        m_LastActive = Time;
+      }
+      else if (c == SOCKET_ERROR && GetSocketError() == EWOULDBLOCK)
+        return Time - m_LastActive < MAPSERVER_TIMEOUT;
+      else
+        return false;
+    }
+
+    while (m_Offset < m_End && Sent < MAPSERVER_MAX_SEND)
+    {
+      const uint32_t Size = min<uint32_t>(m_End - m_Offset, MAPSERVER_MAX_SEND - Sent);
+
+#ifdef __linux__
+      // the map is already in the page cache (it's mapped) so let the kernel copy it straight to the socket
+
+      off_t         Offset = m_Offset;
+      const ssize_t c      = sendfile(m_Socket, m_Data->GetFile().GetFD(), &Offset, Size);
+#else
+      const int c = send(m_Socket, reinterpret_cast<const char*>(m_Data->data() + m_Offset), static_cast<int>(Size), MSG_NOSIGNAL);
+#endif
+
+      if (c > 0)
+      {
+        m_Offset += c;
+        Sent += c;
+        m_LastActive = Time;
+      }
+      else if (c < 0 && GetSocketError() == EWOULDBLOCK)
+        break;
+      else
+        return false;
+    }
+
+    *bytesSent += Sent;
+
+    if (m_Offset >= m_End)
+      return false;
+  }
+
+  return Time - m_LastActive < MAPSERVER_TIMEOUT;
+}
+
+//
+// CMapServer
+//
+
+CMapServer::CMapServer(const string& address, uint16_t port, const string& url)
+  : m_BytesSent(0),
+    m_URL(url),
+    m_Socket(socket(AF_INET, SOCK_STREAM, 0)),
+    m_Exiting(false)
+{
+  // strip the trailing slash so we can append the path as is
+
+  while (!m_URL.empty() && m_URL.back() == '/')
+    m_URL.pop_back();
+
+  struct sockaddr_in SIN;
+  memset(&SIN, 0, sizeof(SIN));
+  SIN.sin_family = AF_INET;
+  SIN.sin_port   = htons(port);
+
+  if (address.empty() || (SIN.sin_addr.s_addr = inet_addr(address.c_str())) == INADDR_NONE)
+    SIN.sin_addr.s_addr = INADDR_ANY;
+
+  int32_t optval = 1;
+  setsockopt(m_Socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&optval), sizeof(int32_t));
+
+  if (m_Socket == INVALID_SOCKET || ::bind(m_Socket, reinterpret_cast<struct sockaddr*>(&SIN), sizeof(SIN)) == SOCKET_ERROR || listen(m_Socket, 8) == SOCKET_ERROR)
+  {
+    Print("[MAPSERVER] error listening for map downloads on port " + to_string(port) + " - error " + to_string(GetSocketError()), LOG_ERROR);
+
+    if (m_Socket != INVALID_SOCKET)
+      closesocket(m_Socket);
+
+    m_Socket = INVALID_SOCKET;
+    return;
+  }
+
+  SetNonBlocking(m_Socket);
+  Print("[MAPSERVER] listening for map downloads on " + (address.empty() ? string("0.0.0.0") : address) + ":" + to_string(port));
+
+  if (m_URL.empty())
+    Print("[MAPSERVER] bot_mapserverurl is empty, the download URL won't be announced to players");
+
+  m_Thread = thread(&CMapServer::Run, this);
+}
+
+CMapServer::~CMapServer()
+{
+  m_Exiting = true;
+
+  if (m_Thread.joinable())
+    m_Thread.join();
+
+  for (auto& client : m_Clients)
+    delete client;
+
+  if (m_Socket != INVALID_SOCKET)
+    closesocket(m_Socket);
+}
+
+string CMapServer::GetMapURL(const CMap* map) const
+{
+  const vector<uint8_t> Hash = map->GetMapDataHash();
+
+  if (m_URL.empty() || Hash.size() != 20 || map->GetMapData().empty())
+    return string();
+
+  static const char Digits[] = "0123456789abcdef";
+  string            URL      = m_URL + "/";
+
+  for (const auto& b : Hash)
+  {
+    URL += Digits[b >> 4];
+    URL += Digits[b & 15];
+  }
+
+  string                  FileName = map->GetMapLocalPath();
+  const string::size_type Slash    = FileName.find_last_of("/\\");
+
+  if (Slash != string::npos)
+    FileName = FileName.substr(Slash + 1);
+
+  return URL + "/" + EncodeFileName(FileName);
+}
+
+void CMapServer::Run()
+{
+  vector<struct pollfd> Fds;
+
+  while (!m_Exiting)
+  {
+    // the listening socket is first, followed by the clients in order
+    // a client is either waiting for its request or sending its response, never both
+
+    Fds.clear();
+    Fds.push_back(pollfd());
+    Fds.back().fd     = m_Socket;
+    Fds.back().events = m_Clients.size() < MAPSERVER_MAX_CLIENTS ? POLLIN : 0;
+
+    for (const auto& client : m_Clients)
+    {
+      Fds.push_back(pollfd());
+      Fds.back().fd     = client->GetSocket();
+      Fds.back().events = client->GetResponding() ? POLLOUT : POLLIN;
+    }
+
+    // wake up regularly to notice we're exiting and to time out idle connections
+
+#ifdef WIN32
+    WSAPoll(Fds.data(), static_cast<ULONG>(Fds.size()), 100);
+#else
+    poll(Fds.data(), Fds.size(), 100);
+#endif
+
+    for (uint32_t i = 0; i < m_Clients.size(); ++i)
+    {
+      const short Events = Fds[i + 1].revents;
+
+      // errors and hangups are treated as readable/writable so the recv or send notices them
+
+      if (!m_Clients[i]->Update((Events & (POLLIN | POLLERR | POLLHUP)) != 0, (Events & (POLLOUT | POLLERR | POLLHUP)) != 0, &m_BytesSent))
+      {
+        delete m_Clients[i];
+        m_Clients[i] = nullptr;
+      }
+    }
+
+    m_Clients.erase(remove(begin(m_Clients), end(m_Clients), nullptr), end(m_Clients));
+
+    if (Fds[0].revents & POLLIN)
+    {
+      while (m_Clients.size() < MAPSERVER_MAX_CLIENTS)
+      {
+        const SOCKET NewSocket = accept(m_Socket, nullptr, nullptr);
+
+        if (NewSocket == INVALID_SOCKET)
+          break;
+
+        m_Clients.push_back(new CMapServerClient(NewSocket));
+      }
+    }
+  }
+}
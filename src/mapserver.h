@@ -0,0 +1,102 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+#ifndef AURA_MAPSERVER_H_
+#define AURA_MAPSERVER_H_
+
+#include "socket.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+class CMap;
+class CMapFile;
+
+//
+// CMapServerClient
+//
+
+// one HTTP connection to the map server, it answers a single request and is then closed
+
+class CMapServerClient final
+{
+private:
+  SOCKET                          m_Socket;
+  std::string                     m_Request;    // the request received so far
+  std::string                     m_Header;     // the unsent part of the response header
+  std::shared_ptr<const CMapFile> m_Data;       // the map being sent, this keeps it mapped until we're done
+  uint32_t                        m_Offset;     // the next byte of the map to send
+  uint32_t                        m_End;        // one past the last byte of the map to send
+  int64_t                         m_LastActive; // the last time (in seconds) anything was received or sent
+  bool                            m_Responding; // true once the request has been parsed
+
+  void Respond(const std::string& status, const std::string& headers);
+  void ParseRequest();
+
+public:
+  CMapServerClient(SOCKET nSocket);
+  ~CMapServerClient();
+  CMapServerClient(CMapServerClient&) = delete;
+
+  inline SOCKET GetSocket() const { return m_Socket; }
+  inline bool   GetResponding() const { return m_Responding; }
+
+  // returns false once the connection should be closed, bytesSent is incremented by the number of map bytes sent
+
+  bool Update(bool readable, bool writable, std::atomic<uint64_t>* bytesSent);
+};
+
+//
+// CMapServer
+//
+
+// a small HTTP server so players can download the map with a browser or a launcher instead of through the game protocol (see bot_mapserverport)
+// maps are requested by the sha1 of their data (/<40 hex digits>[/<file name>]) and only the maps in CMapDataCache are served
+// i.e. the map currently loaded, any map still used by a lobby or a game, and the last few maps loaded
+// it runs on its own thread so large downloads never compete with the game traffic, on linux the file is sent with sendfile
+// range requests are supported so interrupted downloads can be resumed
+
+class CMapServer final
+{
+private:
+  std::vector<CMapServerClient*> m_Clients;
+  std::thread                    m_Thread;
+  std::atomic<uint64_t>          m_BytesSent; // map bytes sent since startup
+  std::string                    m_URL;       // the public base URL of the server, e.g. http://example.com:6113
+  SOCKET                         m_Socket;    // the listening socket
+  std::atomic<bool>              m_Exiting;
+
+  void Run();
+
+public:
+  CMapServer(const std::string& address, uint16_t port, const std::string& url);
+  ~CMapServer();
+  CMapServer(CMapServer&) = delete;
+
+  inline bool     GetListening() const { return m_Socket != INVALID_SOCKET; }
+  inline uint64_t GetBytesSent() const { return m_BytesSent; }
+
+  // the download URL of a map, empty if the map has no data or bot_mapserverurl isn't set
+
+  std::string GetMapURL(const CMap* map) const;
+};
+
+#endif // AURA_MAPSERVER_H_
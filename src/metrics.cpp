@@ -0,0 +1,253 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+
+#include "metrics.h"
+#include "aura.h"
+#include "auradb.h"
+#include "bnet.h"
+#include "game.h"
+#include "histogram.h"
+#include "map.h"
+#include "mapserver.h"
+#include "socket.h"
+#include "includes.h"
+
+using namespace std;
+
+// the Prometheus text format, see https://prometheus.io/docs/instrumenting/exposition_formats/
+
+static void AppendHeader(string& out, const string& name, const string& type, const string& help)
+{
+  out += "# HELP " + name + " " + help + "\n";
+  out += "# TYPE " + name + " " + type + "\n";
+}
+
+static void AppendMetric(string& out, const string& name, const string& type, const string& help, uint64_t value)
+{
+  AppendHeader(out, name, type, help);
+  out += name + " " + to_string(value) + "\n";
+}
+
+static string EscapeLabel(const string& value)
+{
+  string Escaped;
+
+  for (const auto& c : value)
+  {
+    if (c == '\\' || c == '"')
+      Escaped += '\\';
+
+    if (c == '\n')
+      Escaped += "\\n";
+    else
+      Escaped += c;
+  }
+
+  return Escaped;
+}
+
+static void AppendSummary(string& out, const string& name, const string& help, const CHistogram& histogram, double scale)
+{
+  // the histograms record integers (microseconds or milliseconds), scale converts them to seconds
+
+  AppendHeader(out, name, "summary", help);
+
+  for (const auto& quantile : {"0.5", "0.9", "0.99", "0.999"})
+    out += name + "{quantile=\"" + quantile + "\"} " + to_string(histogram.GetValueAtPercentile(stod(quantile) * 100) * scale) + "\n";
+
+  out += name + "_sum " + to_string(histogram.GetSum() * scale) + "\n";
+  out += name + "_count " + to_string(histogram.GetCount()) + "\n";
+}
+
+//
+// CMetricsServer
+//
+
+CMetricsServer::CMetricsServer(CAura* nAura, const string& address, uint16_t port)
+  : m_Aura(nAura),
+    m_Socket(new CTCPServer())
+{
+  if (m_Socket->Listen(address, port))
+    Print("[METRICS] listening for metrics requests on " + (address.empty() ? string("0.0.0.0") : address) + ":" + to_string(port));
+  else
+  {
+    Print("[METRICS] error listening for metrics requests on port " + to_string(port));
+    delete m_Socket;
+    m_Socket = nullptr;
+  }
+}
+
+CMetricsServer::~CMetricsServer()
+{
+  for (auto& client : m_Clients)
+    delete client;
+
+  for (auto& client : m_Responses)
+    delete client;
+
+  delete m_Socket;
+}
+
+uint32_t CMetricsServer::SetFD(void* fd, void* send_fd, int32_t* nfds)
+{
+  if (!m_Socket)
+    return 0;
+
+  uint32_t NumFDs = 1;
+  m_Socket->SetFD(static_cast<fd_set*>(fd), static_cast<fd_set*>(send_fd), nfds);
+
+  for (auto& client : m_Clients)
+  {
+    client->SetFD(static_cast<fd_set*>(fd), static_cast<fd_set*>(send_fd), nfds);
+    ++NumFDs;
+  }
+
+  for (auto& client : m_Responses)
+  {
+    client->SetFD(static_cast<fd_set*>(fd), static_cast<fd_set*>(send_fd), nfds);
+    ++NumFDs;
+  }
+
+  return NumFDs;
+}
+
+void CMetricsServer::Update(void* fd, void* send_fd)
+{
+  if (!m_Socket)
+    return;
+
+  const int64_t Time = GetTime();
+
+  // accept new connections, we don't expect more than a couple of scrapers so there's a small limit to stop anyone from hogging sockets
+
+  CTCPSocket* NewSocket = m_Socket->Accept(static_cast<fd_set*>(fd));
+
+  if (NewSocket)
+  {
+    if (m_Clients.size() + m_Responses.size() < 16)
+      m_Clients.push_back(NewSocket);
+    else
+      delete NewSocket;
+  }
+
+  // wait for each connection to send a complete request (we don't care what it asked for)
+
+  for (auto i = begin(m_Clients); i != end(m_Clients);)
+  {
+    CTCPSocket* Client = *i;
+    Client->DoRecv(static_cast<fd_set*>(fd));
+
+    const CRecvBuffer* Recv    = Client->GetRecvBuffer();
+    const string       Request = string(reinterpret_cast<const char*>(Recv->GetData()), Recv->GetSize());
+
+    if (Client->HasError() || !Client->GetConnected() || Time - Client->GetLastRecv() >= 5 || Request.size() > 8192)
+    {
+      delete Client;
+      i = m_Clients.erase(i);
+      continue;
+    }
+
+    if (Request.find("\r\n\r\n") != string::npos)
+    {
+      const string Body = GetMetrics();
+      Client->PutBytes("HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + to_string(Body.size()) + "\r\nConnection: close\r\n\r\n" + Body);
+      Client->ClearRecvBuffer();
+      m_Responses.push_back(Client);
+      i = m_Clients.erase(i);
+      continue;
+    }
+
+    ++i;
+  }
+
+  // send the responses and close the connections once they're out
+
+  for (auto i = begin(m_Responses); i != end(m_Responses);)
+  {
+    CTCPSocket* Client = *i;
+    Client->DoSend(static_cast<fd_set*>(send_fd));
+
+    if (Client->HasError() || !Client->GetConnected() || Time - Client->GetLastRecv() >= 5 || Client->GetSendQueueSize() == 0)
+    {
+      Client->Disconnect();
+      delete Client;
+      i = m_Responses.erase(i);
+      continue;
+    }
+
+    ++i;
+  }
+}
+
+string CMetricsServer::GetMetrics() const
+{
+  string Metrics;
+
+  // games and players
+  // the games in progress may belong to worker threads so hold their mutex while we look at them
+
+  uint32_t   LobbyPlayers = 0, RunningPlayers = 0, GProxyBufferPackets = 0;
+  CHistogram ActionLateBy;
+
+  if (m_Aura->m_CurrentGame)
+    LobbyPlayers = m_Aura->m_CurrentGame->GetNumHumanPlayers();
+
+  for (auto& game : m_Aura->m_Games)
+  {
+    lock_guard<mutex> Lock(game->GetMutex());
+    RunningPlayers += game->GetNumHumanPlayers();
+    GProxyBufferPackets += game->GetGProxyBufferSize();
+    ActionLateBy.Merge(game->GetPerfActionLateBy());
+  }
+
+  AppendMetric(Metrics, "aura_games_lobby", "gauge", "Number of games in the lobby.", m_Aura->m_CurrentGame ? 1 : 0);
+  AppendMetric(Metrics, "aura_games_running", "gauge", "Number of games in progress.", m_Aura->m_Games.size());
+  AppendHeader(Metrics, "aura_players", "gauge", "Number of human players in the lobby and in games in progress.");
+  Metrics += "aura_players{state=\"lobby\"} " + to_string(LobbyPlayers) + "\n";
+  Metrics += "aura_players{state=\"running\"} " + to_string(RunningPlayers) + "\n";
+  AppendMetric(Metrics, "aura_gproxy_buffer_packets", "gauge", "Packets held in GProxy++ reconnect buffers across all games in progress.", GProxyBufferPackets);
+  AppendMetric(Metrics, "aura_map_download_bytes_total", "counter", "Map bytes sent to downloading players.", m_Aura->m_MapBytesSent);
+  AppendMetric(Metrics, "aura_mapserver_bytes_total", "counter", "Map bytes sent by the HTTP map server.", m_Aura->m_MapServer ? m_Aura->m_MapServer->GetBytesSent() : 0);
+  AppendMetric(Metrics, "aura_map_data_bytes", "gauge", "Map file bytes held in memory, shared by the bot and every lobby.", CMapDataCache::GetDefault()->GetNumBytes());
+  AppendMetric(Metrics, "aura_send_bytes_copied_total", "counter", "Bytes copied into socket send queues.", CSendQueue::GetBytesCopied());
+  AppendMetric(Metrics, "aura_db_statement_prepares_total", "counter", "Database statements prepared.", m_Aura->m_DB->GetStatementPrepares());
+  AppendMetric(Metrics, "aura_db_statement_cache_hits_total", "counter", "Database statements reused from the statement cache.", m_Aura->m_DB->GetStatementCacheHits());
+
+  // battle.net connections
+
+  AppendHeader(Metrics, "aura_bnet_logged_in", "gauge", "Whether the battle.net connection is logged in.");
+
+  for (auto& bnet : m_Aura->m_BNETs)
+    Metrics += "aura_bnet_logged_in{server=\"" + EscapeLabel(bnet->GetServer()) + "\"} " + (bnet->GetLoggedIn() ? "1" : "0") + "\n";
+
+  AppendHeader(Metrics, "aura_bnet_out_packets", "gauge", "Chat packets waiting in the battle.net send queue.");
+
+  for (auto& bnet : m_Aura->m_BNETs)
+    Metrics += "aura_bnet_out_packets{server=\"" + EscapeLabel(bnet->GetServer()) + "\"} " + to_string(bnet->GetOutPacketsQueued()) + "\n";
+
+  // latencies
+
+  AppendSummary(Metrics, "aura_update_seconds", "Time spent processing each main loop iteration (not counting the time spent blocking).", m_Aura->m_PerfUpdate, 1e-6);
+  AppendSummary(Metrics, "aura_action_late_seconds", "How late action packets were sent in the games in progress.", ActionLateBy, 1e-3);
+  AppendSummary(Metrics, "aura_db_query_seconds", "Time spent executing database statements.", m_Aura->m_DB->GetQueryTimes(), 1e-6);
+
+  return Metrics;
+}
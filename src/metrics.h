@@ -0,0 +1,63 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+
+#ifndef AURA_METRICS_H_
+#define AURA_METRICS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//
+// CMetricsServer
+//
+
+// a minimal HTTP listener which serves the bot's counters and gauges in the Prometheus text format (see bot_metricsport)
+// it runs on the main thread like everything else, the sockets are non blocking and the page is only built when someone asks for it
+// every request gets the metrics (no matter the path) and the connection is closed once the response has been sent
+
+class CAura;
+class CTCPServer;
+class CTCPSocket;
+class CHistogram;
+
+class CMetricsServer final
+{
+private:
+  CAura*                   m_Aura;
+  CTCPServer*              m_Socket;    // the listening socket
+  std::vector<CTCPSocket*> m_Clients;   // connections which haven't sent a complete request yet
+  std::vector<CTCPSocket*> m_Responses; // connections we're sending a response to
+
+  std::string GetMetrics() const;
+
+public:
+  CMetricsServer(CAura* nAura, const std::string& address, uint16_t port);
+  ~CMetricsServer();
+  CMetricsServer(CMetricsServer&) = delete;
+
+  inline bool GetListening() const { return m_Socket != nullptr; }
+
+  uint32_t SetFD(void* fd, void* send_fd, int32_t* nfds);
+  void Update(void* fd, void* send_fd);
+};
+
+#endif // AURA_METRICS_H_
@@ -17,9 +17,100 @@
  */
 
 #include "sha1.h"
+#include "cpu.h"
 
-CSHA1::CSHA1()
+#ifdef AURA_X86
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+// the SHA extensions do four rounds per instruction and compute the message schedule in the same registers
+// the message words for the rounds in group G (4 rounds each) end up in Msg[G % 4], their schedule is finished over the three groups before that
+// see "New Instructions Supporting the Secure Hash Algorithm on Intel Architecture Processors" (Gulley et al., Intel 2013)
+
+template <uint32_t G>
+AURA_TARGET("sha,ssse3,sse4.1") static inline void SHANIRounds(__m128i& abcd, __m128i& e0, __m128i& e1, __m128i msg[4])
 {
+  __m128i& E    = (G & 1) ? e1 : e0;
+  __m128i& Next = (G & 1) ? e0 : e1;
+
+  if (G == 0)
+    E = _mm_add_epi32(E, msg[0]);
+  else
+    E = _mm_sha1nexte_epu32(E, msg[G % 4]);
+
+  Next = abcd;
+
+  if (G >= 3)
+    msg[(G + 1) % 4] = _mm_sha1msg2_epu32(msg[(G + 1) % 4], msg[G % 4]);
+
+  abcd = _mm_sha1rnds4_epu32(abcd, E, G / 5);
+
+  if (G >= 2)
+    msg[(G + 2) % 4] = _mm_xor_si128(msg[(G + 2) % 4], msg[G % 4]);
+
+  if (G >= 1)
+    msg[(G + 3) % 4] = _mm_sha1msg1_epu32(msg[(G + 3) % 4], msg[G % 4]);
+}
+
+AURA_TARGET("sha,ssse3,sse4.1") static void TransformSHANI(uint32_t state[5], const uint8_t* buffer, uint32_t blocks)
+{
+  const __m128i Mask = _mm_set_epi64x(0x0001020304050607LL, 0x08090A0B0C0D0E0FLL);
+
+  __m128i ABCD = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+  __m128i E0   = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+  __m128i E1;
+
+  for (; blocks > 0; --blocks, buffer += 64)
+  {
+    const __m128i SavedABCD = ABCD;
+    const __m128i SavedE0   = E0;
+    __m128i       Msg[4];
+
+    // the message is big endian
+
+    for (uint32_t i = 0; i < 4; ++i)
+      Msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer) + i), Mask);
+
+    SHANIRounds<0>(ABCD, E0, E1, Msg);
+    SHANIRounds<1>(ABCD, E0, E1, Msg);
+    SHANIRounds<2>(ABCD, E0, E1, Msg);
+    SHANIRounds<3>(ABCD, E0, E1, Msg);
+    SHANIRounds<4>(ABCD, E0, E1, Msg);
+    SHANIRounds<5>(ABCD, E0, E1, Msg);
+    SHANIRounds<6>(ABCD, E0, E1, Msg);
+    SHANIRounds<7>(ABCD, E0, E1, Msg);
+    SHANIRounds<8>(ABCD, E0, E1, Msg);
+    SHANIRounds<9>(ABCD, E0, E1, Msg);
+    SHANIRounds<10>(ABCD, E0, E1, Msg);
+    SHANIRounds<11>(ABCD, E0, E1, Msg);
+    SHANIRounds<12>(ABCD, E0, E1, Msg);
+    SHANIRounds<13>(ABCD, E0, E1, Msg);
+    SHANIRounds<14>(ABCD, E0, E1, Msg);
+    SHANIRounds<15>(ABCD, E0, E1, Msg);
+    SHANIRounds<16>(ABCD, E0, E1, Msg);
+    SHANIRounds<17>(ABCD, E0, E1, Msg);
+    SHANIRounds<18>(ABCD, E0, E1, Msg);
+    SHANIRounds<19>(ABCD, E0, E1, Msg);
+
+    E0   = _mm_sha1nexte_epu32(E0, SavedE0);
+    ABCD = _mm_add_epi32(ABCD, SavedABCD);
+  }
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(ABCD, 0x1B));
+  state[4] = static_cast<uint32_t>(_mm_extract_epi32(E0, 3));
+}
+#endif
+
+CSHA1::CSHA1(bool accelerate)
+{
+#ifdef AURA_X86
+  m_SHANI = accelerate && CPUHasSHA();
+#else
+  (void)accelerate;
+  m_SHANI = false;
+#endif
+
   Reset();
 }
 
@@ -41,13 +132,14 @@ void CSHA1::Reset()
   m_count[1] = 0;
 }
 
-void CSHA1::Transform(uint32_t state[5], uint8_t buffer[64])
+void CSHA1::Transform(uint32_t state[5], const uint8_t buffer[64])
 {
   uint32_t a = 0, b = 0, c = 0, d = 0, e = 0;
 
-  SHA1_WORKSPACE_BLOCK* block;
-  static uint8_t        workspace[64];
-  block = reinterpret_cast<SHA1_WORKSPACE_BLOCK*>(workspace);
+  // the workspace is on the stack so several CSHA1s can be used at the same time (see CMap :: Load)
+
+  SHA1_WORKSPACE_BLOCK  workspace;
+  SHA1_WORKSPACE_BLOCK* block = &workspace;
   memcpy(block, buffer, 64);
 
   // Copy state[] to working vars
@@ -147,9 +239,23 @@ void CSHA1::Transform(uint32_t state[5], uint8_t buffer[64])
   state[4] += e;
 }
 
+void CSHA1::TransformBlocks(uint32_t state[5], const uint8_t* buffer, uint32_t blocks)
+{
+#ifdef AURA_X86
+  if (m_SHANI)
+  {
+    TransformSHANI(state, buffer, blocks);
+    return;
+  }
+#endif
+
+  for (; blocks > 0; --blocks, buffer += 64)
+    Transform(state, buffer);
+}
+
 // Use this function to hash in binary data and strings
 
-void CSHA1::Update(uint8_t* data, uint32_t len)
+void CSHA1::Update(const uint8_t* data, uint32_t len)
 {
   uint32_t i = 0, j = 0;
 
@@ -163,12 +269,9 @@ void CSHA1::Update(uint8_t* data, uint32_t len)
   if ((j + len) > 63)
   {
     memcpy(&m_buffer[j], data, (i = 64 - j));
-    Transform(m_state, m_buffer);
-
-    for (; i + 63 < len; i += 64)
-    {
-      Transform(m_state, &data[i]);
-    }
+    TransformBlocks(m_state, m_buffer, 1);
+    TransformBlocks(m_state, &data[i], (len - i) / 64);
+    i += (len - i) / 64 * 64;
 
     j = 0;
   }
@@ -81,7 +81,8 @@ public:
   };
 
   // Constructor and Destructor
-  CSHA1();
+  // accelerate = false always uses the plain transform (for testing)
+  explicit CSHA1(bool accelerate = true);
   virtual ~CSHA1();
 
   uint32_t m_state[5];
@@ -92,15 +93,18 @@ public:
   void Reset();
 
   // Update the hash value
-  void Update(uint8_t* data, uint32_t len);
+  void Update(const uint8_t* data, uint32_t len);
 
   // Finalize hash and report
   void Final();
   void GetHash(uint8_t* uDest);
 
 private:
+  bool m_SHANI; // use the SHA extensions (see CPUHasSHA)
+
   // Private SHA-1 transformation
-  void Transform(uint32_t state[5], uint8_t buffer[64]);
+  void Transform(uint32_t state[5], const uint8_t buffer[64]);
+  void TransformBlocks(uint32_t state[5], const uint8_t* buffer, uint32_t blocks);
 };
 
 #endif // AURA_SHA1_H_
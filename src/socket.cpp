@@ -39,7 +39,10 @@ int32_t GetLastError()
 
 CSocket::CSocket()
   : m_Socket(INVALID_SOCKET),
+    m_Poller(nullptr),
     m_HasError(false),
+    m_ReadReady(false),
+    m_WriteReady(false),
     m_Error(0)
 {
   memset(&m_SIN, 0, sizeof(m_SIN));
@@ -48,13 +51,18 @@ CSocket::CSocket()
 CSocket::CSocket(SOCKET nSocket, struct sockaddr_in nSIN)
   : m_Socket(nSocket),
     m_SIN(nSIN),
+    m_Poller(nullptr),
     m_HasError(false),
+    m_ReadReady(false),
+    m_WriteReady(false),
     m_Error(0)
 {
 }
 
 CSocket::~CSocket()
 {
+  Unregister();
+
   if (m_Socket != INVALID_SOCKET)
     closesocket(m_Socket);
 }
@@ -165,20 +173,221 @@ void CSocket::Allocate(int type)
   {
     m_HasError = true;
     m_Error    = GetLastError();
-    Print("[SOCKET] error (socket) - " + GetErrorString());
+    Print("[SOCKET] error (socket) - " + GetErrorString(), LOG_ERROR);
     return;
   }
 }
 
 void CSocket::Reset()
 {
+  Unregister();
+
   if (m_Socket != INVALID_SOCKET)
     closesocket(m_Socket);
 
   m_Socket = INVALID_SOCKET;
   memset(&m_SIN, 0, sizeof(m_SIN));
-  m_HasError = false;
-  m_Error    = 0;
+  m_HasError   = false;
+  m_ReadReady  = false;
+  m_WriteReady = false;
+  m_Error      = 0;
+}
+
+void CSocket::Register(CSocketPoller* poller)
+{
+  if (m_Socket == INVALID_SOCKET || m_Poller == poller)
+    return;
+
+  Unregister();
+
+  if (poller && poller->Add(this, m_Socket))
+    m_Poller = poller;
+}
+
+void CSocket::Unregister()
+{
+  if (!m_Poller)
+    return;
+
+  m_Poller->Remove(this, m_Socket);
+  m_Poller = nullptr;
+}
+
+//
+// CRecvBuffer
+//
+
+CRecvBuffer::CRecvBuffer()
+  : m_Head(0),
+    m_Tail(0)
+{
+}
+
+CRecvBuffer::~CRecvBuffer()
+{
+}
+
+uint8_t* CRecvBuffer::GetFreeSpace(uint32_t* size)
+{
+  if (m_Buffer.empty())
+    m_Buffer.resize(CAPACITY);
+
+  // move the unread bytes back to the front when there's less than a decent sized recv left at the tail
+  // by now the owner has consumed every complete packet so this is usually just a partial one
+
+  if (m_Head == m_Tail)
+    m_Head = m_Tail = 0;
+  else if (m_Head > 0 && CAPACITY - m_Tail < 16384)
+  {
+    memmove(m_Buffer.data(), m_Buffer.data() + m_Head, m_Tail - m_Head);
+    m_Tail -= m_Head;
+    m_Head = 0;
+  }
+
+  *size = CAPACITY - m_Tail;
+  return m_Buffer.data() + m_Tail;
+}
+
+void CRecvBuffer::Commit(uint32_t size)
+{
+  m_Tail += size;
+}
+
+void CRecvBuffer::Consume(uint32_t size)
+{
+  m_Head += size;
+
+  if (m_Head >= m_Tail)
+    m_Head = m_Tail = 0;
+}
+
+void CRecvBuffer::Clear()
+{
+  m_Head = m_Tail = 0;
+}
+
+bool CRecvBuffer::GetPacket(CByteSpan* packet) const
+{
+  if (GetSize() < 4)
+    return false;
+
+  const uint8_t* Data   = GetData();
+  const uint16_t Length = static_cast<uint16_t>(Data[3] << 8 | Data[2]);
+
+  if (Length < 4 || Length > GetSize())
+    return false;
+
+  *packet = CByteSpan(Data, Length);
+  return true;
+}
+
+bool CRecvBuffer::HasBadPacket() const
+{
+  // a length shorter than the header itself means we've lost track of the packet boundaries and will never find them again
+
+  return GetSize() >= 4 && static_cast<uint16_t>(GetData()[3] << 8 | GetData()[2]) < 4;
+}
+
+//
+// CSendQueue
+//
+
+atomic<uint64_t> CSendQueue::m_BytesCopied(0);
+
+CSendQueue::CSendQueue()
+  : m_Offset(0),
+    m_Size(0)
+{
+}
+
+CSendQueue::~CSendQueue()
+{
+}
+
+void CSendQueue::Push(const CSharedBytes& bytes)
+{
+  if (bytes->empty())
+    return;
+
+  m_Segments.push_back(bytes);
+  m_Size += static_cast<uint32_t>(bytes->size());
+}
+
+void CSendQueue::Push(vector<uint8_t>&& bytes)
+{
+  if (bytes.empty())
+    return;
+
+  m_Size += static_cast<uint32_t>(bytes.size());
+  m_Segments.push_back(make_shared<const vector<uint8_t>>(std::move(bytes)));
+}
+
+void CSendQueue::Push(const vector<uint8_t>& bytes)
+{
+  m_BytesCopied += bytes.size();
+  Push(vector<uint8_t>(bytes));
+}
+
+void CSendQueue::Push(const string& bytes)
+{
+  m_BytesCopied += bytes.size();
+  Push(vector<uint8_t>(begin(bytes), end(bytes)));
+}
+
+void CSendQueue::Clear()
+{
+  m_Segments.clear();
+  m_Offset = 0;
+  m_Size   = 0;
+}
+
+#ifdef WIN32
+uint32_t CSendQueue::GetBuffers(WSABUF* buffers) const
+#else
+uint32_t CSendQueue::GetBuffers(struct iovec* buffers) const
+#endif
+{
+  uint32_t Count  = 0;
+  uint32_t Offset = m_Offset;
+
+  for (auto i = begin(m_Segments); i != end(m_Segments) && Count < MAX_SEGMENTS_PER_SEND; ++i, ++Count)
+  {
+    const vector<uint8_t>& Segment = **i;
+
+#ifdef WIN32
+    buffers[Count].buf = const_cast<CHAR*>(reinterpret_cast<const CHAR*>(Segment.data() + Offset));
+    buffers[Count].len = static_cast<ULONG>(Segment.size() - Offset);
+#else
+    buffers[Count].iov_base = const_cast<uint8_t*>(Segment.data() + Offset);
+    buffers[Count].iov_len  = Segment.size() - Offset;
+#endif
+
+    Offset = 0;
+  }
+
+  return Count;
+}
+
+void CSendQueue::Consume(uint32_t size)
+{
+  m_Size -= size;
+
+  while (size > 0)
+  {
+    const uint32_t Remaining = static_cast<uint32_t>(m_Segments.front()->size()) - m_Offset;
+
+    if (size < Remaining)
+    {
+      m_Offset += size;
+      return;
+    }
+
+    // the kernel has the whole segment, drop our reference (the buffer itself is freed once nobody else shares it)
+
+    size -= Remaining;
+    m_Offset = 0;
+    m_Segments.pop_front();
+  }
 }
 
 //
@@ -205,6 +414,8 @@ CTCPSocket::CTCPSocket()
 
   int32_t OptVal = 1;
   setsockopt(m_Socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&OptVal), sizeof(int32_t));
+
+  Register(CSocketPoller::GetDefault());
 }
 
 CTCPSocket::CTCPSocket(SOCKET nSocket, struct sockaddr_in nSIN)
@@ -220,12 +431,13 @@ CTCPSocket::CTCPSocket(SOCKET nSocket, struct sockaddr_in nSIN)
 #else
   fcntl(m_Socket, F_SETFL, fcntl(m_Socket, F_GETFL) | O_NONBLOCK);
 #endif
+
+  Register(CSocketPoller::GetDefault());
 }
 
 CTCPSocket::~CTCPSocket()
 {
-  if (m_Socket != INVALID_SOCKET)
-    closesocket(m_Socket);
+  // the socket is unregistered and closed in CSocket's destructor
 }
 
 void CTCPSocket::Reset()
@@ -234,8 +446,8 @@ void CTCPSocket::Reset()
   Allocate(SOCK_STREAM);
 
   m_Connected = false;
-  m_RecvBuffer.clear();
-  m_SendBuffer.clear();
+  m_RecvBuffer.Clear();
+  m_SendQueue.Clear();
   m_LastRecv = GetTime();
 
 // make socket non blocking
@@ -246,6 +458,8 @@ void CTCPSocket::Reset()
 #else
   fcntl(m_Socket, F_SETFL, fcntl(m_Socket, F_GETFL) | O_NONBLOCK);
 #endif
+
+  Register(CSocketPoller::GetDefault());
 }
 
 void CTCPSocket::DoRecv(fd_set* fd)
@@ -253,19 +467,35 @@ void CTCPSocket::DoRecv(fd_set* fd)
   if (m_Socket == INVALID_SOCKET || m_HasError || !m_Connected)
     return;
 
-  if (FD_ISSET(m_Socket, fd))
+  if (!IsReadReady(fd))
+    return;
+
+  // data is waiting, receive it straight into the receive buffer
+  // the poller is edge triggered so keep reading until recv would block (or returns less than we asked for), otherwise we won't be told about the rest
+  // when the buffer is full we stop and leave the ready flag set so we continue on the next update once the packets have been processed
+
+  while (true)
   {
-    // data is waiting, receive it
+    uint32_t Space;
+    uint8_t* Buffer = m_RecvBuffer.GetFreeSpace(&Space);
+
+    if (Space == 0)
+      return;
 
-    char    buffer[1024];
-    int32_t c = recv(m_Socket, buffer, 1024, 0);
+    const int32_t c = recv(m_Socket, reinterpret_cast<char*>(Buffer), static_cast<int32_t>(Space), 0);
 
     if (c > 0)
     {
-      // success! add the received data to the buffer
+      // success! the data is already in the buffer
 
-      m_RecvBuffer += string(buffer, c);
+      m_RecvBuffer.Commit(c);
       m_LastRecv = GetTime();
+
+      if (static_cast<uint32_t>(c) < Space)
+      {
+        m_ReadReady = false;
+        return;
+      }
     }
     else if (c == SOCKET_ERROR && GetLastError() != EWOULDBLOCK)
     {
@@ -273,7 +503,7 @@ void CTCPSocket::DoRecv(fd_set* fd)
 
       m_HasError = true;
       m_Error    = GetLastError();
-      Print("[TCPSOCKET] error (recv) - " + GetErrorString());
+      Print("[TCPSOCKET] error (recv) - " + GetErrorString(), LOG_ERROR);
       return;
     }
     else if (c == 0)
@@ -282,26 +512,46 @@ void CTCPSocket::DoRecv(fd_set* fd)
 
       Print("[TCPSOCKET] closed by remote host");
       m_Connected = false;
+      return;
+    }
+    else
+    {
+      // nothing left to read
+
+      m_ReadReady = false;
+      return;
     }
   }
 }
 
 void CTCPSocket::DoSend(fd_set* send_fd)
 {
-  if (m_Socket == INVALID_SOCKET || m_HasError || !m_Connected || m_SendBuffer.empty())
+  if (m_Socket == INVALID_SOCKET || m_HasError || !m_Connected || m_SendQueue.IsEmpty())
     return;
 
-  if (FD_ISSET(m_Socket, send_fd))
+  if (IsWriteReady(send_fd))
   {
-    // socket is ready, send it
+    // socket is ready, send as much of the queue as we can in one call
 
-    int32_t s = send(m_Socket, m_SendBuffer.c_str(), static_cast<int32_t>(m_SendBuffer.size()), MSG_NOSIGNAL);
+#ifdef WIN32
+    WSABUF        Buffers[CSendQueue::MAX_SEGMENTS_PER_SEND];
+    const DWORD   Count = m_SendQueue.GetBuffers(Buffers);
+    DWORD         Sent  = 0;
+    const int32_t s     = WSASend(m_Socket, Buffers, Count, &Sent, 0, nullptr, nullptr) == SOCKET_ERROR ? SOCKET_ERROR : static_cast<int32_t>(Sent);
+#else
+    struct iovec  Buffers[CSendQueue::MAX_SEGMENTS_PER_SEND];
+    struct msghdr Message;
+    memset(&Message, 0, sizeof(Message));
+    Message.msg_iov    = Buffers;
+    Message.msg_iovlen = m_SendQueue.GetBuffers(Buffers);
+    const int32_t s    = static_cast<int32_t>(sendmsg(m_Socket, &Message, MSG_NOSIGNAL));
+#endif
 
     if (s > 0)
     {
-      // success! only some of the data may have been sent, remove it from the buffer
+      // success! only some of the data may have been sent, the queue just moves past it
 
-      m_SendBuffer = m_SendBuffer.substr(s);
+      m_SendQueue.Consume(s);
     }
     else if (s == SOCKET_ERROR && GetLastError() != EWOULDBLOCK)
     {
@@ -309,9 +559,15 @@ void CTCPSocket::DoSend(fd_set* send_fd)
 
       m_HasError = true;
       m_Error    = GetLastError();
-      Print("[TCPSOCKET] error (send) - " + GetErrorString());
+      Print("[TCPSOCKET] error (send) - " + GetErrorString(), LOG_ERROR);
       return;
     }
+    else if (s == SOCKET_ERROR)
+    {
+      // the send buffer is full, wait for the poller to tell us when there's room again
+
+      m_WriteReady = false;
+    }
   }
 }
 
@@ -372,7 +628,7 @@ void CTCPClient::Connect(const string& localaddress, const string& address, uint
     {
       m_HasError = true;
       m_Error    = GetLastError();
-      Print("[TCPCLIENT] error (bind) - " + GetErrorString());
+      Print("[TCPCLIENT] error (bind) - " + GetErrorString(), LOG_ERROR);
       return;
     }
   }
@@ -387,7 +643,7 @@ void CTCPClient::Connect(const string& localaddress, const string& address, uint
   {
     m_HasError = true;
     // m_Error = h_error;
-    Print("[TCPCLIENT] error (gethostbyname)");
+    Print("[TCPCLIENT] error (gethostbyname)", LOG_ERROR);
     return;
   }
 
@@ -407,11 +663,15 @@ void CTCPClient::Connect(const string& localaddress, const string& address, uint
 
       m_HasError = true;
       m_Error    = GetLastError();
-      Print("[TCPCLIENT] error (connect) - " + GetErrorString());
+      Print("[TCPCLIENT] error (connect) - " + GetErrorString(), LOG_ERROR);
       return;
     }
   }
 
+  // an unconnected socket is reported as writable, forget that so CheckConnect waits for the real connection
+
+  m_ReadReady  = false;
+  m_WriteReady = false;
   m_Connecting = true;
 }
 
@@ -420,6 +680,18 @@ bool CTCPClient::CheckConnect()
   if (m_Socket == INVALID_SOCKET || m_HasError || !m_Connecting)
     return false;
 
+#ifdef AURA_EPOLL
+  // the poller flags the socket as writable once the connection attempt completes
+
+  if (m_WriteReady)
+  {
+    m_Connecting = false;
+    m_Connected  = true;
+    return true;
+  }
+
+  return false;
+#else
   fd_set fd;
   FD_ZERO(&fd);
   FD_SET(m_Socket, &fd);
@@ -449,6 +721,7 @@ bool CTCPClient::CheckConnect()
   }
 
   return false;
+#endif
 }
 
 void CTCPClient::DoRecv(fd_set* fd)
@@ -513,7 +786,7 @@ bool CTCPServer::Listen(const string& address, uint16_t port)
   {
     m_HasError = true;
     m_Error    = GetLastError();
-    Print("[TCPSERVER] error (bind) - " + GetErrorString());
+    Print("[TCPSERVER] error (bind) - " + GetErrorString(), LOG_ERROR);
     return false;
   }
 
@@ -523,7 +796,7 @@ bool CTCPServer::Listen(const string& address, uint16_t port)
   {
     m_HasError = true;
     m_Error    = GetLastError();
-    Print("[TCPSERVER] error (listen) - " + GetErrorString());
+    Print("[TCPSERVER] error (listen) - " + GetErrorString(), LOG_ERROR);
     return false;
   }
 
@@ -535,7 +808,7 @@ CTCPSocket* CTCPServer::Accept(fd_set* fd)
   if (m_Socket == INVALID_SOCKET || m_HasError)
     return nullptr;
 
-  if (FD_ISSET(m_Socket, fd))
+  if (IsReadReady(fd))
   {
     // a connection is waiting, accept it
 
@@ -550,9 +823,12 @@ CTCPSocket* CTCPServer::Accept(fd_set* fd)
 #endif
     {
       // success! return the new socket
+      // the ready flag stays set because more connections may be waiting, we'll try again next update
 
       return new CTCPSocket(NewSocket, Addr);
     }
+
+    m_ReadReady = false;
   }
 
   return nullptr;
@@ -609,7 +885,7 @@ bool CUDPSocket::SendTo(const string& address, uint16_t port, const std::vector<
   {
     m_HasError = true;
     // m_Error = h_error;
-    Print("[UDPSOCKET] error (gethostbyname)");
+    Print("[UDPSOCKET] error (gethostbyname)", LOG_ERROR);
     return false;
   }
 
@@ -695,3 +971,105 @@ void CUDPSocket::Reset()
 
   m_BroadcastTarget.s_addr = INADDR_BROADCAST;
 }
+
+//
+// CSocketPoller
+//
+
+CSocketPoller::CSocketPoller()
+  :
+#ifdef AURA_EPOLL
+    m_Poll(epoll_create1(EPOLL_CLOEXEC)),
+#endif
+    m_NumSockets(0)
+{
+#ifdef AURA_EPOLL
+  if (m_Poll == -1)
+    Print("[POLLER] error (epoll_create1) - " + to_string(GetLastError()), LOG_ERROR);
+#endif
+}
+
+CSocketPoller::~CSocketPoller()
+{
+#ifdef AURA_EPOLL
+  if (m_Poll != -1)
+    close(m_Poll);
+#endif
+}
+
+CSocketPoller* CSocketPoller::GetDefault()
+{
+  // each thread gets its own poller so sockets created by a thread are polled by that thread
+
+  static thread_local CSocketPoller Poller;
+  return &Poller;
+}
+
+bool CSocketPoller::Add(CSocket* socket, SOCKET fd)
+{
+#ifdef AURA_EPOLL
+  if (m_Poll == -1)
+    return false;
+
+  struct epoll_event Event;
+  Event.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  Event.data.ptr = socket;
+
+  if (epoll_ctl(m_Poll, EPOLL_CTL_ADD, fd, &Event) == -1)
+  {
+    Print("[POLLER] error (epoll_ctl) - " + to_string(GetLastError()), LOG_ERROR);
+    return false;
+  }
+#else
+  (void)socket;
+  (void)fd;
+#endif
+
+  ++m_NumSockets;
+  return true;
+}
+
+void CSocketPoller::Remove(CSocket* socket, SOCKET fd)
+{
+  (void)socket;
+
+#ifdef AURA_EPOLL
+  struct epoll_event Event;
+  epoll_ctl(m_Poll, EPOLL_CTL_DEL, fd, &Event);
+#else
+  (void)fd;
+#endif
+
+  --m_NumSockets;
+}
+
+uint32_t CSocketPoller::Wait(int64_t usecBlock)
+{
+#ifdef AURA_EPOLL
+  if (m_Poll == -1)
+    return 0;
+
+  // the event buffer only needs to hold one batch, any sockets that don't fit are returned by the next call
+
+  m_Events.resize(m_NumSockets < 64 ? 64 : (m_NumSockets > 1024 ? 1024 : m_NumSockets));
+
+  const int32_t NumEvents = epoll_wait(m_Poll, m_Events.data(), static_cast<int32_t>(m_Events.size()), static_cast<int32_t>(usecBlock / 1000));
+
+  if (NumEvents <= 0)
+    return 0;
+
+  for (int32_t i = 0; i < NumEvents; ++i)
+  {
+    const uint32_t Flags = m_Events[i].events;
+
+    // errors and hangups are reported as readable so the next recv picks them up
+
+    static_cast<CSocket*>(m_Events[i].data.ptr)->SetReady((Flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0, (Flags & (EPOLLOUT | EPOLLHUP | EPOLLERR)) != 0);
+  }
+
+  return static_cast<uint32_t>(NumEvents);
+#else
+  (void)usecBlock;
+  return 0;
+#endif
+}
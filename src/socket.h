@@ -23,6 +23,9 @@
 
 #include "util.h"
 
+#include <atomic>
+#include <deque>
+
 #ifdef WIN32
 #include <winsock2.h>
 #include <errno.h>
@@ -109,8 +112,14 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#define AURA_EPOLL
+#endif
+
 typedef int32_t SOCKET;
 
 #define INVALID_SOCKET -1
@@ -133,6 +142,8 @@ typedef int32_t SOCKET;
 #define SHUT_RDWR 2
 #endif
 
+class CSocketPoller;
+
 //
 // CSocket
 //
@@ -142,7 +153,10 @@ class CSocket
 protected:
   SOCKET             m_Socket;
   struct sockaddr_in m_SIN;
+  CSocketPoller*     m_Poller;     // the poller this socket is registered with (if any)
   bool               m_HasError;
+  bool               m_ReadReady;  // set by the poller, cleared when a recv/accept would block
+  bool               m_WriteReady; // set by the poller, cleared when a send would block
   int                m_Error;
 
   CSocket();
@@ -157,10 +171,112 @@ public:
   inline std::string          GetIPString() const { return inet_ntoa(m_SIN.sin_addr); }
   inline int32_t              GetError() const { return m_Error; }
   inline bool                 HasError() const { return m_HasError; }
+  inline CSocketPoller*       GetPoller() const { return m_Poller; }
+
+  inline void SetReady(bool read, bool write)
+  {
+    m_ReadReady  = m_ReadReady || read;
+    m_WriteReady = m_WriteReady || write;
+  }
+
+#ifdef AURA_EPOLL
+  inline bool IsReadReady(fd_set*) const { return m_ReadReady; }
+  inline bool IsWriteReady(fd_set*) const { return m_WriteReady; }
+#else
+  inline bool IsReadReady(fd_set* fd) const { return FD_ISSET(m_Socket, fd); }
+  inline bool IsWriteReady(fd_set* send_fd) const { return FD_ISSET(m_Socket, send_fd); }
+#endif
 
   void SetFD(fd_set* fd, fd_set* send_fd, int32_t* nfds);
   void Reset();
   void Allocate(int type);
+  void Register(CSocketPoller* poller);
+  void Unregister();
+};
+
+//
+// CRecvBuffer
+//
+
+// a fixed capacity receive buffer, recv writes straight into the free space at the tail and the packet parsers read from the head in place
+// packets have to be contiguous for the parsers so rather than wrapping around, the unread bytes (at most one partial packet) are moved back to the front when the tail runs out of room
+// the capacity fits the largest possible W3GS/BNET packet (the length field is 16 bits) and is only allocated on the first recv
+
+class CRecvBuffer final
+{
+private:
+  std::vector<uint8_t> m_Buffer;
+  uint32_t             m_Head; // index of the first unread byte
+  uint32_t             m_Tail; // index one past the last unread byte
+
+public:
+  static const uint32_t CAPACITY = 65536 + 16384;
+
+  CRecvBuffer();
+  ~CRecvBuffer();
+
+  inline const uint8_t* GetData() const { return m_Buffer.data() + m_Head; }
+  inline uint32_t       GetSize() const { return m_Tail - m_Head; }
+  inline bool           IsEmpty() const { return m_Head == m_Tail; }
+
+  uint8_t* GetFreeSpace(uint32_t* size); // makes room at the tail and returns it, Commit the number of bytes written into it
+  void     Commit(uint32_t size);
+  void     Consume(uint32_t size);
+  void     Clear();
+
+  // packet framing
+  // every protocol we speak starts its packets with a header constant, a packet ID and a 16 bit little endian length which includes the header
+  // returns the first complete packet in the buffer (it stays there until consumed), false if there isn't one yet or the length field is garbage
+
+  bool GetPacket(CByteSpan* packet) const;
+  bool HasBadPacket() const;
+};
+
+//
+// CSendQueue
+//
+
+// the outgoing data of a stream socket as a queue of refcounted buffers which are handed to the kernel with a single gathering send
+// a partially sent buffer just advances an offset so nothing is ever copied to drop the bytes that went out
+// buffers moved or shared into the queue aren't copied at all, the ones that are copied are counted for profiling (see GetBytesCopied)
+
+class CSendQueue final
+{
+private:
+  static std::atomic<uint64_t> m_BytesCopied; // total bytes copied into every send queue in the process
+
+  std::deque<CSharedBytes> m_Segments;
+  uint32_t                 m_Offset; // bytes of the front segment which have already been sent
+  uint32_t                 m_Size;   // unsent bytes in the queue
+
+public:
+  static const uint32_t MAX_SEGMENTS_PER_SEND = 64;
+
+  CSendQueue();
+  ~CSendQueue();
+
+  static inline uint64_t GetBytesCopied() { return m_BytesCopied; }
+  static inline void     AddBytesCopied(uint64_t bytes) { m_BytesCopied += bytes; }
+
+  inline uint32_t GetSize() const { return m_Size; }
+  inline bool     IsEmpty() const { return m_Size == 0; }
+
+  void Push(const CSharedBytes& bytes);
+  void Push(std::vector<uint8_t>&& bytes);
+  void Push(const std::vector<uint8_t>& bytes);
+  void Push(const std::string& bytes);
+  void Clear();
+
+  // fills up to MAX_SEGMENTS_PER_SEND buffer descriptors with the unsent data in order, returns how many were filled
+  // afterwards Consume the number of bytes the send accepted
+
+#ifdef WIN32
+  uint32_t GetBuffers(WSABUF* buffers) const;
+#else
+  uint32_t GetBuffers(struct iovec* buffers) const;
+#endif
+
+  void Consume(uint32_t size);
 };
 
 //
@@ -170,8 +286,8 @@ public:
 class CTCPSocket : public CSocket
 {
 protected:
-  std::string m_RecvBuffer;
-  std::string m_SendBuffer;
+  CRecvBuffer m_RecvBuffer;
+  CSendQueue  m_SendQueue;
   uint32_t    m_LastRecv;
   bool        m_Connected;
 
@@ -180,16 +296,18 @@ public:
   CTCPSocket(SOCKET nSocket, struct sockaddr_in nSIN);
   ~CTCPSocket();
 
-  inline std::string* GetBytes() { return &m_RecvBuffer; }
+  inline CRecvBuffer* GetRecvBuffer() { return &m_RecvBuffer; }
   inline uint32_t     GetLastRecv() const { return m_LastRecv; }
   inline bool         GetConnected() const { return m_Connected; }
+  inline uint32_t     GetSendQueueSize() const { return m_SendQueue.GetSize(); }
 
-  inline void PutBytes(const std::string& bytes) { m_SendBuffer += bytes; }
-  inline void PutBytes(const std::vector<uint8_t>& bytes) { m_SendBuffer += std::string(begin(bytes), end(bytes)); }
+  inline void PutBytes(const std::string& bytes) { m_SendQueue.Push(bytes); }
+  inline void PutBytes(const std::vector<uint8_t>& bytes) { m_SendQueue.Push(bytes); }
+  inline void PutBytes(std::vector<uint8_t>&& bytes) { m_SendQueue.Push(std::move(bytes)); }
+  inline void PutBytes(const CSharedBytes& bytes) { m_SendQueue.Push(bytes); }
 
-  inline void ClearRecvBuffer() { m_RecvBuffer.clear(); }
-  inline void SubstrRecvBuffer(uint32_t i) { m_RecvBuffer = m_RecvBuffer.substr(i); }
-  inline void                           ClearSendBuffer() { m_SendBuffer.clear(); }
+  inline void ClearRecvBuffer() { m_RecvBuffer.Clear(); }
+  inline void ClearSendBuffer() { m_SendQueue.Clear(); }
 
   void DoRecv(fd_set* fd);
   void DoSend(fd_set* send_fd);
@@ -211,18 +329,14 @@ public:
   CTCPClient();
   ~CTCPClient();
 
-  inline std::string* GetBytes() { return &m_RecvBuffer; }
+  inline CRecvBuffer* GetRecvBuffer() { return &m_RecvBuffer; }
   inline bool         GetConnected() const { return m_Connected; }
   inline bool         GetConnecting() const { return m_Connecting; }
 
   void        Reset();
-  inline void PutBytes(const std::string& bytes) { m_SendBuffer += bytes; }
-  inline void PutBytes(const std::vector<uint8_t>& bytes) { m_SendBuffer += std::string(begin(bytes), end(bytes)); }
-
   bool        CheckConnect();
-  inline void ClearRecvBuffer() { m_RecvBuffer.clear(); }
-  inline void SubstrRecvBuffer(uint32_t i) { m_RecvBuffer = m_RecvBuffer.substr(i); }
-  inline void                           ClearSendBuffer() { m_SendBuffer.clear(); }
+  inline void ClearRecvBuffer() { m_RecvBuffer.Clear(); }
+  inline void ClearSendBuffer() { m_SendQueue.Clear(); }
   void DoRecv(fd_set* fd);
   void DoSend(fd_set* send_fd);
   void Disconnect();
@@ -265,4 +379,37 @@ public:
   void SetDontRoute(bool dontRoute);
 };
 
+//
+// CSocketPoller
+//
+
+// on linux every stream socket registers itself with the poller of the thread that created it (edge triggered epoll)
+// so the main loop doesn't have to collect every socket into an fd_set each iteration and isn't limited by FD_SETSIZE
+// Wait( ) flags the sockets that became ready and the usual DoRecv/DoSend/Accept calls then check those flags
+// on other platforms the poller only counts sockets and the caller falls back to select( )
+
+class CSocketPoller final
+{
+private:
+#ifdef AURA_EPOLL
+  std::vector<struct epoll_event> m_Events;
+  int                             m_Poll;
+#endif
+  uint32_t m_NumSockets;
+
+public:
+  CSocketPoller();
+  ~CSocketPoller();
+  CSocketPoller(CSocketPoller&) = delete;
+  CSocketPoller& operator=(CSocketPoller&) = delete;
+
+  static CSocketPoller* GetDefault();
+
+  inline uint32_t GetNumSockets() const { return m_NumSockets; }
+
+  bool Add(CSocket* socket, SOCKET fd);
+  void Remove(CSocket* socket, SOCKET fd);
+  uint32_t Wait(int64_t usecBlock);
+};
+
 #endif // AURA_SOCKET_H_
@@ -27,7 +27,7 @@
 // CStats
 //
 
-// the stats class is passed a copy of every player action in ProcessAction when it's received
+// the stats class is shown every player action in ProcessAction when it's received (a view into the receive buffer, copy anything you want to keep)
 // then when the game is over the Save function is called
 // so the idea is that you parse the actions to gather data about the game, storing the results in any member variables you need in your subclass
 // and in the Save function you write the results to the database
@@ -35,7 +35,7 @@
 
 class CGame;
 class CDBDotAPlayer;
-class CIncomingAction;
+class CByteSpan;
 class CAura;
 class CAuraDB;
 class CStats
@@ -50,7 +50,7 @@ public:
   ~CStats();
   CStats(CStats&) = delete;
 
-  bool ProcessAction(CIncomingAction* Action);
+  bool ProcessAction(const CByteSpan& ActionData);
   void Save(CAura* CAura, CAuraDB* DB);
 };
 
@@ -0,0 +1,309 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+#include "timerwheel.h"
+#include "includes.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+static inline uint32_t CountTrailingZeros(uint64_t bits)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long Index;
+  _BitScanForward64(&Index, bits);
+  return Index;
+#elif defined(_MSC_VER)
+  uint32_t Index = 0;
+
+  while (!(bits & 1))
+  {
+    bits >>= 1;
+    ++Index;
+  }
+
+  return Index;
+#else
+  return __builtin_ctzll(bits);
+#endif
+}
+
+//
+// CTimer
+//
+
+CTimer::CTimer(function<void()> nCallback)
+  : m_Callback(std::move(nCallback)),
+    m_Wheel(nullptr),
+    m_Slot(nullptr),
+    m_Prev(nullptr),
+    m_Next(nullptr),
+    m_Deadline(0)
+{
+}
+
+CTimer::~CTimer()
+{
+  Cancel();
+}
+
+void CTimer::Schedule(CTimerWheel* wheel, int64_t deadline)
+{
+  Cancel();
+
+  if (!wheel)
+    return;
+
+  m_Wheel    = wheel;
+  m_Deadline = deadline;
+  m_Wheel->Link(this);
+  ++m_Wheel->m_NumTimers;
+}
+
+void CTimer::Cancel()
+{
+  if (!m_Wheel)
+    return;
+
+  m_Wheel->Unlink(this);
+  --m_Wheel->m_NumTimers;
+  m_Wheel = nullptr;
+}
+
+//
+// CTimerWheel
+//
+
+CTimerWheel::CTimerWheel()
+  : m_Root(),
+    m_Levels(),
+    m_RootOccupied(),
+    m_Expired(nullptr),
+    m_Next(GetTicks()),
+    m_NumTimers(0)
+{
+}
+
+CTimerWheel::~CTimerWheel()
+{
+  // the owners of any timers still scheduled may outlive us (e.g. games left on a worker thread when it exits)
+
+  for (auto& slot : m_Root)
+  {
+    for (CTimer* Timer = slot; Timer; Timer = Timer->m_Next)
+      Timer->m_Wheel = nullptr;
+  }
+
+  for (auto& level : m_Levels)
+  {
+    for (auto& slot : level)
+    {
+      for (CTimer* Timer = slot; Timer; Timer = Timer->m_Next)
+        Timer->m_Wheel = nullptr;
+    }
+  }
+}
+
+CTimerWheel* CTimerWheel::GetDefault()
+{
+  // each thread gets its own wheel, like the socket pollers
+
+  static thread_local CTimerWheel Wheel;
+  return &Wheel;
+}
+
+void CTimerWheel::Link(CTimer* timer)
+{
+  // timers which are already due go in the next slot to be processed
+
+  const int64_t Deadline = max(timer->m_Deadline, m_Next);
+  const int64_t Delta    = Deadline - m_Next;
+  CTimer**      Slot;
+
+  if (Delta < ROOT_SIZE)
+  {
+    const uint32_t Index = static_cast<uint32_t>(Deadline & (ROOT_SIZE - 1));
+    Slot                 = &m_Root[Index];
+    m_RootOccupied[Index / 64] |= static_cast<uint64_t>(1) << (Index % 64);
+  }
+  else
+  {
+    uint32_t Level = 1, Shift = ROOT_BITS;
+
+    while (Level < LEVELS - 1 && Delta >= static_cast<int64_t>(1) << (Shift + LEVEL_BITS))
+    {
+      ++Level;
+      Shift += LEVEL_BITS;
+    }
+
+    // timers beyond the range of the last level are parked in its furthest slot and placed again when it comes round
+
+    const int64_t Range = static_cast<int64_t>(1) << (Shift + LEVEL_BITS);
+    const int64_t When  = Delta < Range ? Deadline : m_Next + Range - 1;
+    Slot                = &m_Levels[Level - 1][(When >> Shift) & (LEVEL_SIZE - 1)];
+  }
+
+  timer->m_Slot = Slot;
+  timer->m_Prev = nullptr;
+  timer->m_Next = *Slot;
+
+  if (*Slot)
+    (*Slot)->m_Prev = timer;
+
+  *Slot = timer;
+}
+
+void CTimerWheel::Unlink(CTimer* timer)
+{
+  if (timer->m_Prev)
+    timer->m_Prev->m_Next = timer->m_Next;
+  else
+    *timer->m_Slot = timer->m_Next;
+
+  if (timer->m_Next)
+    timer->m_Next->m_Prev = timer->m_Prev;
+
+  if (!*timer->m_Slot && timer->m_Slot >= m_Root && timer->m_Slot < m_Root + ROOT_SIZE)
+  {
+    const uint32_t Index = static_cast<uint32_t>(timer->m_Slot - m_Root);
+    m_RootOccupied[Index / 64] &= ~(static_cast<uint64_t>(1) << (Index % 64));
+  }
+
+  timer->m_Slot = nullptr;
+  timer->m_Prev = nullptr;
+  timer->m_Next = nullptr;
+}
+
+void CTimerWheel::Cascade(uint32_t level, uint32_t index)
+{
+  // move every timer in this slot down, they're all due within the range of the level below
+
+  CTimer* Timer              = m_Levels[level - 1][index];
+  m_Levels[level - 1][index] = nullptr;
+
+  while (Timer)
+  {
+    CTimer* Next = Timer->m_Next;
+    Link(Timer);
+    Timer = Next;
+  }
+}
+
+uint32_t CTimerWheel::FindRootSlot(uint32_t index) const
+{
+  // find the first non empty level 0 slot at or after index (or ROOT_SIZE if there isn't one)
+
+  uint32_t Word = index / 64;
+  uint64_t Bits = m_RootOccupied[Word] & (~static_cast<uint64_t>(0) << (index % 64));
+
+  while (!Bits)
+  {
+    if (++Word == ROOT_SIZE / 64)
+      return ROOT_SIZE;
+
+    Bits = m_RootOccupied[Word];
+  }
+
+  return Word * 64 + CountTrailingZeros(Bits);
+}
+
+int64_t CTimerWheel::GetNextDeadline() const
+{
+  if (m_NumTimers == 0)
+    return -1;
+
+  const int64_t  Base = m_Next & ~static_cast<int64_t>(ROOT_SIZE - 1);
+  const uint32_t Slot = FindRootSlot(static_cast<uint32_t>(m_Next & (ROOT_SIZE - 1)));
+
+  // if nothing is due before the next cascade wake up for it, it may move something down to level 0
+
+  return Base + Slot;
+}
+
+uint32_t CTimerWheel::Advance(int64_t ticks)
+{
+  uint32_t NumFired = 0;
+
+  while (m_Next <= ticks)
+  {
+    if (m_NumTimers == 0)
+    {
+      m_Next = ticks + 1;
+      break;
+    }
+
+    const uint32_t Index = static_cast<uint32_t>(m_Next & (ROOT_SIZE - 1));
+
+    // move the due timers out of the wheel before running them
+    // a callback may reschedule its own timer or cancel others and neither should disturb the slot we're emptying
+
+    m_Expired     = m_Root[Index];
+    m_Root[Index] = nullptr;
+    m_RootOccupied[Index / 64] &= ~(static_cast<uint64_t>(1) << (Index % 64));
+
+    for (CTimer* Timer = m_Expired; Timer; Timer = Timer->m_Next)
+      Timer->m_Slot = &m_Expired;
+
+    ++m_Next;
+
+    while (CTimer* Timer = m_Expired)
+    {
+      Unlink(Timer);
+      Timer->m_Wheel = nullptr;
+      --m_NumTimers;
+      ++NumFired;
+      Timer->m_Callback();
+    }
+
+    // skip the empty slots up to the next cascade
+
+    if ((m_Next & (ROOT_SIZE - 1)) != 0)
+    {
+      const int64_t Base = m_Next & ~static_cast<int64_t>(ROOT_SIZE - 1);
+      m_Next             = min(ticks + 1, Base + FindRootSlot(static_cast<uint32_t>(m_Next & (ROOT_SIZE - 1))));
+    }
+
+    // cascade as soon as we reach a new level 0 round so GetNextDeadline can see what's due in it
+
+    if ((m_Next & (ROOT_SIZE - 1)) == 0)
+    {
+      const uint32_t Index1 = static_cast<uint32_t>((m_Next >> ROOT_BITS) & (LEVEL_SIZE - 1));
+      const uint32_t Index2 = static_cast<uint32_t>((m_Next >> (ROOT_BITS + LEVEL_BITS)) & (LEVEL_SIZE - 1));
+      const uint32_t Index3 = static_cast<uint32_t>((m_Next >> (ROOT_BITS + 2 * LEVEL_BITS)) & (LEVEL_SIZE - 1));
+
+      if (Index1 == 0)
+      {
+        if (Index2 == 0)
+          Cascade(3, Index3);
+
+        Cascade(2, Index2);
+      }
+
+      Cascade(1, Index1);
+    }
+  }
+
+  return NumFired;
+}
@@ -0,0 +1,108 @@
+/*
+
+   Copyright [2010] [Josko Nikolic]
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+
+   CODE PORTED FROM THE ORIGINAL GHOST PROJECT: http://ghost.pwner.org/
+
+ */
+
+
+#ifndef AURA_TIMERWHEEL_H_
+#define AURA_TIMERWHEEL_H_
+
+#include <cstdint>
+#include <functional>
+
+class CTimerWheel;
+
+//
+// CTimer
+//
+
+// a deadline on a timer wheel, the callback is run (once) by CTimerWheel :: Advance when the deadline passes
+// a timer can only be scheduled on the wheel of the thread that owns it and is cancelled when destroyed
+
+class CTimer final
+{
+  friend class CTimerWheel;
+
+private:
+  std::function<void()> m_Callback;
+  CTimerWheel*          m_Wheel;    // the wheel this timer is scheduled on (nullptr if it isn't scheduled)
+  CTimer**              m_Slot;     // the wheel slot this timer is linked into
+  CTimer*               m_Prev;
+  CTimer*               m_Next;
+  int64_t               m_Deadline; // GetTicks when the timer is due
+
+public:
+  explicit CTimer(std::function<void()> nCallback);
+  ~CTimer();
+  CTimer(CTimer&) = delete;
+  CTimer& operator=(CTimer&) = delete;
+
+  inline bool    IsScheduled() const { return m_Wheel != nullptr; }
+  inline int64_t GetDeadline() const { return m_Deadline; }
+
+  void Schedule(CTimerWheel* wheel, int64_t deadline); // reschedules the timer if it's already scheduled
+  void Cancel();
+};
+
+//
+// CTimerWheel
+//
+
+// a hierarchical timing wheel with 1 ms resolution
+// level 0 has a slot for each of the next 256 ms, each of the higher levels has 64 slots covering 64 slots of the level below
+// timers are moved down a level when the wheel reaches their slot so scheduling, cancelling and firing are all O(1)
+// the main loop and each game worker block until GetNextDeadline and then call Advance to run whatever is due
+
+class CTimerWheel final
+{
+  friend class CTimer;
+
+private:
+  static const uint32_t LEVELS     = 4;
+  static const uint32_t ROOT_BITS  = 8;
+  static const uint32_t LEVEL_BITS = 6;
+  static const uint32_t ROOT_SIZE  = 1 << ROOT_BITS;
+  static const uint32_t LEVEL_SIZE = 1 << LEVEL_BITS;
+
+  CTimer*  m_Root[ROOT_SIZE];                // level 0, one slot per ms
+  CTimer*  m_Levels[LEVELS - 1][LEVEL_SIZE]; // levels 1 to 3
+  uint64_t m_RootOccupied[ROOT_SIZE / 64];   // a bit for each non empty level 0 slot
+  CTimer*  m_Expired;                        // the timers being run by Advance
+  int64_t  m_Next;                           // the next tick to process, everything before it has been fired
+  uint32_t m_NumTimers;
+
+  void Link(CTimer* timer);
+  void Unlink(CTimer* timer);
+  void Cascade(uint32_t level, uint32_t index);
+  uint32_t FindRootSlot(uint32_t index) const;
+
+public:
+  CTimerWheel();
+  ~CTimerWheel();
+  CTimerWheel(CTimerWheel&) = delete;
+  CTimerWheel& operator=(CTimerWheel&) = delete;
+
+  static CTimerWheel* GetDefault();
+
+  inline uint32_t GetNumTimers() const { return m_NumTimers; }
+
+  int64_t  GetNextDeadline() const; // the GetTicks value the caller should wake up at (or -1 if nothing is scheduled)
+  uint32_t Advance(int64_t ticks);  // runs every timer due at or before ticks, returns the number run
+};
+
+#endif // AURA_TIMERWHEEL_H_
@@ -24,9 +24,50 @@
 #include <string>
 #include <cstdint>
 #include <vector>
+#include <memory>
 #include <sstream>
 #include <iomanip>
 
+// an immutable packet which can be shared by several owners without copying it (e.g. the send queues and GProxy++ buffers of every player in a game)
+
+typedef std::shared_ptr<const std::vector<uint8_t>> CSharedBytes;
+
+// a read only view of bytes owned by someone else (e.g. a packet still sitting in a socket's receive buffer)
+// the packet parsers take these so they can read packets in place, a std::vector<uint8_t> converts to one implicitly
+
+class CByteSpan
+{
+private:
+  const uint8_t* m_Data;
+  uint32_t       m_Size;
+
+public:
+  CByteSpan()
+    : m_Data(nullptr),
+      m_Size(0)
+  {
+  }
+
+  CByteSpan(const uint8_t* nData, uint32_t nSize)
+    : m_Data(nData),
+      m_Size(nSize)
+  {
+  }
+
+  CByteSpan(const std::vector<uint8_t>& nData)
+    : m_Data(nData.data()),
+      m_Size(static_cast<uint32_t>(nData.size()))
+  {
+  }
+
+  inline const uint8_t* data() const { return m_Data; }
+  inline const uint8_t* begin() const { return m_Data; }
+  inline const uint8_t* end() const { return m_Data + m_Size; }
+  inline uint32_t       size() const { return m_Size; }
+  inline bool           empty() const { return m_Size == 0; }
+  inline uint8_t        operator[](uint32_t i) const { return m_Data[i]; }
+};
+
 inline std::string ToHexString(uint32_t i)
 {
   std::string       result;
@@ -80,7 +121,7 @@ inline std::vector<uint8_t> CreateByteArray(const int64_t i, bool reverse)
     return std::vector<uint8_t>{static_cast<uint8_t>(i >> 24), static_cast<uint8_t>(i >> 16), static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i)};
 }
 
-inline uint16_t ByteArrayToUInt16(const std::vector<uint8_t>& b, bool reverse, const uint32_t start = 0)
+inline uint16_t ByteArrayToUInt16(const CByteSpan& b, bool reverse, const uint32_t start = 0)
 {
   if (b.size() < start + 2)
     return 0;
@@ -91,7 +132,7 @@ inline uint16_t ByteArrayToUInt16(const std::vector<uint8_t>& b, bool reverse, c
     return static_cast<uint16_t>(b[start] << 8 | b[start + 1]);
 }
 
-inline uint32_t ByteArrayToUInt32(const std::vector<uint8_t>& b, bool reverse, const uint32_t start = 0)
+inline uint32_t ByteArrayToUInt32(const CByteSpan& b, bool reverse, const uint32_t start = 0)
 {
   if (b.size() < start + 4)
     return 0;
@@ -183,7 +224,7 @@ inline void AppendByteArray(std::vector<uint8_t>& b, const int64_t i, bool rever
   AppendByteArray(b, CreateByteArray(i, reverse));
 }
 
-inline std::vector<uint8_t> ExtractCString(const std::vector<uint8_t>& b, const uint32_t start)
+inline std::vector<uint8_t> ExtractCString(const CByteSpan& b, const uint32_t start)
 {
   // start searching the byte array at position 'start' for the first null value
   // if found, return the subarray from 'start' to the null value but not including the null value
@@ -193,18 +234,18 @@ inline std::vector<uint8_t> ExtractCString(const std::vector<uint8_t>& b, const
     for (uint32_t i = start; i < b.size(); ++i)
     {
       if (b[i] == 0)
-        return std::vector<uint8_t>(begin(b) + start, begin(b) + i);
+        return std::vector<uint8_t>(b.begin() + start, b.begin() + i);
     }
 
     // no null value found, return the rest of the byte array
 
-    return std::vector<uint8_t>(begin(b) + start, end(b));
+    return std::vector<uint8_t>(b.begin() + start, b.end());
   }
 
   return std::vector<uint8_t>();
 }
 
-inline uint8_t ExtractHex(const std::vector<uint8_t>& b, const uint32_t start, bool reverse)
+inline uint8_t ExtractHex(const CByteSpan& b, const uint32_t start, bool reverse)
 {
   // consider the byte array to contain a 2 character ASCII encoded hex value at b[start] and b[start + 1] e.g. "FF"
   // extract it as a single decoded byte
@@ -212,7 +253,7 @@ inline uint8_t ExtractHex(const std::vector<uint8_t>& b, const uint32_t start, b
   if (start + 1 < b.size())
   {
     uint32_t    c;
-    std::string temp = std::string(begin(b) + start, begin(b) + start + 2);
+    std::string temp = std::string(b.begin() + start, b.begin() + start + 2);
 
     if (reverse)
       temp = std::string(temp.rend(), temp.rbegin());